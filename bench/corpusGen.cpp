@@ -0,0 +1,440 @@
+// Synthetic DWARF corpus for the scaling benchmarks.
+//
+// Writes C++ sources with a configurable number of CUs, each with nested namespaces, class templates, a deep
+// inheritance chain, big enums, unions, bit-fields and function bodies, then builds them with the local compiler
+// once per debug info variant. The sources only depend on the options and the seed, so the same command line
+// gives the same corpus on every machine (up to the compiler version).
+//
+//   dwarfCorpusGen -o corpus --cus 200 --variants g,dwarf4,dwarf5,types -j 8
+//
+// corpus/src holds the sources, corpus/<variant>/corpus the binary to feed to `dwarfInfoToJson --bench`.
+// There is no -gsplit-dwarf variant: the linked binary only carries skeleton CUs and dw::file never opens the
+// .dwo files next to it, so it would measure an almost empty .debug_info.
+// With the defaults a CU adds about 30 KiB of .debug_info at -g; the enumerators and function bodies dominate when
+// scaled up, e.g. `--cus 20000 --enum-size 4096 --functions 128` lands in the GB range.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct options
+{
+    fs::path    outDir = "corpus";
+    uint32_t    cus = 16;
+    uint32_t    namespaces = 4;      // per CU, nested up to `namespaceDepth`
+    uint32_t    namespaceDepth = 3;
+    uint32_t    templates = 4;       // class templates per CU, each instantiated `instantiations` times
+    uint32_t    instantiations = 4;
+    uint32_t    inheritDepth = 8;    // length of the inheritance chain per CU
+    uint32_t    enums = 4;
+    uint32_t    enumSize = 256;      // enumerators per enum
+    uint32_t    unions = 4;
+    uint32_t    bitfieldStructs = 4;
+    uint32_t    functions = 16;      // per CU
+    uint32_t    statements = 8;      // loop bodies per function
+    uint32_t    commonTypes = 32;    // types in the header every CU includes (ODR duplicates across CUs)
+    uint64_t    seed = 1;
+    std::string cxx = std::getenv("CXX") ? std::getenv("CXX") : "c++";
+    std::string opt = "-O0";
+    std::string variants = "g";
+    unsigned    jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool        sourcesOnly = false;
+};
+
+struct variant
+{
+    std::string_view name;
+    std::string_view flags;
+};
+
+inline constexpr variant knownVariants[] = {
+    {"g", "-g"},
+    {"dwarf4", "-gdwarf-4"},
+    {"dwarf5", "-gdwarf-5"},
+    {"types", "-gdwarf-4 -fdebug-types-section"},
+};
+
+// splitmix64, the distributions of <random> are not specified bit for bit
+class rng
+{
+    uint64_t mState;
+
+public:
+    explicit rng(uint64_t seed) :
+        mState(seed) {}
+
+    uint64_t next() noexcept
+    {
+        uint64_t z = (this->mState += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint32_t below(uint32_t bound) noexcept
+    {
+        return bound ? static_cast<uint32_t>(this->next() % bound) : 0;
+    }
+};
+
+static constexpr std::string_view scalarTypes[] = {"char", "short", "int", "long", "unsigned", "float", "double", "long long"};
+
+static void writeCommonHeader(const options &opts, std::ostream &out)
+{
+    rng random{opts.seed};
+    out << "#pragma once\n#include <cstdint>\n\nnamespace corpus::common\n{\n";
+    for (uint32_t idx = 0; idx < opts.commonTypes; idx++)
+    {
+        out << std::format("    struct shared{}\n    {{\n", idx);
+        for (uint32_t member = 0, count = 2 + random.below(6); member < count; member++)
+            out << std::format("        {} m{};\n", scalarTypes[random.below(std::size(scalarTypes))], member);
+        if (idx)
+            out << std::format("        shared{} *link;\n", random.below(idx));
+        out << "    };\n";
+    }
+    out << "} // namespace corpus::common\n";
+}
+
+static void writeCU(const options &opts, uint32_t cu, std::ostream &out)
+{
+    rng random{opts.seed * 0x100000001b3ull + cu};
+    out << "#include \"corpus_common.hpp\"\n\n";
+
+    // nested namespaces, each with a few plain structs that reference the common types
+    for (uint32_t ns = 0; ns < opts.namespaces; ns++)
+    {
+        uint32_t depth = 1 + random.below(std::max(opts.namespaceDepth, 1u));
+        out << "namespace corpus";
+        for (uint32_t level = 0; level < depth; level++)
+            out << std::format("::n{}_{}_{}", cu, ns, level);
+        out << "\n{\n";
+        for (uint32_t item = 0, count = 1 + random.below(4); item < count; item++)
+        {
+            out << std::format("    struct record{}\n    {{\n", item);
+            if (opts.commonTypes)
+                out << std::format("        corpus::common::shared{} shared;\n", random.below(opts.commonTypes));
+            out << std::format("        {} value;\n    }};\n    record{} instance{};\n", scalarTypes[random.below(std::size(scalarTypes))],
+                               item, item);
+        }
+        out << "}\n\n";
+    }
+
+    out << std::format("namespace corpus::cu{}\n{{\n", cu);
+
+    // class templates with a few instantiations each
+    for (uint32_t tmpl = 0; tmpl < opts.templates; tmpl++)
+    {
+        out << std::format("    template <typename T, int N>\n    struct tmpl{}\n    {{\n        T data[N];\n", tmpl);
+        out << "        T get(int idx) const { return data[idx % N]; }\n";
+        out << "        void set(int idx, T value) { data[idx % N] = value; }\n    };\n";
+        for (uint32_t inst = 0; inst < opts.instantiations; inst++)
+            out << std::format("    tmpl{}<{}, {}> tmpl{}_{};\n", tmpl, scalarTypes[random.below(std::size(scalarTypes))], 1 + random.below(16), tmpl, inst);
+    }
+
+    // one deep inheritance chain with virtual functions
+    for (uint32_t level = 0; level < opts.inheritDepth; level++)
+    {
+        if (level == 0)
+            out << "    struct base0\n    {\n        virtual ~base0() = default;\n";
+        else
+            out << std::format("    struct base{} : base{}\n    {{\n", level, level - 1);
+        out << std::format("        int field{};\n        virtual int get{}() const {{ return field{}; }}\n    }};\n", level, level, level);
+    }
+    if (opts.inheritDepth)
+        out << std::format("    base{} leaf;\n", opts.inheritDepth - 1);
+
+    for (uint32_t item = 0; item < opts.enums; item++)
+    {
+        out << std::format("    enum class enum{} : uint32_t\n    {{\n", item);
+        for (uint32_t value = 0; value < opts.enumSize; value++)
+            out << std::format("        e{} = {},\n", value, value * 3 + item);
+        out << std::format("    }};\n    enum{} enumValue{} = enum{}::e0;\n", item, item, item);
+    }
+
+    for (uint32_t item = 0; item < opts.unions; item++)
+    {
+        out << std::format("    union union{}\n    {{\n        int asInt;\n        float asFloat;\n        char raw[{}];\n", item, 4 + random.below(60));
+        out << "        struct\n        {\n            short low;\n            short high;\n        } halves;\n";
+        out << std::format("    }};\n    union{} unionValue{};\n", item, item);
+    }
+
+    for (uint32_t item = 0; item < opts.bitfieldStructs; item++)
+    {
+        out << std::format("    struct bits{}\n    {{\n", item);
+        for (uint32_t field = 0, count = 2 + random.below(12); field < count; field++)
+            out << std::format("        unsigned f{} : {};\n", field, 1 + random.below(12));
+        out << std::format("    }};\n    bits{} bitsValue{};\n", item, item);
+    }
+
+    // function bodies: locals, loops and lexical blocks
+    for (uint32_t fn = 0; fn < opts.functions; fn++)
+    {
+        out << std::format("    long fn{}(long x)\n    {{\n        long acc = x;\n", fn);
+        for (uint32_t stmt = 0; stmt < opts.statements; stmt++)
+        {
+            out << std::format("        for (int i{} = 0; i{} < {}; i{}++)\n        {{\n", stmt, stmt, 1 + random.below(8), stmt);
+            out << std::format("            long t{} = acc * {} + i{};\n            acc ^= t{} >> {};\n        }}\n", stmt, 1 + random.below(97),
+                               stmt, stmt, random.below(7));
+        }
+        out << (fn ? std::format("        return acc + fn{}(acc & 1);\n    }}\n", random.below(fn)) : "        return acc;\n    }\n");
+    }
+    out << std::format("}} // namespace corpus::cu{}\n\n", cu);
+
+    // keeps every type above referenced and gives main something to call
+    out << std::format("long corpusUse{}()\n{{\n    using namespace corpus::cu{};\n    long sum = 0;\n", cu, cu);
+    if (opts.inheritDepth)
+        out << std::format("    sum += leaf.get{}();\n", opts.inheritDepth - 1);
+    for (uint32_t tmpl = 0; tmpl < opts.templates; tmpl++)
+    {
+        for (uint32_t inst = 0; inst < opts.instantiations; inst++)
+            out << std::format("    tmpl{}_{}.set({}, 1);\n    sum += static_cast<long>(tmpl{}_{}.get(0));\n", tmpl, inst, inst, tmpl, inst);
+    }
+    for (uint32_t item = 0; item < opts.enums; item++)
+        out << std::format("    sum += static_cast<long>(enumValue{});\n", item);
+    for (uint32_t item = 0; item < opts.unions; item++)
+        out << std::format("    sum += unionValue{}.asInt;\n", item);
+    for (uint32_t item = 0; item < opts.bitfieldStructs; item++)
+        out << std::format("    sum += bitsValue{}.f0;\n", item);
+    if (opts.functions)
+        out << std::format("    sum += fn{}(sum);\n", opts.functions - 1);
+    out << "    return sum;\n}\n";
+}
+
+static void writeMain(const options &opts, std::ostream &out)
+{
+    for (uint32_t cu = 0; cu < opts.cus; cu++)
+        out << std::format("long corpusUse{}();\n", cu);
+    out << "\nint main()\n{\n    long sum = 0;\n";
+    for (uint32_t cu = 0; cu < opts.cus; cu++)
+        out << std::format("    sum += corpusUse{}();\n", cu);
+    out << "    return static_cast<int>(sum & 1);\n}\n";
+}
+
+static int writeSources(const options &opts, const fs::path &srcDir)
+{
+    fs::create_directories(srcDir);
+    auto write = [&](const fs::path &path, auto &&fn) {
+        std::ofstream file(path);
+        if (!file.is_open())
+            return false;
+        fn(file);
+        return true;
+    };
+    if (!write(srcDir / "corpus_common.hpp", [&](std::ostream &out) { writeCommonHeader(opts, out); }) ||
+        !write(srcDir / "main.cpp", [&](std::ostream &out) { writeMain(opts, out); }))
+        return -1;
+    for (uint32_t cu = 0; cu < opts.cus; cu++)
+    {
+        if (!write(srcDir / std::format("cu{}.cpp", cu), [&](std::ostream &out) { writeCU(opts, cu, out); }))
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @return the number of commands that failed
+ */
+static uint32_t runParallel(const std::vector<std::string> &commands, unsigned jobs)
+{
+    std::atomic<size_t>   next = 0;
+    std::atomic<uint32_t> failed = 0;
+    auto                  worker = [&] {
+        for (size_t idx = next++; idx < commands.size(); idx = next++)
+        {
+            if (std::system(commands[idx].c_str()) != 0)
+            {
+                std::println(stderr, "failed: {}", commands[idx]);
+                ++failed;
+            }
+        }
+    };
+    std::vector<std::jthread> threads;
+    for (unsigned idx = 1; idx < jobs; idx++)
+        threads.emplace_back(worker);
+    worker();
+    threads.clear();
+    return failed;
+}
+
+static int buildVariant(const options &opts, const fs::path &srcDir, const variant &item)
+{
+    fs::path buildDir = opts.outDir / item.name;
+    fs::create_directories(buildDir);
+
+    std::vector<std::string> commands;
+    std::ofstream            objects(buildDir / "objects.rsp");
+    for (uint32_t cu = 0; cu <= opts.cus; cu++)
+    {
+        std::string stem = cu == opts.cus ? "main" : std::format("cu{}", cu);
+        fs::path    object = buildDir / (stem + ".o");
+        commands.push_back(std::format("{} -std=c++17 {} {} -I\"{}\" -c \"{}\" -o \"{}\"", opts.cxx, opts.opt, item.flags, srcDir.string(),
+                                       (srcDir / (stem + ".cpp")).string(), object.string()));
+        objects << '"' << object.string() << "\"\n";
+    }
+    objects.close();
+
+    std::println("[{}] compiling {} sources with {}", item.name, commands.size(), item.flags);
+    if (uint32_t failed = runParallel(commands, opts.jobs))
+    {
+        std::println(stderr, "[{}] {} compilations failed", item.name, failed);
+        return -1;
+    }
+    fs::path binary = buildDir / "corpus";
+    if (std::system(std::format("{} {} @\"{}\" -o \"{}\"", opts.cxx, item.flags, (buildDir / "objects.rsp").string(), binary.string()).c_str()) != 0)
+    {
+        std::println(stderr, "[{}] link failed", item.name);
+        return -1;
+    }
+    std::println("[{}] {} ({:.1f} MiB)", item.name, binary.string(), fs::file_size(binary) / (1024.0 * 1024.0));
+    return 0;
+}
+
+/**
+ * @brief a whole non-negative number in [min, max], anything else (signs, trailing characters, overflow) is rejected
+ */
+template <typename Int>
+static bool parseNumber(std::string_view arg, Int min, Int max, Int &value)
+{
+    size_t             parsed = 0;
+    unsigned long long number = 0;
+    try
+    {
+        number = std::stoull(std::string{arg}, &parsed);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    if (arg.empty() || arg.front() == '-' || parsed != arg.size() || number < min || number > max)
+        return false;
+    value = static_cast<Int>(number);
+    return true;
+}
+
+static void usage()
+{
+    std::cerr << "Usage: dwarfCorpusGen -o <dir> --cus <n> --namespaces <n> --namespace-depth <n> --templates <n> --instantiations <n>\n"
+              << "                      --inherit-depth <n> --enums <n> --enum-size <n> --unions <n> --bitfields <n> --functions <n>\n"
+              << "                      --statements <n> --common-types <n> --seed <n> --cxx <compiler> --opt <flag> -j <jobs>\n"
+              << "                      --variants <g,dwarf4,dwarf5,types> --sources-only\n";
+}
+
+int main(int argc, char **argv)
+{
+    using namespace std::string_literals;
+    options opts;
+    struct numericOption
+    {
+        const char *name;
+        uint32_t   *value;
+    };
+    const numericOption numeric[] = {
+        {"--cus", &opts.cus},
+        {"--namespaces", &opts.namespaces},
+        {"--namespace-depth", &opts.namespaceDepth},
+        {"--templates", &opts.templates},
+        {"--instantiations", &opts.instantiations},
+        {"--inherit-depth", &opts.inheritDepth},
+        {"--enums", &opts.enums},
+        {"--enum-size", &opts.enumSize},
+        {"--unions", &opts.unions},
+        {"--bitfields", &opts.bitfieldStructs},
+        {"--functions", &opts.functions},
+        {"--statements", &opts.statements},
+        {"--common-types", &opts.commonTypes},
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto found = std::find_if(std::begin(numeric), std::end(numeric), [&](const numericOption &item) { return argv[i] == std::string_view{item.name}; });
+        if (found != std::end(numeric) && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            if (!parseNumber(arg, 0u, UINT32_MAX, *found->value))
+            {
+                std::cerr << "Invalid " << found->name << " value: " << arg << '\n';
+                return 1;
+            }
+        }
+        else if (argv[i] == "-o"s && i + 1 < argc)
+            opts.outDir = argv[++i];
+        else if (argv[i] == "--seed"s && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            if (!parseNumber<uint64_t>(arg, 0, UINT64_MAX, opts.seed))
+            {
+                std::cerr << "Invalid --seed value: " << arg << '\n';
+                return 1;
+            }
+        }
+        else if (argv[i] == "--cxx"s && i + 1 < argc)
+            opts.cxx = argv[++i];
+        else if (argv[i] == "--opt"s && i + 1 < argc)
+            opts.opt = argv[++i];
+        else if (argv[i] == "--variants"s && i + 1 < argc)
+            opts.variants = argv[++i];
+        else if (argv[i] == "-j"s && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            if (!parseNumber(arg, 1u, 1024u, opts.jobs))
+            {
+                std::cerr << "Invalid job count: " << arg << " (1 to 1024)\n";
+                return 1;
+            }
+        }
+        else if (argv[i] == "--sources-only"s)
+            opts.sourcesOnly = true;
+        else
+        {
+            std::cerr << "Unknown option: " << argv[i] << '\n';
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<const variant *> selected;
+    for (size_t begin = 0; begin <= opts.variants.size();)
+    {
+        size_t           end = std::min(opts.variants.find(',', begin), opts.variants.size());
+        std::string_view name = std::string_view{opts.variants}.substr(begin, end - begin);
+        auto found = std::find_if(std::begin(knownVariants), std::end(knownVariants), [&](const variant &item) { return item.name == name; });
+        if (found == std::end(knownVariants))
+        {
+            std::cerr << "Unknown variant: " << name << '\n';
+            usage();
+            return 1;
+        }
+        selected.push_back(found);
+        begin = end + 1;
+    }
+
+    fs::path srcDir = opts.outDir / "src";
+    if (writeSources(opts, srcDir) == -1)
+    {
+        std::cerr << "Error: unable to write sources to " << srcDir << '\n';
+        return 1;
+    }
+    std::println("Wrote {} CUs to {}", opts.cus, srcDir.string());
+    if (opts.sourcesOnly)
+        return 0;
+
+    int ret = 0;
+    for (auto &&item : selected)
+    {
+        if (buildVariant(opts, srcDir, *item) == -1)
+            ret = 2;
+    }
+    return ret;
+}
@@ -0,0 +1,593 @@
+// Stage benchmarks for the extractor, with a saved baseline to compare against.
+//
+// Every stage of turning DWARF into json is timed on its own: opening the file, walking the CU headers, decoding
+// attributes, materializing children, offset lookups, type formatting, building the json and serializing it. The
+// input is an executable, or without one an in-memory corpus made by `dw::builder`, so a run needs no compiler.
+//
+//   dwarfBench corpus/g/corpus --save base.json             # before the change
+//   dwarfBench corpus/g/corpus --baseline base.json         # after it, exits with 3 on a regression
+//
+// Baselines compare medians and are only meaningful on the same input and machine; the per-item counts are
+// checked to catch the former.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <dwarf2json/benchRunner.hpp>
+#include <dwarfng/builder.hpp>
+
+struct options
+{
+    std::string input;                 // empty: the synthetic corpus
+    uint32_t    iterations = 10;
+    uint32_t    warmup = 1;
+    std::string filter;                // substring of the benchmark names to run
+    std::string savePath;
+    std::string baselinePath;
+    double      threshold = 5.0;       // percent the median may grow before it counts as a regression
+    uint32_t    lookups = 100000;      // offsets looked up per run, spread over the file
+    uint32_t    syntheticCUs = 64;
+    uint32_t    syntheticTypes = 64;   // structs per synthetic CU
+};
+
+/**
+ * @brief the measured part of one run, the clock runs from the start of the benchmark until it is paused
+ */
+class state
+{
+    uint64_t mElapsedNs = 0;
+    uint64_t mStartNs = 0;
+    bool     mRunning = false;
+    uint64_t mItems = 0;
+
+public:
+    void resume() noexcept
+    {
+        if (!this->mRunning)
+            this->mStartNs = trace::nowNs();
+        this->mRunning = true;
+    }
+
+    void pause() noexcept
+    {
+        if (this->mRunning)
+            this->mElapsedNs += trace::nowNs() - this->mStartNs;
+        this->mRunning = false;
+    }
+
+    // for stages timed inside the library, see `dw::file::getInitTimes`
+    void addTime(uint64_t ns) noexcept
+    {
+        this->mElapsedNs += ns;
+    }
+
+    void setItems(uint64_t items) noexcept
+    {
+        this->mItems = items;
+    }
+
+    uint64_t elapsedNs() const noexcept
+    {
+        return this->mElapsedNs;
+    }
+
+    uint64_t items() const noexcept
+    {
+        return this->mItems;
+    }
+};
+
+/**
+ * @brief opens the input again for every run, the synthetic corpus is built once and shared
+ */
+class corpus
+{
+    const options               &mOptions;
+    std::unique_ptr<dw::builder> mBuilder;
+
+public:
+    explicit corpus(const options &opts) :
+        mOptions(opts)
+    {
+        if (opts.input.empty())
+            this->build();
+    }
+
+    std::string name() const
+    {
+        if (!this->mOptions.input.empty())
+            return this->mOptions.input;
+        return std::format("<synthetic {} CUs x {} types>", this->mOptions.syntheticCUs, this->mOptions.syntheticTypes);
+    }
+
+    std::unique_ptr<dw::file> open() const
+    {
+        if (this->mBuilder)
+            return std::make_unique<dw::file>(this->mBuilder->finish(), this->name());
+        return std::make_unique<dw::file>(std::string_view{this->mOptions.input});
+    }
+
+    std::unique_ptr<dwarf2json> openEngine() const
+    {
+        auto engine = this->mBuilder ? std::make_unique<dwarf2json>(this->mBuilder->finish(), this->name())
+                                     : std::make_unique<dwarf2json>(this->mOptions.input);
+        engine->setQuiet(true);
+        return engine;
+    }
+
+    const options &getOptions() const noexcept
+    {
+        return this->mOptions;
+    }
+
+private:
+    // namespaces of structs with scalar and pointer members, enums, typedefs and variables, all in the header file
+    void build()
+    {
+        this->mBuilder = std::make_unique<dw::builder>();
+        dw::builder &build = *this->mBuilder;
+        for (uint32_t cuIdx = 0; cuIdx < this->mOptions.syntheticCUs; cuIdx++)
+        {
+            auto cu = build.addCU(std::format("bench_{}.cpp", cuIdx), {std::format("bench_{}.cpp", cuIdx), "bench.hpp"});
+            auto i32 = build.addBaseType(cu, "int", 4, DW_ATE_signed);
+            auto u64 = build.addBaseType(cu, "unsigned long", 8, DW_ATE_unsigned);
+            auto f64 = build.addBaseType(cu, "double", 8, DW_ATE_float);
+            auto chr = build.addBaseType(cu, "char", 1, DW_ATE_signed_char);
+            auto str = build.addPointer(cu, build.add(cu, DW_TAG_const_type).ref(DW_AT_type, chr).id());
+            auto ns = build.add(cu, DW_TAG_namespace).name(std::format("ns{}", cuIdx % 8)).id();
+
+            auto prev = i32;
+            for (uint32_t typeIdx = 0; typeIdx < this->mOptions.syntheticTypes; typeIdx++)
+            {
+                uint64_t line = typeIdx * 10 + 1;
+                auto     record = build.add(ns, DW_TAG_structure_type)
+                                  .name(std::format("record{}_{}", cuIdx, typeIdx))
+                                  .udata(DW_AT_byte_size, 40)
+                                  .udata(DW_AT_decl_file, 2)
+                                  .udata(DW_AT_decl_line, line)
+                                  .id();
+                build.addMember(record, "id", i32, 0);
+                build.addMember(record, "size", u64, 8);
+                build.addMember(record, "weight", f64, 16);
+                build.addMember(record, "label", str, 24);
+                build.addMember(record, "link", build.addPointer(ns, prev), 32);
+
+                build.add(ns, DW_TAG_typedef)
+                    .name(std::format("record{}_{}_t", cuIdx, typeIdx))
+                    .ref(DW_AT_type, record)
+                    .udata(DW_AT_decl_file, 2)
+                    .udata(DW_AT_decl_line, line + 1);
+                build.add(ns, DW_TAG_variable)
+                    .name(std::format("instance{}_{}", cuIdx, typeIdx))
+                    .ref(DW_AT_type, build.addPointer(ns, record))
+                    .flag(DW_AT_external)
+                    .udata(DW_AT_decl_file, 2)
+                    .udata(DW_AT_decl_line, line + 2);
+                if (typeIdx % 4 == 0)
+                {
+                    auto kind = build.add(ns, DW_TAG_enumeration_type)
+                                    .name(std::format("kind{}_{}", cuIdx, typeIdx))
+                                    .ref(DW_AT_type, i32)
+                                    .udata(DW_AT_byte_size, 4)
+                                    .udata(DW_AT_decl_file, 2)
+                                    .udata(DW_AT_decl_line, line + 3)
+                                    .id();
+                    for (int64_t value = 0; value < 16; value++)
+                        build.addEnumerator(kind, std::format("kind{}_{}_{}", cuIdx, typeIdx, value), value);
+                }
+                prev = record;
+            }
+        }
+        build.finish();
+    }
+};
+
+struct benchmark
+{
+    const char *name;
+    const char *unit; // what `state::setItems` counts
+    void (*run)(const corpus &input, state &run);
+};
+
+/* ====================================================================================== */
+
+template <typename Fn>
+static void walk(dw::file &dwFile, dw::die &DIE, Fn &&fn)
+{
+    for (auto &&child : DIE.getChildren(dwFile))
+    {
+        fn(child);
+        walk(dwFile, child, fn);
+    }
+}
+
+// materializes the whole tree as pruned stubs, no attribute is decoded
+static uint64_t walkStubs(dw::file &dwFile, dw::die &DIE)
+{
+    uint64_t count = 0;
+    for (auto &&child : DIE.getChildren(dwFile, [](const dw::rawDIE &) { return true; }))
+        count += 1 + walkStubs(dwFile, child);
+    return count;
+}
+
+static void clearCaches(dw::file &dwFile)
+{
+    for (auto &&compileUnit : dwFile.getCUs())
+        compileUnit.clearCachedChildren();
+}
+
+static void benchOpen(const corpus &input, state &run)
+{
+    run.pause();
+    auto dwFile = input.open();
+    run.addTime(dwFile->getInitTimes().openNs);
+    run.setItems(1);
+}
+
+static void benchScan(const corpus &input, state &run)
+{
+    run.pause();
+    auto dwFile = input.open();
+    run.addTime(dwFile->getInitTimes().scanNs);
+    run.setItems(dwFile->getCUs().size());
+}
+
+static void benchMaterialize(const corpus &input, state &run)
+{
+    run.pause();
+    auto dwFile = input.open();
+    run.resume();
+    uint64_t count = 0;
+    for (auto &&compileUnit : dwFile->getCUs())
+        count += walkStubs(*dwFile, compileUnit);
+    run.pause();
+    run.setItems(count);
+}
+
+// the stubs are in place before the clock starts, so only the attribute lists are read
+static void benchDecode(const corpus &input, state &run)
+{
+    run.pause();
+    auto dwFile = input.open();
+    for (auto &&compileUnit : dwFile->getCUs())
+        walkStubs(*dwFile, compileUnit);
+    run.resume();
+    uint64_t count = 0;
+    for (auto &&compileUnit : dwFile->getCUs())
+        walk(*dwFile, compileUnit, [&](dw::die &) { ++count; });
+    run.pause();
+    run.setItems(count);
+}
+
+// offsets spread evenly over the file in a fixed shuffled order, starting from empty CU caches
+static void benchLookup(const corpus &input, state &run)
+{
+    run.pause();
+    auto                  dwFile = input.open();
+    std::vector<uint64_t> offsets;
+    for (auto &&compileUnit : dwFile->getCUs())
+        walk(*dwFile, compileUnit, [&](dw::die &DIE) { offsets.push_back(DIE.getOffset()); });
+    clearCaches(*dwFile);
+    uint32_t lookups = input.getOptions().lookups;
+    if (offsets.size() > lookups)
+    {
+        std::vector<uint64_t> sampled;
+        sampled.reserve(lookups);
+        for (uint64_t idx = 0; idx < lookups; idx++)
+            sampled.push_back(offsets[idx * offsets.size() / lookups]);
+        offsets = std::move(sampled);
+    }
+    std::shuffle(offsets.begin(), offsets.end(), std::mt19937_64{0x5eed});
+
+    run.resume();
+    uint64_t found = 0;
+    for (auto &&offset : offsets)
+        found += dwFile->findDIEbyOffset(offset) != nullptr;
+    run.pause();
+    if (found != offsets.size())
+        std::println(stderr, "[Bench] offset lookup: {} of {} offsets not found", offsets.size() - found, offsets.size());
+    run.setItems(offsets.size());
+}
+
+// every die with a DW_AT_type, through a fresh type cache
+static void benchTypeNames(const corpus &input, state &run)
+{
+    run.pause();
+    auto                         dwFile = input.open();
+    std::vector<const dw::die *> typed;
+    for (auto &&compileUnit : dwFile->getCUs())
+    {
+        walk(*dwFile, compileUnit, [&](dw::die &DIE) {
+            if (DIE.findAttrByType(DW_AT_type))
+                typed.push_back(&DIE);
+        });
+    }
+
+    run.resume();
+    typeNamer namer{*dwFile};
+    for (auto &&DIE : typed)
+        namer.getTypeInfo(*DIE);
+    run.pause();
+    run.setItems(typed.size());
+}
+
+static void benchJson(const corpus &input, state &run)
+{
+    run.pause();
+    auto engine = input.openEngine();
+    run.resume();
+    engine->start();
+    run.pause();
+    run.setItems(engine->getFile().getCUs().size());
+}
+
+static void benchSerialize(const corpus &input, state &run)
+{
+    run.pause();
+    auto engine = input.openEngine();
+    engine->start();
+    benchRunner::countingBuffer buffer;
+    std::ostream                sink{&buffer};
+    run.resume();
+    engine->writeData(sink);
+    run.pause();
+    run.setItems(buffer.mBytes);
+}
+
+static constexpr benchmark benchmarks[] = {
+    {"file open", "file", benchOpen},
+    {"CU scan", "CU", benchScan},
+    {"materialize", "die", benchMaterialize},
+    {"attr decode", "die", benchDecode},
+    {"offset lookup", "lookup", benchLookup},
+    {"type names", "die", benchTypeNames},
+    {"json build", "CU", benchJson},
+    {"serialize", "byte", benchSerialize},
+};
+
+/* ====================================================================================== */
+
+struct result
+{
+    const benchmark     *bench;
+    benchRunner::summary summary; // ns
+    uint64_t             items;
+};
+
+// the medians of a previous `--save`, keyed by benchmark name
+static int loadBaseline(const std::string &path, nlohmann::json &out)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return -1;
+    out = nlohmann::json::parse(file, nullptr, false);
+    return out.is_discarded() || !out.contains("benchmarks") ? -1 : 0;
+}
+
+static int saveBaseline(const std::string &path, const corpus &input, const options &opts, const std::vector<result> &results)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return -1;
+    nlohmann::json out;
+    out["input"] = input.name();
+    out["iterations"] = opts.iterations;
+    out["timestamp"] = std::time(nullptr);
+    for (auto &&item : results)
+    {
+        out["benchmarks"][item.bench->name] = {
+            {"median_ns", item.summary.median}, {"min_ns", item.summary.min}, {"p90_ns", item.summary.p90}, {"items", item.items}};
+    }
+    file << out.dump(4) << '\n';
+    std::println("[Bench] baseline written to {}", path);
+    return 0;
+}
+
+/**
+ * @return the number of benchmarks slower than the baseline by more than the threshold
+ */
+static int report(const std::vector<result> &results, const nlohmann::json *baseline, double threshold)
+{
+    int regressions = 0;
+    std::println("[Bench] {:<14} {:>12} {:>12} {:>12} {:>12} {:>12}  {}", "benchmark", "items", "median ms", "min ms", "p90 ms",
+                 "ns/item", baseline ? "vs baseline" : "");
+    for (auto &&item : results)
+    {
+        std::string verdict;
+        if (baseline)
+        {
+            const auto &saved = (*baseline)["benchmarks"];
+            if (!saved.contains(item.bench->name))
+                verdict = "not in baseline";
+            else
+            {
+                double   before = saved[item.bench->name].value("median_ns", 0.0);
+                uint64_t beforeItems = saved[item.bench->name].value("items", uint64_t(0));
+                double   change = before > 0 ? (item.summary.median / before - 1) * 100 : 0;
+                verdict = std::format("{:+.1f}%", change);
+                if (change > threshold)
+                {
+                    verdict += " REGRESSION";
+                    ++regressions;
+                }
+                else if (change < -threshold)
+                    verdict += " faster";
+                if (beforeItems != item.items)
+                    verdict += std::format(" ({} {}s in baseline, different input?)", beforeItems, item.bench->unit);
+            }
+        }
+        std::println("[Bench] {:<14} {:>12} {:>12.3f} {:>12.3f} {:>12.3f} {:>12.1f}  {}", item.bench->name,
+                     std::format("{} {}", item.items, item.bench->unit), item.summary.median / 1e6, item.summary.min / 1e6,
+                     item.summary.p90 / 1e6, item.items ? item.summary.median / item.items : 0.0, verdict);
+    }
+    if (baseline)
+        std::println("[Bench] {} regressions beyond {:.1f}%", regressions, threshold);
+    return regressions;
+}
+
+/**
+ * @brief a whole non-negative number in [min, max], anything else (signs, trailing characters, overflow) is rejected
+ */
+static bool parseCount(std::string_view arg, uint32_t min, uint32_t max, uint32_t &value)
+{
+    size_t        parsed = 0;
+    unsigned long count = 0;
+    try
+    {
+        count = std::stoul(std::string{arg}, &parsed);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    if (arg.empty() || arg.front() == '-' || parsed != arg.size() || count < min || count > max)
+        return false;
+    value = static_cast<uint32_t>(count);
+    return true;
+}
+
+static bool parsePercent(std::string_view arg, double &value)
+{
+    size_t parsed = 0;
+    double percent = 0;
+    try
+    {
+        percent = std::stod(std::string{arg}, &parsed);
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    if (parsed != arg.size() || !std::isfinite(percent) || percent < 0)
+        return false;
+    value = percent;
+    return true;
+}
+
+static void usage()
+{
+    std::cerr << "Usage: dwarfBench [<input file>] --iterations <n> --warmup <n> --filter <name> --lookups <n>\n"
+              << "                  --save <baseline file> --baseline <baseline file> --threshold <percent>\n"
+              << "                  --synthetic-cus <n> --synthetic-types <n> --list\n"
+              << "Without an input file a synthetic corpus is built in memory.\n"
+              << "Exit code 3 means a benchmark regressed beyond the threshold.\n";
+}
+
+int main(int argc, char **argv)
+{
+    using namespace std::string_literals;
+    options opts;
+    struct numericOption
+    {
+        const char *name;
+        uint32_t   *value;
+        uint32_t    min;
+        uint32_t    max;
+    };
+    const numericOption numeric[] = {
+        {"--iterations", &opts.iterations, 1, 100000},
+        {"--warmup", &opts.warmup, 0, 100000},
+        {"--lookups", &opts.lookups, 1, UINT32_MAX},
+        {"--synthetic-cus", &opts.syntheticCUs, 1, 100000},
+        {"--synthetic-types", &opts.syntheticTypes, 1, 100000},
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        auto found = std::find_if(std::begin(numeric), std::end(numeric), [&](const numericOption &item) { return argv[i] == std::string_view{item.name}; });
+        if (found != std::end(numeric) && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            if (!parseCount(arg, found->min, found->max, *found->value))
+            {
+                std::cerr << "Invalid " << found->name << " value: " << arg << " (" << found->min << " to " << found->max << ")\n";
+                return 1;
+            }
+        }
+        else if (argv[i] == "--filter"s && i + 1 < argc)
+            opts.filter = argv[++i];
+        else if (argv[i] == "--save"s && i + 1 < argc)
+            opts.savePath = argv[++i];
+        else if (argv[i] == "--baseline"s && i + 1 < argc)
+            opts.baselinePath = argv[++i];
+        else if (argv[i] == "--threshold"s && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            if (!parsePercent(arg, opts.threshold))
+            {
+                std::cerr << "Invalid --threshold value: " << arg << " (a percentage of at least 0)\n";
+                return 1;
+            }
+        }
+        else if (argv[i] == "--list"s)
+        {
+            for (auto &&item : benchmarks)
+                std::println("{}", item.name);
+            return 0;
+        }
+        else if (argv[i][0] != '-' && opts.input.empty())
+            opts.input = argv[i];
+        else
+        {
+            std::cerr << "Unknown option: " << argv[i] << '\n';
+            usage();
+            return 1;
+        }
+    }
+
+    nlohmann::json baseline;
+    if (!opts.baselinePath.empty() && loadBaseline(opts.baselinePath, baseline) == -1)
+    {
+        std::cerr << "Error: unable to read baseline " << opts.baselinePath << '\n';
+        return 1;
+    }
+
+    corpus input{opts};
+    if (!input.open()->isOpen())
+    {
+        std::cerr << "Error: unable to open " << input.name() << '\n';
+        return 1;
+    }
+    std::println("[Bench] {}: {} iterations after {} warmup", input.name(), opts.iterations, opts.warmup);
+
+    std::vector<result> results;
+    for (auto &&item : benchmarks)
+    {
+        if (std::string_view{item.name}.find(opts.filter) == std::string_view::npos)
+            continue;
+        std::vector<double> samples;
+        uint64_t            items = 0;
+        for (uint32_t idx = 0; idx < opts.warmup + opts.iterations; idx++)
+        {
+            state run;
+            run.resume();
+            item.run(input, run);
+            run.pause();
+            if (idx < opts.warmup)
+                continue;
+            samples.push_back(double(run.elapsedNs()));
+            items = run.items();
+        }
+        results.push_back({&item, benchRunner::summarize(std::move(samples)), items});
+    }
+
+    int regressions = report(results, opts.baselinePath.empty() ? nullptr : &baseline, opts.threshold);
+    if (!opts.savePath.empty() && saveBaseline(opts.savePath, input, opts, results) == -1)
+    {
+        std::cerr << "Error: unable to write " << opts.savePath << '\n';
+        return 2;
+    }
+    return regressions ? 3 : 0;
+}
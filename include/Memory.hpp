@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <print>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// replacing the global operator new (src/memory.cpp) is opt in: configure with -DDWARF_MEMORY_ACCOUNTING=ON,
+// without it `--mem-report` is ignored and allocations go straight to the default operator new
+#ifndef MEMORY_ACCOUNTING
+#define MEMORY_ACCOUNTING 0
+#endif
+
+/**
+ * Heap usage by subsystem. Every operator new is tagged with the category of the enclosing `memory::tag`,
+ * counting only starts once `memory::session` is enabled (`--mem-report`). In a MEMORY_ACCOUNTING build every
+ * allocation pays a 16 byte header and a relaxed load even while counting is off. libdwarf allocates with malloc, its share is estimated from the malloc
+ * statistics minus what went through operator new.
+ */
+namespace memory
+{
+    enum class category : uint8_t
+    {
+        other,
+        dieTree,  // dw::die children, attributes and expression arenas
+        srcFiles, // CU file tables and their simplified copies
+        jsonDom,  // nlohmann::json output trees
+        count
+    };
+
+    inline constexpr size_t categoryCount = size_t(category::count);
+
+    inline constexpr std::array<std::string_view, categoryCount> categoryNames{"other", "dw::die trees", "CU srcfiles", "json DOM"};
+
+    // marks a block allocated before accounting was enabled
+    inline constexpr uint8_t untracked = 0xff;
+
+    struct alignas(16) header
+    {
+        uint64_t size;
+        uint8_t  category;
+    };
+
+    inline constinit std::atomic<bool>                                 gEnabled = false;
+    inline constinit std::array<std::atomic<int64_t>, categoryCount>   gCurrent{};
+    inline constinit std::array<std::atomic<int64_t>, categoryCount>   gPeak{};
+    inline constinit std::atomic<int64_t>                              gBlocks = 0;
+    inline constinit thread_local category                             tlsCategory = category::other;
+    inline constinit thread_local int64_t                              tlsBytes = 0; // net bytes of this thread, see `cuScope`
+    inline constinit thread_local int64_t                              tlsPeak = 0;
+
+    inline bool enabled() noexcept
+    {
+        return gEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief allocations of this thread go to `item` until the tag is destroyed, tags nest
+     */
+    class tag
+    {
+        category mPrev;
+
+    public:
+        explicit tag(category item) noexcept :
+            mPrev(tlsCategory)
+        {
+            tlsCategory = item;
+        }
+
+        tag(const tag &) = delete;
+
+        ~tag()
+        {
+            tlsCategory = this->mPrev;
+        }
+    };
+
+    inline void _count(uint8_t item, int64_t bytes) noexcept
+    {
+        int64_t current = gCurrent[item].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        gBlocks.fetch_add(bytes > 0 ? 1 : -1, std::memory_order_relaxed);
+        tlsBytes += bytes;
+        tlsPeak = std::max(tlsPeak, tlsBytes);
+        if (bytes <= 0)
+            return;
+        int64_t peak = gPeak[item].load(std::memory_order_relaxed);
+        while (current > peak && !gPeak[item].compare_exchange_weak(peak, current, std::memory_order_relaxed))
+            ;
+    }
+
+    /**
+     * @brief the body of the replaced operator new, `align` is at least 16
+     * @return nullptr on failure
+     */
+    inline void *allocate(size_t size, size_t align) noexcept
+    {
+        // the header sits right before the returned block, an over-aligned block gets a whole alignment unit for it
+        size_t offset = std::max(align, sizeof(header));
+        void  *base = align > alignof(std::max_align_t) ? std::aligned_alloc(align, (offset + size + align - 1) / align * align)
+                                                        : std::malloc(offset + size);
+        if (!base)
+            return nullptr;
+        auto   *block = static_cast<char *>(base) + offset;
+        header *info = reinterpret_cast<header *>(block) - 1;
+        info->size = size;
+        info->category = untracked;
+        if (enabled())
+        {
+            info->category = uint8_t(tlsCategory);
+            _count(info->category, int64_t(size));
+        }
+        return block;
+    }
+
+    inline void deallocate(void *block, size_t align) noexcept
+    {
+        if (!block)
+            return;
+        header *info = static_cast<header *>(block) - 1;
+        if (info->category != untracked)
+            _count(info->category, -int64_t(info->size));
+        std::free(static_cast<char *>(block) - std::max(align, sizeof(header)));
+    }
+
+    /**
+     * @brief bytes allocated by the current thread inside the scope, keyed by CU name
+     */
+    class cuScope
+    {
+        std::string_view mName;
+        int64_t          mStartBytes = 0;
+        int64_t          mOuterPeak = 0;
+
+    public:
+        explicit cuScope(std::string_view name) noexcept :
+            mName(name)
+        {
+            if (!enabled())
+                return;
+            this->mStartBytes = tlsBytes;
+            this->mOuterPeak = tlsPeak;
+            tlsPeak = tlsBytes;
+        }
+
+        cuScope(const cuScope &) = delete;
+
+        ~cuScope();
+    };
+
+    struct cuRecord
+    {
+        std::string name;
+        int64_t     retained; // still allocated when the CU was done, e.g. its json
+        int64_t     peak;
+    };
+
+    /**
+     * @brief resident set size and the heap outside operator new, sampled by a background thread
+     */
+    class sampler
+    {
+        std::mutex                  mMutex;
+        std::condition_variable_any mWake;
+        std::jthread                mThread;
+        int64_t                     mPeakRss = 0;
+        int64_t                     mPeakUntracked = 0;
+
+    public:
+        static int64_t rssBytes() noexcept
+        {
+            FILE *statm = std::fopen("/proc/self/statm", "r");
+            if (!statm)
+                return 0;
+            long long size = 0, resident = 0;
+            int       read = std::fscanf(statm, "%lld %lld", &size, &resident);
+            std::fclose(statm);
+            return read == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+        }
+
+        // peak RSS as recorded by the kernel, covers spikes between two samples
+        static int64_t hwmBytes() noexcept
+        {
+            FILE *status = std::fopen("/proc/self/status", "r");
+            if (!status)
+                return 0;
+            char      line[256];
+            long long kb = 0;
+            while (std::fgets(line, sizeof(line), status))
+            {
+                if (std::sscanf(line, "VmHWM: %lld kB", &kb) == 1)
+                    break;
+            }
+            std::fclose(status);
+            return kb * 1024;
+        }
+
+        /**
+         * @brief malloc'd bytes that did not go through operator new, mostly libdwarf
+         * @return -1 if the C library has no malloc statistics
+         */
+        static int64_t untrackedHeapBytes() noexcept
+        {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+            int64_t tracked = gBlocks.load(std::memory_order_relaxed) * int64_t(sizeof(header));
+            for (auto &&item : gCurrent)
+                tracked += item.load(std::memory_order_relaxed);
+            return std::max<int64_t>(int64_t(mallinfo2().uordblks) - tracked, 0);
+#else
+            return -1;
+#endif
+        }
+
+        void start(std::chrono::milliseconds interval)
+        {
+            this->mThread = std::jthread{[this, interval](std::stop_token stop) {
+                std::unique_lock lock{this->mMutex};
+                do
+                {
+                    this->mPeakRss = std::max(this->mPeakRss, rssBytes());
+                    this->mPeakUntracked = std::max(this->mPeakUntracked, untrackedHeapBytes());
+                } while (!this->mWake.wait_for(lock, stop, interval, [&stop] { return stop.stop_requested(); }));
+            }};
+        }
+
+        void stop()
+        {
+            this->mThread = {};
+        }
+
+        std::pair<int64_t, int64_t> peaks()
+        {
+            std::lock_guard lock{this->mMutex};
+            return {std::max(this->mPeakRss, rssBytes()), std::max(this->mPeakUntracked, untrackedHeapBytes())};
+        }
+    };
+
+    class registry
+    {
+        std::mutex            mMutex;
+        std::vector<cuRecord> mCUs;
+        sampler               mSampler;
+
+    public:
+        static registry &get()
+        {
+            static registry instance;
+            return instance;
+        }
+
+        void enable(std::chrono::milliseconds interval = std::chrono::milliseconds{20})
+        {
+            gEnabled.store(true, std::memory_order_relaxed);
+            this->mSampler.start(interval);
+        }
+
+        void addCU(std::string_view name, int64_t retained, int64_t peak)
+        {
+            std::lock_guard lock{this->mMutex};
+            this->mCUs.push_back({std::string{name}, retained, peak});
+        }
+
+        void report(size_t topCUs = 10);
+    };
+
+    inline cuScope::~cuScope()
+    {
+        if (!enabled())
+            return;
+        registry::get().addCU(this->mName, tlsBytes - this->mStartBytes, tlsPeak - this->mStartBytes);
+        tlsPeak = std::max(this->mOuterPeak, tlsPeak);
+    }
+
+    inline void registry::report(size_t topCUs)
+    {
+        auto [peakRss, peakUntracked] = this->mSampler.peaks();
+        this->mSampler.stop();
+        gEnabled.store(false, std::memory_order_relaxed);
+
+        auto mib = [](int64_t bytes) { return bytes / (1024.0 * 1024.0); };
+        std::println("[Memory] {:>14} {:>14}  category", "current MiB", "peak MiB");
+        int64_t current = 0;
+        for (size_t idx = 0; idx < categoryCount; idx++)
+        {
+            int64_t bytes = gCurrent[idx].load(std::memory_order_relaxed);
+            current += bytes;
+            std::println("[Memory] {:>14.2f} {:>14.2f}  {}", mib(bytes), mib(gPeak[idx].load(std::memory_order_relaxed)), categoryNames[idx]);
+        }
+        std::println("[Memory] {:>14.2f} {:>14}  operator new total", mib(current), "");
+        if (int64_t untracked = sampler::untrackedHeapBytes(); untracked != -1)
+            std::println("[Memory] {:>14.2f} {:>14.2f}  malloc outside operator new (libdwarf), sampled peak", mib(untracked), mib(peakUntracked));
+        std::println("[Memory] {:>14.2f} {:>14.2f}  RSS, sampled peak", mib(sampler::rssBytes()), mib(peakRss));
+        if (int64_t hwm = sampler::hwmBytes())
+            std::println("[Memory] {:>14} {:>14.2f}  RSS, kernel high-water mark", "", mib(hwm));
+
+        std::lock_guard lock{this->mMutex};
+        if (this->mCUs.empty())
+            return;
+        std::sort(this->mCUs.begin(), this->mCUs.end(), [](const cuRecord &a, const cuRecord &b) { return a.peak > b.peak; });
+        std::println("[Memory] {:>14} {:>14}  CU ({} of {} by peak)", "retained MiB", "peak MiB", std::min(topCUs, this->mCUs.size()),
+                     this->mCUs.size());
+        for (size_t idx = 0; idx < std::min(topCUs, this->mCUs.size()); idx++)
+            std::println("[Memory] {:>14.2f} {:>14.2f}  {}", mib(this->mCUs[idx].retained), mib(this->mCUs[idx].peak), this->mCUs[idx].name);
+    }
+
+    /**
+     * @brief count allocations for the enclosing scope (e.g. `main`) and print the report when leaving it
+     */
+    class session
+    {
+        bool mEnabled;
+
+    public:
+        explicit session(bool enable) :
+            mEnabled(enable && MEMORY_ACCOUNTING)
+        {
+            if (this->mEnabled)
+                registry::get().enable();
+        }
+
+        ~session()
+        {
+            if (this->mEnabled)
+                registry::get().report();
+        }
+    };
+} // namespace memory
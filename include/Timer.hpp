@@ -1,62 +1,621 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
-#include <source_location>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <mutex>
 #include <print>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
-class TimerToken
+// TIMER_ENABLED=0 compiles every Timer scope out
+#ifndef TIMER_ENABLED
+#define TIMER_ENABLED 1
+#endif
+
+// clock used by the scopes, selected at compile time
+#define TIMER_CLOCK_STEADY 0 // std::chrono::steady_clock
+#define TIMER_CLOCK_RDTSC  1 // x86 time stamp counter, converted to ns at report time
+#define TIMER_CLOCK_COARSE 2 // clock_gettime(CLOCK_MONOTONIC_COARSE), cheapest but jiffy resolution
+#ifndef TIMER_CLOCK
+#define TIMER_CLOCK TIMER_CLOCK_STEADY
+#endif
+
+#if TIMER_CLOCK == TIMER_CLOCK_RDTSC
+#include <x86intrin.h>
+#elif TIMER_CLOCK == TIMER_CLOCK_COARSE
+#include <time.h>
+#endif
+
+// TIMER_PERF_COUNTERS=1 lets scopes also count cycles, instructions, cache and branch misses (Linux perf_event_open),
+// requested at run time with `timing::enableCounters()`
+#ifndef TIMER_PERF_COUNTERS
+#define TIMER_PERF_COUNTERS 0
+#endif
+#if TIMER_PERF_COUNTERS && !defined(__linux__)
+#undef TIMER_PERF_COUNTERS
+#define TIMER_PERF_COUNTERS 0
+#endif
+
+#if TIMER_PERF_COUNTERS
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace timing
 {
-public:
-    TimerToken(const std::source_location &location = std::source_location::current()) :
-        mSource(location) {}
+    inline uint64_t now() noexcept
+    {
+#if TIMER_CLOCK == TIMER_CLOCK_RDTSC
+        return __rdtsc();
+#elif TIMER_CLOCK == TIMER_CLOCK_COARSE
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
 
-    ~TimerToken()
+    inline uint64_t steadyNs() noexcept
     {
-        std::println("[Timer] {} ({} {}:{}) ",
-                     this->mDuration.count(),
-                     this->mSource.function_name(),
-                     this->mSource.line(),
-                     this->mSource.column());
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
-    void addDuration(const std::chrono::duration<double> &d)
+    // cycles, instructions, cache misses, branch misses; empty without TIMER_PERF_COUNTERS
+    inline constexpr size_t counterCount = TIMER_PERF_COUNTERS ? 4 : 0;
+    using counterSet = std::array<uint64_t, counterCount>;
+
+#if TIMER_PERF_COUNTERS
+    /**
+     * @brief the calling thread's hardware counters, one perf event group read with a single syscall
+     */
+    class perfGroup
+    {
+        std::array<int, counterCount> mFds{-1, -1, -1, -1};
+
+    public:
+        perfGroup() = default;
+        perfGroup(const perfGroup &) = delete;
+
+        ~perfGroup()
+        {
+            for (auto &&fd : this->mFds)
+            {
+                if (fd != -1)
+                    close(fd);
+            }
+        }
+
+        bool isOpen() const noexcept
+        {
+            return this->mFds[0] != -1;
+        }
+
+        /**
+         * @return 0 on success, otherwise the errno of the failing perf_event_open
+         */
+        int open() noexcept
+        {
+            static constexpr std::array<uint64_t, counterCount> configs{
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for (size_t idx = 0; idx < counterCount; idx++)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[idx];
+                attr.disabled = idx == 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP;
+                int fd = syscall(SYS_perf_event_open, &attr, 0, -1, idx == 0 ? -1 : this->mFds[0], 0);
+                if (fd == -1)
+                {
+                    int err = errno;
+                    for (auto &&opened : this->mFds)
+                    {
+                        if (opened != -1)
+                            close(opened);
+                        opened = -1;
+                    }
+                    return err;
+                }
+                this->mFds[idx] = fd;
+            }
+            ioctl(this->mFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(this->mFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            return 0;
+        }
+
+        void read(counterSet &out) const noexcept
+        {
+            uint64_t buffer[1 + counterCount];
+            if (!this->isOpen() || ::read(this->mFds[0], buffer, sizeof(buffer)) != sizeof(buffer))
+            {
+                out.fill(0);
+                return;
+            }
+            std::copy(buffer + 1, buffer + 1 + counterCount, out.begin());
+        }
+    };
+#endif
+
+    /**
+     * @brief one scope in a call tree, the same token reached through different parents gets different nodes
+     */
+    struct node
+    {
+        uint32_t                                   token;
+        uint32_t                                   parent;
+        uint64_t                                   calls = 0;
+        uint64_t                                   ticks = 0;      // total time
+        uint64_t                                   childTicks = 0; // time spent in child scopes
+        counterSet                                 counters{};
+        counterSet                                 childCounters{};
+        std::vector<std::pair<uint32_t, uint32_t>> children{}; // token -> node index
+
+        uint32_t findChild(uint32_t childToken) const noexcept
+        {
+            for (auto &&[key, idx] : this->children)
+            {
+                if (key == childToken)
+                    return idx;
+            }
+            return 0;
+        }
+    };
+
+    /**
+     * @brief process wide token names and the call tree merged from every thread
+     */
+    class registry
+    {
+        std::mutex               mMutex;
+        std::vector<std::string> mNames;
+        std::vector<node>        mMerged{node{.token = 0, .parent = 0}};
+        uint64_t                 mStartTicks = now();
+        uint64_t                 mStartNs = steadyNs();
+        std::atomic<bool>        mCountersRequested = false;
+        bool                     mCountersUsed = false;
+        std::string              mCountersError;
+
+    public:
+        static registry &get()
+        {
+            static registry instance;
+            return instance;
+        }
+
+        uint32_t addToken(std::string name)
+        {
+            std::lock_guard lock{this->mMutex};
+            this->mNames.emplace_back(std::move(name));
+            return this->mNames.size();
+        }
+
+        bool countersRequested() const noexcept
+        {
+            return this->mCountersRequested.load(std::memory_order_relaxed);
+        }
+
+        void requestCounters() noexcept
+        {
+            this->mCountersRequested = true;
+        }
+
+        /**
+         * @brief a thread could not open its counters, the report falls back to time only for that thread
+         */
+        void countersFailed(int err)
+        {
+            std::lock_guard lock{this->mMutex};
+            if (this->mCountersError.empty())
+                this->mCountersError = std::format("{} ({})", std::strerror(err), err == EACCES ? "check /proc/sys/kernel/perf_event_paranoid" : "no PMU access");
+        }
+
+        /**
+         * @brief add the counts of a thread's tree, token ids are global so nodes are matched by token path
+         */
+        void merge(const std::vector<node> &nodes)
+        {
+            std::lock_guard lock{this->mMutex};
+            this->_merge(nodes, 0, 0);
+        }
+
+        /**
+         * @brief print the call tree and a flat table sorted by self time, optionally write both as JSON
+         */
+        void report(const std::string &jsonPath);
+
+    private:
+        void _merge(const std::vector<node> &nodes, uint32_t from, uint32_t to)
+        {
+            this->mMerged[to].calls += nodes[from].calls;
+            this->mMerged[to].ticks += nodes[from].ticks;
+            this->mMerged[to].childTicks += nodes[from].childTicks;
+            for (size_t idx = 0; idx < counterCount; idx++)
+            {
+                this->mMerged[to].counters[idx] += nodes[from].counters[idx];
+                this->mMerged[to].childCounters[idx] += nodes[from].childCounters[idx];
+                this->mCountersUsed |= nodes[from].counters[idx] != 0;
+            }
+            for (auto &&[childToken, childIdx] : nodes[from].children)
+            {
+                uint32_t target = this->mMerged[to].findChild(childToken);
+                if (!target)
+                {
+                    target = this->mMerged.size();
+                    this->mMerged.push_back(node{.token = childToken, .parent = to});
+                    this->mMerged[to].children.emplace_back(childToken, target);
+                }
+                this->_merge(nodes, childIdx, target);
+            }
+        }
+
+        std::string_view _name(uint32_t token) const noexcept
+        {
+            return token ? std::string_view{this->mNames[token - 1]} : std::string_view{"<root>"};
+        }
+
+        static counterSet _selfCounters(const node &item) noexcept
+        {
+            counterSet ret{};
+            for (size_t idx = 0; idx < counterCount; idx++)
+                ret[idx] = item.counters[idx] - std::min(item.counters[idx], item.childCounters[idx]);
+            return ret;
+        }
+
+        // IPC, cache and branch misses per 1000 instructions
+        std::string _counterColumns([[maybe_unused]] const counterSet &counters) const
+        {
+#if TIMER_PERF_COUNTERS
+            if (!this->mCountersUsed)
+                return "";
+            double cycles = counters[0], instructions = counters[1];
+            return std::format(" {:>6.2f} {:>10.2f} {:>10.2f}", cycles ? instructions / cycles : 0.0,
+                               instructions ? counters[2] * 1000 / instructions : 0.0, instructions ? counters[3] * 1000 / instructions : 0.0);
+#else
+            return "";
+#endif
+        }
+
+        std::string _counterJson([[maybe_unused]] const counterSet &counters) const
+        {
+#if TIMER_PERF_COUNTERS
+            if (!this->mCountersUsed)
+                return "";
+            return std::format(R"(, "cycles": {}, "instructions": {}, "cache_misses": {}, "branch_misses": {})",
+                               counters[0], counters[1], counters[2], counters[3]);
+#else
+            return "";
+#endif
+        }
+
+        static std::string _escape(std::string_view str)
+        {
+            std::string ret;
+            for (auto &&ch : str)
+            {
+                if (ch == '"' || ch == '\\')
+                    ret += '\\';
+                ret += ch;
+            }
+            return ret;
+        }
+
+        void _sortedChildren(uint32_t idx, std::vector<uint32_t> &out) const
+        {
+            out.clear();
+            for (auto &&[token, childIdx] : this->mMerged[idx].children)
+            {
+                if (this->mMerged[childIdx].calls)
+                    out.emplace_back(childIdx);
+            }
+            std::sort(out.begin(), out.end(), [this](uint32_t a, uint32_t b) { return this->mMerged[a].ticks > this->mMerged[b].ticks; });
+        }
+    };
+
+    /**
+     * @brief the calling thread's call tree, merged into the registry when the thread exits
+     */
+    class threadTree
     {
-        this->mDuration += d;
+        std::vector<node> mNodes{node{.token = 0, .parent = 0}};
+        uint32_t          mCurrent = 0;
+#if TIMER_PERF_COUNTERS
+        perfGroup mPerf;
+        bool      mPerfTried = false;
+#endif
+
+    public:
+        ~threadTree()
+        {
+            registry::get().merge(this->mNodes);
+        }
+
+        uint32_t enter(uint32_t token)
+        {
+            uint32_t idx = this->mNodes[this->mCurrent].findChild(token);
+            if (!idx)
+            {
+                idx = this->mNodes.size();
+                this->mNodes.push_back(node{.token = token, .parent = this->mCurrent});
+                this->mNodes[this->mCurrent].children.emplace_back(token, idx);
+            }
+            this->mCurrent = idx;
+            return idx;
+        }
+
+        void leave(uint32_t idx, uint64_t ticks, [[maybe_unused]] const counterSet &delta) noexcept
+        {
+            node &current = this->mNodes[idx];
+            ++current.calls;
+            current.ticks += ticks;
+            this->mNodes[current.parent].childTicks += ticks;
+            for (size_t counter = 0; counter < counterCount; counter++)
+            {
+                current.counters[counter] += delta[counter];
+                this->mNodes[current.parent].childCounters[counter] += delta[counter];
+            }
+            this->mCurrent = current.parent;
+        }
+
+#if TIMER_PERF_COUNTERS
+        // zeros if counters were not requested or can't be opened on this thread
+        void readCounters(counterSet &out)
+        {
+            if (!this->mPerfTried && registry::get().countersRequested())
+            {
+                this->mPerfTried = true;
+                if (int err = this->mPerf.open(); err != 0)
+                    registry::get().countersFailed(err);
+            }
+            this->mPerf.read(out);
+        }
+#endif
+
+        /**
+         * @brief merge now and zero the counts, scopes still open keep their nodes
+         */
+        void flush()
+        {
+            registry::get().merge(this->mNodes);
+            for (auto &&item : this->mNodes)
+            {
+                item.calls = item.ticks = item.childTicks = 0;
+                item.counters.fill(0);
+                item.childCounters.fill(0);
+            }
+        }
+    };
+
+    inline thread_local threadTree tls;
+
+    /**
+     * @brief capture hardware counters in every scope from now on
+     * @return false if built without TIMER_PERF_COUNTERS
+     */
+    inline bool enableCounters() noexcept
+    {
+#if TIMER_PERF_COUNTERS
+        registry::get().requestCounters();
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief print the timer report when leaving the enclosing scope (e.g. `main`), after the scopes declared later
+     */
+    class reportScope
+    {
+        std::string mJsonPath;
+
+    public:
+        explicit reportScope(std::string_view jsonPath = "") :
+            mJsonPath(jsonPath) {}
+
+        ~reportScope()
+        {
+#if TIMER_ENABLED
+            tls.flush();
+            registry::get().report(this->mJsonPath);
+#endif
+        }
+    };
+
+    inline void registry::report(const std::string &jsonPath)
+    {
+        std::lock_guard lock{this->mMutex};
+
+        double nsPerTick = 1.0;
+#if TIMER_CLOCK == TIMER_CLOCK_RDTSC
+        uint64_t elapsedTicks = now() - this->mStartTicks;
+        if (elapsedTicks)
+            nsPerTick = double(steadyNs() - this->mStartNs) / elapsedTicks;
+#endif
+        auto ms = [nsPerTick](uint64_t ticks) { return ticks * nsPerTick / 1e6; };
+
+        // flat view: self time adds up, total only counts the outermost scope of a recursive token
+        struct flatEntry
+        {
+            uint32_t token;
+            uint64_t calls = 0;
+            uint64_t ticks = 0;
+            uint64_t selfTicks = 0;
+            counterSet selfCounters{};
+        };
+        std::vector<flatEntry> flat(this->mNames.size() + 1);
+        for (uint32_t idx = 1; idx < this->mMerged.size(); idx++)
+        {
+            const node &item = this->mMerged[idx];
+            flatEntry  &entry = flat[item.token];
+            entry.token = item.token;
+            entry.calls += item.calls;
+            entry.selfTicks += item.ticks - std::min(item.ticks, item.childTicks);
+            counterSet selfCounters = _selfCounters(item);
+            for (size_t counter = 0; counter < counterCount; counter++)
+                entry.selfCounters[counter] += selfCounters[counter];
+            bool nested = false;
+            for (uint32_t parent = item.parent; parent && !nested; parent = this->mMerged[parent].parent)
+                nested = this->mMerged[parent].token == item.token;
+            if (!nested)
+                entry.ticks += item.ticks;
+        }
+        std::erase_if(flat, [](const flatEntry &entry) { return entry.calls == 0; });
+        std::sort(flat.begin(), flat.end(), [](const flatEntry &a, const flatEntry &b) { return a.selfTicks > b.selfTicks; });
+
+        std::string counterHeader = this->mCountersUsed ? std::format(" {:>6} {:>10} {:>10}", "IPC", "cache MPKI", "br MPKI") : "";
+        if (!this->mCountersError.empty())
+            std::println("[Timer] hardware counters unavailable: {}", this->mCountersError);
+        std::println("[Timer] {:>12} {:>12} {:>10}{}  scope", "total ms", "self ms", "calls", counterHeader);
+        auto printTree = [&](auto &&self, uint32_t idx, size_t depth) -> void {
+            std::vector<uint32_t> sorted;
+            this->_sortedChildren(idx, sorted);
+            for (auto &&childIdx : sorted)
+            {
+                const node &item = this->mMerged[childIdx];
+                std::println("[Timer] {:>12.3f} {:>12.3f} {:>10}{}  {:{}}{}", ms(item.ticks), ms(item.ticks - std::min(item.ticks, item.childTicks)),
+                             item.calls, this->_counterColumns(item.counters), "", depth * 2, this->_name(item.token));
+                self(self, childIdx, depth + 1);
+            }
+        };
+        printTree(printTree, 0, 0);
+        std::println("[Timer]");
+        std::println("[Timer] {:>12} {:>12} {:>10}{}  function", "self ms", "total ms", "calls", counterHeader);
+        for (auto &&entry : flat)
+            std::println("[Timer] {:>12.3f} {:>12.3f} {:>10}{}  {}", ms(entry.selfTicks), ms(entry.ticks), entry.calls,
+                         this->_counterColumns(entry.selfCounters), this->_name(entry.token));
+
+        if (jsonPath.empty())
+            return;
+        std::ofstream file(jsonPath);
+        if (!file.is_open())
+        {
+            std::println("[Timer] unable to write {}", jsonPath);
+            return;
+        }
+        auto writeTree = [&](auto &&self, uint32_t idx) -> void {
+            const node &item = this->mMerged[idx];
+            std::print(file, R"({{"name": "{}", "calls": {}, "total_ms": {:.6f}, "self_ms": {:.6f}{}, "children": [)",
+                       _escape(this->_name(item.token)), item.calls, ms(item.ticks), ms(item.ticks - std::min(item.ticks, item.childTicks)),
+                       this->_counterJson(item.counters));
+            std::vector<uint32_t> sorted;
+            this->_sortedChildren(idx, sorted);
+            for (size_t childIdx = 0; childIdx < sorted.size(); childIdx++)
+            {
+                if (childIdx)
+                    std::print(file, ", ");
+                self(self, sorted[childIdx]);
+            }
+            std::print(file, "]}}");
+        };
+        std::print(file, "{{\n    \"tree\": ");
+        writeTree(writeTree, 0);
+        std::print(file, ",\n    \"flat\": [");
+        for (size_t idx = 0; idx < flat.size(); idx++)
+        {
+            std::print(file, R"({}{{"name": "{}", "calls": {}, "total_ms": {:.6f}, "self_ms": {:.6f}{}}})",
+                       idx ? ",\n        " : "\n        ", _escape(this->_name(flat[idx].token)), flat[idx].calls, ms(flat[idx].ticks),
+                       ms(flat[idx].selfTicks), this->_counterJson(flat[idx].selfCounters));
+        }
+        std::println(file, "\n    ]\n}}");
+        std::println("Timer report output to {}", jsonPath);
     }
 
-    void lock()
+    /**
+     * @brief `void dwarf2json::parseDIE(dw::CU&, dw::die&)` -> `dwarf2json::parseDIE`
+     */
+    inline std::string shortName(std::string_view function)
     {
-        ++this->mLock;
+        size_t paren = function.find('(');
+        if (paren == std::string_view::npos)
+            return std::string{function};
+        std::string_view name = function.substr(0, paren);
+        size_t           space = name.rfind(' ');
+        return std::string{space == std::string_view::npos ? name : name.substr(space + 1)};
     }
+} // namespace timing
 
-    bool unlock()
+#if TIMER_ENABLED
+
+/**
+ * @brief one instrumented scope, declared as a function-static next to its `Timer`.
+ *        Only holds a process wide id, the counts live in per-thread trees
+ */
+class TimerToken
+{
+public:
+    TimerToken(const std::source_location &location = std::source_location::current()) :
+        mId(timing::registry::get().addToken(timing::shortName(location.function_name()))) {}
+
+    uint32_t id() const noexcept
     {
-        --this->mLock;
-        return this->mLock == 0;
+        return this->mId;
     }
 
 private:
-    int                           mLock;
-    std::source_location          mSource;
-    std::chrono::duration<double> mDuration;
+    uint32_t mId;
 };
 
 class Timer
 {
 public:
     Timer(TimerToken &token) :
-        start_time(std::chrono::steady_clock::now()), mToken(token)
+        mNode(timing::tls.enter(token.id()))
     {
-        token.lock();
+#if TIMER_PERF_COUNTERS
+        timing::tls.readCounters(this->mStartCounters);
+#endif
+        this->mStart = timing::now();
     }
 
     ~Timer()
     {
-        if (this->mToken.unlock())
-            this->mToken.addDuration(std::chrono::steady_clock::now() - start_time);
+        uint64_t           ticks = timing::now() - this->mStart;
+        timing::counterSet delta{};
+#if TIMER_PERF_COUNTERS
+        timing::tls.readCounters(delta);
+        for (size_t idx = 0; idx < timing::counterCount; idx++)
+            delta[idx] -= this->mStartCounters[idx];
+#endif
+        timing::tls.leave(this->mNode, ticks, delta);
     }
 
 private:
-    TimerToken                           &mToken;
-    std::chrono::steady_clock::time_point start_time;
-};
\ No newline at end of file
+    uint32_t mNode;
+    uint64_t mStart;
+#if TIMER_PERF_COUNTERS
+    timing::counterSet mStartCounters;
+#endif
+};
+
+#else
+
+class TimerToken
+{
+public:
+    TimerToken(const std::source_location & = std::source_location::current()) noexcept {}
+};
+
+class Timer
+{
+public:
+    Timer(TimerToken &) noexcept {}
+};
+
+#endif
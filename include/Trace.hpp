@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Timeline of the extraction phases in Chrome Trace Event format, viewable in Perfetto or about:tracing.
+ * Off unless `trace::recorder::get().enable()` is called, a disabled `trace::scope` costs one relaxed load.
+ */
+namespace trace
+{
+    inline uint64_t nowNs() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline std::string escape(std::string_view str)
+    {
+        std::string ret;
+        for (auto &&ch : str)
+        {
+            if (ch == '"' || ch == '\\')
+                ret += '\\';
+            if (static_cast<unsigned char>(ch) >= 0x20)
+                ret += ch;
+        }
+        return ret;
+    }
+
+    // a complete event ("ph": "X"), `name` must outlive the recorder (a literal)
+    struct event
+    {
+        std::string_view name;
+        std::string      args; // JSON members without braces, e.g. `"bytes": 10`
+        uint64_t         beginNs;
+        uint64_t         durationNs;
+    };
+
+    class threadBuffer;
+
+    class recorder
+    {
+        friend class threadBuffer;
+
+        struct retiredBuffer
+        {
+            uint32_t           tid;
+            std::string        name;
+            std::vector<event> events;
+        };
+
+        std::atomic<bool>           mEnabled = false;
+        size_t                      mCapacity = 0;
+        uint64_t                    mStartNs = nowNs();
+        std::atomic<uint32_t>       mNextTid = 0;
+        std::mutex                  mMutex;
+        std::vector<threadBuffer *> mLive;
+        std::vector<retiredBuffer>  mRetired;
+        uint64_t                    mDropped = 0;
+
+    public:
+        static recorder &get()
+        {
+            static recorder instance;
+            return instance;
+        }
+
+        /**
+         * @param capacity events kept per thread, older ones are overwritten
+         */
+        void enable(size_t capacity = 1 << 16)
+        {
+            this->mCapacity = std::max<size_t>(capacity, 1);
+            this->mStartNs = nowNs();
+            this->mEnabled.store(true, std::memory_order_release);
+        }
+
+        bool enabled() const noexcept
+        {
+            return this->mEnabled.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief write every thread's events, call once the worker threads have been joined
+         * @return -1 if the file can't be written
+         */
+        int dump(const std::string &path);
+
+    private:
+        void _retire(threadBuffer &buffer);
+    };
+
+    /**
+     * @brief the events of one thread, a ring of `recorder::mCapacity` entries
+     */
+    class threadBuffer
+    {
+        friend class recorder;
+
+        uint32_t           mTid;
+        std::string        mName;
+        std::vector<event> mRing;
+        size_t             mNext = 0;
+        uint64_t           mDropped = 0;
+
+    public:
+        threadBuffer() :
+            mTid(recorder::get().mNextTid++), mName(std::format("thread {}", mTid))
+        {
+            std::lock_guard lock{recorder::get().mMutex};
+            recorder::get().mLive.emplace_back(this);
+        }
+
+        ~threadBuffer()
+        {
+            recorder::get()._retire(*this);
+        }
+
+        void setName(std::string name)
+        {
+            this->mName = std::move(name);
+        }
+
+        void push(event &&item)
+        {
+            size_t capacity = recorder::get().mCapacity;
+            if (this->mRing.size() < capacity)
+            {
+                this->mRing.emplace_back(std::move(item));
+                return;
+            }
+            this->mRing[this->mNext] = std::move(item);
+            this->mNext = (this->mNext + 1) % capacity;
+            ++this->mDropped;
+        }
+
+        // oldest first
+        std::vector<event> takeEvents()
+        {
+            std::rotate(this->mRing.begin(), this->mRing.begin() + this->mNext, this->mRing.end());
+            this->mNext = 0;
+            return std::move(this->mRing);
+        }
+    };
+
+    inline thread_local threadBuffer tls;
+
+    inline void setThreadName(std::string name)
+    {
+        if (recorder::get().enabled())
+            tls.setName(std::move(name));
+    }
+
+    /**
+     * @brief records one event from construction to destruction when tracing is enabled
+     *
+     * e.g. `trace::scope cuTrace{"CU", [&] { return std::format(R"("name": "{}")", trace::escape(name)); }}`,
+     * the args callback only runs when tracing is enabled
+     */
+    class scope
+    {
+        std::string_view mName;
+        std::string      mArgs;
+        uint64_t         mBeginNs = 0;
+        bool             mActive;
+
+    public:
+        explicit scope(std::string_view name) :
+            mName(name), mActive(recorder::get().enabled())
+        {
+            if (this->mActive)
+                this->mBeginNs = nowNs();
+        }
+
+        template <typename ArgsFn>
+        scope(std::string_view name, ArgsFn &&args) :
+            mName(name), mActive(recorder::get().enabled())
+        {
+            if (this->mActive)
+            {
+                this->mArgs = args();
+                this->mBeginNs = nowNs();
+            }
+        }
+
+        scope(const scope &) = delete;
+
+        ~scope()
+        {
+            if (this->mActive)
+                tls.push({this->mName, std::move(this->mArgs), this->mBeginNs, nowNs() - this->mBeginNs});
+        }
+    };
+
+    inline void recorder::_retire(threadBuffer &buffer)
+    {
+        std::lock_guard lock{this->mMutex};
+        std::erase(this->mLive, &buffer);
+        this->mDropped += buffer.mDropped;
+        if (!buffer.mRing.empty())
+            this->mRetired.push_back({buffer.mTid, buffer.mName, buffer.takeEvents()});
+    }
+
+    /**
+     * @brief enable tracing for the enclosing scope (e.g. `main`) and dump when leaving it, no-op for an empty path
+     */
+    class session
+    {
+        std::string mPath;
+
+    public:
+        explicit session(std::string_view path) :
+            mPath(path)
+        {
+            if (this->mPath.empty())
+                return;
+            recorder::get().enable();
+            setThreadName("main");
+        }
+
+        ~session()
+        {
+            if (this->mPath.empty())
+                return;
+            if (recorder::get().dump(this->mPath) == -1)
+                std::println(stderr, "Error: unable to write {}", this->mPath);
+            else
+                std::println("Trace output to {}", this->mPath);
+        }
+    };
+
+    inline int recorder::dump(const std::string &path)
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+            return -1;
+
+        std::lock_guard lock{this->mMutex};
+        std::vector<retiredBuffer> buffers = this->mRetired;
+        uint64_t                   dropped = this->mDropped;
+        for (auto &&buffer : this->mLive)
+        {
+            dropped += buffer->mDropped;
+            buffers.push_back({buffer->mTid, buffer->mName, buffer->takeEvents()});
+        }
+
+        file << "{\"traceEvents\": [\n";
+        bool first = true;
+        for (auto &&buffer : buffers)
+        {
+            file << std::format(R"({}{{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, "args": {{"name": "{}"}}}})",
+                                first ? "" : ",\n", buffer.tid, escape(buffer.name));
+            first = false;
+            for (auto &&item : buffer.events)
+            {
+                file << std::format(R"(,
+{{"name": "{}", "ph": "X", "pid": 1, "tid": {}, "ts": {:.3f}, "dur": {:.3f}, "args": {{{}}}}})",
+                                    escape(item.name), buffer.tid, (item.beginNs - this->mStartNs) / 1e3, item.durationNs / 1e3,
+                                    item.args);
+            }
+        }
+        file << std::format("\n], \"displayTimeUnit\": \"ms\", \"otherData\": {{\"dropped_events\": {}}}}}\n", dropped);
+        return 0;
+    }
+} // namespace trace
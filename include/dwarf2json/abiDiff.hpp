@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <print>
+#include <thread>
+#include "typeModel.hpp"
+
+/**
+ * @brief 比较两个二进制中同名类型的布局: 大小, 成员偏移, 基类, 虚表槽位和枚举值.
+ *        两个文件各自在一个线程里解析, 只保存 typeRecord, 不生成json
+ */
+class abiDiff
+{
+    using typeMap = std::unordered_map<std::string, typeRecord>;
+
+    std::string mOldPath;
+    std::string mNewPath;
+    typeMap     mOldTypes;
+    typeMap     mNewTypes;
+
+public:
+    abiDiff(std::string_view oldPath, std::string_view newPath) :
+        mOldPath(oldPath), mNewPath(newPath) {}
+
+    /**
+     * @param filter 已经 compile 过的过滤规则, 两个文件共用
+     * @return -1 表示有文件无法打开
+     */
+    int start(const declFilter &filter)
+    {
+        static TimerToken token;
+        Timer             timer{token};
+
+        auto collect = [&filter](const std::string &path, typeMap &out) -> bool {
+            dw::file dbg{path};
+            if (!dbg.isOpen())
+                return false;
+            out = collectTypes(dbg, filter);
+            return true;
+        };
+
+        bool oldOpened = false;
+        {
+            std::jthread oldWorker([&] { oldOpened = collect(this->mOldPath, this->mOldTypes); });
+            if (!collect(this->mNewPath, this->mNewTypes))
+                return -1;
+        }
+        return oldOpened ? 0 : -1;
+    }
+
+    /**
+     * @brief 比较两个已经打开的文件, 例如 `dw::builder` 生成的内存文件, 在当前线程中依次收集
+     * @return -1 表示有文件无法打开
+     */
+    int start(dw::file &oldFile, dw::file &newFile, const declFilter &filter)
+    {
+        if (!oldFile.isOpen() || !newFile.isOpen())
+            return -1;
+        this->mOldTypes = collectTypes(oldFile, filter);
+        this->mNewTypes = collectTypes(newFile, filter);
+        return 0;
+    }
+
+    /**
+     * @brief 输出差异
+     * @return 布局发生变化或被删除的类型数量
+     */
+    int dumpDiff(FILE *out = stdout)
+    {
+        std::vector<const std::string *> names;
+        names.reserve(this->mOldTypes.size());
+        for (auto &&[name, record] : this->mOldTypes)
+            names.emplace_back(&name);
+        std::sort(names.begin(), names.end(), [](const std::string *a, const std::string *b) { return *a < *b; });
+
+        int changedCount = 0, unchangedCount = 0, removedCount = 0;
+        for (const std::string *name : names)
+        {
+            const typeRecord &oldType = this->mOldTypes.at(*name);
+            auto              found = this->mNewTypes.find(*name);
+            if (found == this->mNewTypes.end())
+            {
+                std::println(out, "- {} {} ({}:{})", tagName(oldType.tag), *name, oldType.declFile, oldType.declLine);
+                ++removedCount;
+                continue;
+            }
+            // 结构哈希相同则无需逐项比较
+            if (oldType.hash == found->second.hash || !this->diffType(oldType, found->second, out))
+                ++unchangedCount;
+            else
+                ++changedCount;
+        }
+
+        size_t addedCount = std::count_if(this->mNewTypes.begin(), this->mNewTypes.end(),
+                                          [this](auto &&item) { return !this->mOldTypes.contains(item.first); });
+        std::println(out, "{} changed, {} removed, {} added, {} unchanged", changedCount, removedCount, addedCount, unchangedCount);
+        return changedCount + removedCount;
+    }
+
+private:
+    static typeMap collectTypes(dw::file &dbg, const declFilter &filter)
+    {
+        typeCollector collector{dbg, filter};
+        collector.collect();
+        return std::move(collector.getTypes());
+    }
+
+    static std::string_view tagName(uint16_t tag)
+    {
+        switch (tag)
+        {
+        case DW_TAG_class_type: return "class";
+        case DW_TAG_structure_type: return "struct";
+        case DW_TAG_union_type: return "union";
+        case DW_TAG_enumeration_type: return "enum";
+        default: return "type";
+        }
+    }
+
+    /**
+     * @brief 按名称把列表转成有序表, 重名的项 (重载的虚函数, 匿名成员) 追加序号
+     */
+    template <typename Item, typename KeyOf>
+    static std::map<std::string, const Item *> indexByName(const std::vector<Item> &items, KeyOf keyOf)
+    {
+        std::map<std::string, const Item *> ret;
+        for (auto &&item : items)
+        {
+            std::string key = keyOf(item);
+            for (size_t dup = 1; ret.contains(key); dup++)
+                key = std::format("{}#{}", keyOf(item), dup);
+            ret.emplace(std::move(key), &item);
+        }
+        return ret;
+    }
+
+    /**
+     * @brief 对两个列表按名称配对, 分别回调 changed/removed/added
+     */
+    template <typename Item, typename KeyOf, typename OnChange>
+    static void diffList(const std::vector<Item> &oldItems, const std::vector<Item> &newItems,
+                         KeyOf keyOf, OnChange onChange, std::vector<std::string> &lines, std::string_view what)
+    {
+        auto oldIndex = indexByName(oldItems, keyOf);
+        auto newIndex = indexByName(newItems, keyOf);
+        for (auto &&[key, oldItem] : oldIndex)
+        {
+            auto found = newIndex.find(key);
+            if (found == newIndex.end())
+                lines.emplace_back(std::format("{} {} removed", what, key));
+            else
+                onChange(key, *oldItem, *found->second);
+        }
+        for (auto &&[key, newItem] : newIndex)
+        {
+            if (!oldIndex.contains(key))
+                lines.emplace_back(std::format("{} {} added", what, key));
+        }
+    }
+
+    /**
+     * @return 是否存在布局上的差异
+     */
+    bool diffType(const typeRecord &oldType, const typeRecord &newType, FILE *out)
+    {
+        std::vector<std::string> lines;
+        if (oldType.byteSize != newType.byteSize)
+            lines.emplace_back(std::format("size {} -> {}", oldType.byteSize, newType.byteSize));
+
+        diffList(
+            oldType.members, newType.members, [](const typeRecord::member &m) { return m.name.empty() ? std::string{"`anonymous`"} : m.name; },
+            [&lines](const std::string &key, const typeRecord::member &o, const typeRecord::member &n) {
+                if (o.offset != n.offset || o.bitOffset != n.bitOffset || o.bitSize != n.bitSize)
+                    lines.emplace_back(std::format("member {} offset {}:{}/{} -> {}:{}/{}", key,
+                                                   o.offset, o.bitOffset, o.bitSize, n.offset, n.bitOffset, n.bitSize));
+                if (o.type != n.type)
+                    lines.emplace_back(std::format("member {} type {} -> {}", key, o.type, n.type));
+            },
+            lines, "member");
+
+        diffList(
+            oldType.bases, newType.bases, [](const typeRecord::base &b) { return b.type; },
+            [&lines](const std::string &key, const typeRecord::base &o, const typeRecord::base &n) {
+                if (o.offset != n.offset)
+                    lines.emplace_back(std::format("base {} offset {} -> {}", key, o.offset, n.offset));
+                if (o.isVirtual != n.isVirtual)
+                    lines.emplace_back(std::format("base {} virtual {} -> {}", key, o.isVirtual, n.isVirtual));
+            },
+            lines, "base");
+
+        diffList(
+            oldType.vtable, newType.vtable, [](const typeRecord::virtualFunc &f) { return f.name; },
+            [&lines](const std::string &key, const typeRecord::virtualFunc &o, const typeRecord::virtualFunc &n) {
+                if (o.slot != n.slot)
+                    lines.emplace_back(std::format("vtable {} slot {} -> {}", key, o.slot, n.slot));
+            },
+            lines, "vtable");
+
+        diffList(
+            oldType.enumerators, newType.enumerators, [](const typeRecord::enumerator &e) { return e.name; },
+            [&lines](const std::string &key, const typeRecord::enumerator &o, const typeRecord::enumerator &n) {
+                if (o.value != n.value)
+                    lines.emplace_back(std::format("enumerator {} value {} -> {}", key, o.value, n.value));
+            },
+            lines, "enumerator");
+
+        if (lines.empty())
+            return false;
+
+        std::println(out, "~ {} {} ({}:{})", tagName(oldType.tag), oldType.name, newType.declFile, newType.declLine);
+        for (auto &&line : lines)
+            std::println(out, "    {}", line);
+        return true;
+    }
+};
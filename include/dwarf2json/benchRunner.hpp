@@ -0,0 +1,220 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <print>
+#include <streambuf>
+#include "dwarf2json.hpp"
+
+/**
+ * @brief 基准测试模式 (`--bench N`): 先预热, 再分别计时打开文件, 扫描CU头, 解析和序列化,
+ *        汇总每个阶段的 min / median / p90 / max. 解析过程不输出进度, 序列化写入丢弃数据的流
+ */
+class benchRunner
+{
+public:
+    enum phase : uint8_t
+    {
+        open, // dwarf_init_path
+        scan, // CU头扫描
+        parse,
+        serialize,
+        total,
+        phaseCount
+    };
+
+    static constexpr std::array<const char *, phaseCount> phaseNames{"open", "CU scan", "parse", "serialize", "total"};
+
+    struct options
+    {
+        uint32_t    iterations = 5;
+        uint32_t    warmup = 1;
+        bool        warm = false;  // true: 所有迭代共用一个 dw::file, 打开和扫描只计一次
+        std::string jsonPath = ""; // 非空时写出结果文件, 便于比较不同提交
+    };
+
+    struct summary
+    {
+        double min = 0, median = 0, p90 = 0, max = 0;
+    };
+
+    // 只统计写入的字节数
+    class countingBuffer : public std::streambuf
+    {
+    public:
+        uint64_t mBytes = 0;
+
+    protected:
+        int_type overflow(int_type ch) override
+        {
+            if (traits_type::eq_int_type(ch, traits_type::eof()))
+                return traits_type::not_eof(ch);
+            ++this->mBytes;
+            return ch;
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize count) override
+        {
+            this->mBytes += count;
+            return count;
+        }
+    };
+
+private:
+    std::string                                     mFilePath;
+    const declFilter                               &mFilter;
+    options                                         mOptions;
+    std::array<std::vector<double>, phaseCount>     mSamples; // 毫秒
+    uint64_t                                        mParsedBytes = 0;
+    uint64_t                                        mParsedDIEs = 0;
+    std::vector<std::pair<std::string, declFilter>> mOutputs; // 命名输出, 见 `dwarf2json::addOutput`
+
+public:
+    benchRunner(std::string_view filePath, const declFilter &filter, options opts) :
+        mFilePath(filePath), mFilter(filter), mOptions(std::move(opts)) {}
+
+    /**
+     * @brief 与正常运行一样配置命名输出, 序列化阶段依次写出每个输出 (不落盘)
+     */
+    void addOutput(std::string_view path, declFilter filter)
+    {
+        this->mOutputs.emplace_back(path, std::move(filter));
+    }
+
+    /**
+     * @return -1 表示无法打开文件, -2 表示结果文件无法写入
+     */
+    int start()
+    {
+        std::unique_ptr<dwarf2json> warmEngine;
+        for (uint32_t idx = 0; idx < this->mOptions.warmup + this->mOptions.iterations; idx++)
+        {
+            bool record = idx >= this->mOptions.warmup;
+            if (this->runOnce(this->mOptions.warm ? &warmEngine : nullptr, record) == -1)
+                return -1;
+        }
+        this->printReport();
+        if (!this->mOptions.jsonPath.empty() && this->dumpJson() == -1)
+            return -2;
+        return 0;
+    }
+
+    /**
+     * @brief nearest-rank 百分位
+     */
+    static summary summarize(std::vector<double> samples)
+    {
+        if (samples.empty())
+            return {};
+        std::sort(samples.begin(), samples.end());
+        auto rank = [&](double pct) {
+            size_t idx = static_cast<size_t>(std::ceil(pct * samples.size()));
+            return samples[std::clamp<size_t>(idx, 1, samples.size()) - 1];
+        };
+        return {samples.front(), rank(0.5), rank(0.9), samples.back()};
+    }
+
+    const std::vector<double> &getSamples(phase item) const noexcept
+    {
+        return this->mSamples[item];
+    }
+
+private:
+    /**
+     * @param warmEngine nullptr 表示冷启动: 每次都重新打开文件
+     */
+    int runOnce(std::unique_ptr<dwarf2json> *warmEngine, bool record)
+    {
+        std::array<double, phaseCount> times{};
+        std::array<bool, phaseCount>   measured{};
+        auto                           toMs = [](uint64_t ns) { return ns / 1e6; };
+
+        std::unique_ptr<dwarf2json>  coldEngine;
+        std::unique_ptr<dwarf2json> &engine = warmEngine ? *warmEngine : coldEngine;
+        if (!engine)
+        {
+            engine = std::make_unique<dwarf2json>(this->mFilePath);
+            if (!engine->getFile().isOpen())
+                return -1;
+            engine->setQuiet(true);
+            for (auto &&[path, filter] : this->mOutputs)
+                engine->addOutput(path, filter);
+            const auto &initTimes = engine->getFile().getInitTimes();
+            times[open] = toMs(initTimes.openNs);
+            times[scan] = toMs(initTimes.scanNs);
+            measured[open] = measured[scan] = true;
+        }
+        else
+            engine->reset();
+
+        // start 按值接收规则, 先复制好, 计时窗口内只有移动
+        declFilter filter = this->mFilter;
+        uint64_t   beginNs = trace::nowNs();
+        engine->start(std::move(filter));
+        uint64_t parsedNs = trace::nowNs();
+        countingBuffer buffer;
+        std::ostream   sink{&buffer};
+        engine->writeData(sink);
+        uint64_t endNs = trace::nowNs();
+
+        times[parse] = toMs(parsedNs - beginNs);
+        times[serialize] = toMs(endNs - parsedNs);
+        measured[parse] = measured[serialize] = measured[total] = true;
+        times[total] = times[open] + times[scan] + times[parse] + times[serialize];
+        if (!record)
+            return 0;
+        this->mParsedBytes = buffer.mBytes;
+        this->mParsedDIEs = engine->getParsedDIEs();
+        for (size_t idx = 0; idx < phaseCount; idx++)
+        {
+            if (measured[idx])
+                this->mSamples[idx].push_back(times[idx]);
+        }
+        return 0;
+    }
+
+    void printReport() const
+    {
+        std::println("[Bench] {}: {} iterations after {} warmup, {} runs, {} bytes of json", this->mFilePath, this->mOptions.iterations,
+                     this->mOptions.warmup, this->mOptions.warm ? "warm" : "cold", this->mParsedBytes);
+        std::println("[Bench] {:<10} {:>8} {:>12} {:>12} {:>12} {:>12}", "phase", "samples", "min ms", "median ms", "p90 ms", "max ms");
+        for (size_t idx = 0; idx < phaseCount; idx++)
+        {
+            summary result = summarize(this->mSamples[idx]);
+            std::println("[Bench] {:<10} {:>8} {:>12.3f} {:>12.3f} {:>12.3f} {:>12.3f}", phaseNames[idx], this->mSamples[idx].size(),
+                         result.min, result.median, result.p90, result.max);
+        }
+        // 解析阶段不含进度输出 (quiet), 用中位数折算每个die的耗时
+        double parseMs = summarize(this->mSamples[parse]).median;
+        std::println("[Bench] parsed {} DIEs, {:.1f} ns/DIE (median parse)", this->mParsedDIEs,
+                     this->mParsedDIEs ? parseMs * 1e6 / this->mParsedDIEs : 0.0);
+    }
+
+    int dumpJson() const
+    {
+        std::ofstream file(this->mOptions.jsonPath);
+        if (!file.is_open())
+            return -1;
+
+        file << std::format(R"({{"input": "{}", "iterations": {}, "warmup": {}, "mode": "{}", "json_bytes": {}, "dies": {}, "timestamp": {}, "phases": {{)",
+                            dwarfUtils::escape_json_string(this->mFilePath), this->mOptions.iterations, this->mOptions.warmup,
+                            this->mOptions.warm ? "warm" : "cold", this->mParsedBytes, this->mParsedDIEs, std::time(nullptr));
+        for (size_t idx = 0; idx < phaseCount; idx++)
+        {
+            summary     result = summarize(this->mSamples[idx]);
+            std::string samples;
+            for (auto &&sample : this->mSamples[idx])
+                samples += std::format("{}{:.6f}", samples.empty() ? "" : ", ", sample);
+            file << std::format(R"({}
+    "{}": {{"min_ms": {:.6f}, "median_ms": {:.6f}, "p90_ms": {:.6f}, "max_ms": {:.6f}, "samples_ms": [{}]}})",
+                                idx ? "," : "", phaseNames[idx], result.min, result.median, result.p90, result.max, samples);
+        }
+        file << "\n}}\n";
+        std::println("[Bench] results written to {}", this->mOptions.jsonPath);
+        return 0;
+    }
+};
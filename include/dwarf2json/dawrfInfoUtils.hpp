@@ -62,7 +62,7 @@ namespace dwarfUtils
         return escaped;
     }
 
-    void custom_format(const nlohmann::json &j, std::ofstream &out, int indent = 0)
+    void custom_format(const nlohmann::json &j, std::ostream &out, int indent = 0)
     {
         const std::string indent_str(indent, ' ');           // 固定缩进字符串
         const std::string child_indent_str(indent + 4, ' '); // 子项的缩进
@@ -0,0 +1,591 @@
+#pragma once
+#include <dwarfng/dwarfng.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 多个glob模式合并成的DFA, 扫描一遍字符串即可得到所有命中的模式
+ *
+ * `*` 匹配除 `/` 以外的任意字符串, `**` 匹配任意字符串, 位于开头或 `/` 之后的 `**\/` 匹配零个或多个目录,
+ * `?` 匹配一个除 `/` 以外的字符, `\` 转义下一个字符. 最多64个模式
+ */
+class globDFA
+{
+    struct nfaState
+    {
+        enum kind : uint8_t
+        {
+            literal,
+            single,
+            star,
+            globstar,
+            dirstar,
+            accept,
+        } kind;
+        char     ch = 0;
+        uint32_t pattern = 0; // accept 状态所属的模式
+    };
+
+    std::vector<nfaState> mNFA;
+    std::vector<uint32_t> mStarts;
+
+    // 状态0为死状态, 状态1为初始状态
+    std::vector<std::array<uint32_t, 256>> mNext;
+    std::vector<uint64_t>                  mAccept;
+
+public:
+    static constexpr size_t maxPatterns = 64;
+
+    /**
+     * @return 模式序号, 超过 `maxPatterns` 时返回 -1
+     */
+    int addPattern(std::string_view pattern)
+    {
+        if (this->mStarts.size() >= maxPatterns)
+            return -1;
+        uint32_t id = this->mStarts.size();
+        this->mStarts.emplace_back(this->mNFA.size());
+        for (size_t idx = 0; idx < pattern.size(); idx++)
+        {
+            char ch = pattern[idx];
+            if (ch == '\\' && idx + 1 < pattern.size())
+                this->mNFA.push_back({nfaState::literal, pattern[++idx]});
+            else if (ch == '?')
+                this->mNFA.push_back({nfaState::single});
+            else if (ch == '*' && pattern.substr(idx, 3) == "**/" && (idx == 0 || pattern[idx - 1] == '/'))
+            {
+                this->mNFA.push_back({nfaState::dirstar});
+                idx += 2;
+            }
+            else if (ch == '*' && pattern.substr(idx, 2) == "**")
+            {
+                this->mNFA.push_back({nfaState::globstar});
+                idx += 1;
+            }
+            else if (ch == '*')
+                this->mNFA.push_back({nfaState::star});
+            else
+                this->mNFA.push_back({nfaState::literal, ch});
+        }
+        this->mNFA.push_back({nfaState::accept, 0, id});
+        this->mNext.clear();
+        return id;
+    }
+
+    bool empty() const noexcept
+    {
+        return this->mStarts.empty();
+    }
+
+    /**
+     * @brief 子集构造, 添加完所有模式后调用一次
+     */
+    void compile()
+    {
+        this->mNext.assign(1, {});
+        this->mAccept.assign(1, 0);
+
+        std::map<std::vector<uint32_t>, uint32_t> ids;
+        std::vector<std::vector<uint32_t>>        pending;
+        auto                                      intern = [&](std::vector<uint32_t> set) -> uint32_t {
+            if (set.empty())
+                return 0;
+            std::sort(set.begin(), set.end());
+            set.erase(std::unique(set.begin(), set.end()), set.end());
+            auto [it, inserted] = ids.try_emplace(set, this->mNext.size());
+            if (inserted)
+            {
+                uint64_t accept = 0;
+                for (auto &&state : set)
+                {
+                    if (this->mNFA[state].kind == nfaState::accept)
+                        accept |= uint64_t{1} << this->mNFA[state].pattern;
+                }
+                this->mNext.emplace_back();
+                this->mAccept.emplace_back(accept);
+                pending.emplace_back(std::move(set));
+            }
+            return it->second;
+        };
+
+        std::vector<uint32_t> start;
+        for (auto &&state : this->mStarts)
+            this->closure(state, start);
+        intern(std::move(start));
+
+        for (uint32_t dfaState = 1; dfaState < this->mNext.size(); dfaState++)
+        {
+            std::vector<uint32_t> set = std::move(pending[dfaState - 1]);
+            for (unsigned ch = 0; ch < 256; ch++)
+            {
+                std::vector<uint32_t> next;
+                for (auto &&state : set)
+                    this->step(state, static_cast<char>(ch), next);
+                uint32_t target = intern(std::move(next));
+                this->mNext[dfaState][ch] = target;
+            }
+        }
+    }
+
+    /**
+     * @return 完整匹配 `str` 的模式的位掩码
+     */
+    uint64_t match(std::string_view str) const noexcept
+    {
+        if (this->mNext.size() < 2)
+            return 0;
+        uint32_t state = 1;
+        for (auto &&ch : str)
+        {
+            state = this->mNext[state][static_cast<uint8_t>(ch)];
+            if (state == 0)
+                return 0;
+        }
+        return this->mAccept[state];
+    }
+
+    static bool hasWildcard(std::string_view pattern) noexcept
+    {
+        return pattern.find_first_of("*?\\") != std::string_view::npos;
+    }
+
+    static std::string escape(std::string_view literal)
+    {
+        std::string ret;
+        for (auto &&ch : literal)
+        {
+            if (ch == '*' || ch == '?' || ch == '\\')
+                ret += '\\';
+            ret += ch;
+        }
+        return ret;
+    }
+
+private:
+    void closure(uint32_t state, std::vector<uint32_t> &out) const
+    {
+        out.emplace_back(state);
+        auto kind = this->mNFA[state].kind;
+        if (kind == nfaState::star || kind == nfaState::globstar || kind == nfaState::dirstar)
+            this->closure(state + 1, out);
+    }
+
+    void step(uint32_t state, char ch, std::vector<uint32_t> &out) const
+    {
+        const nfaState &nfa = this->mNFA[state];
+        switch (nfa.kind)
+        {
+        case nfaState::literal:
+            if (ch == nfa.ch)
+                this->closure(state + 1, out);
+            break;
+        case nfaState::single:
+            if (ch != '/')
+                this->closure(state + 1, out);
+            break;
+        case nfaState::star:
+            if (ch != '/')
+                this->closure(state, out);
+            break;
+        case nfaState::globstar:
+            this->closure(state, out);
+            break;
+        case nfaState::dirstar:
+            // 只有读完一整段目录 (到 `/`) 之后才能继续匹配后面的部分
+            if (ch == '/')
+                this->closure(state, out);
+            else
+                out.emplace_back(state);
+            break;
+        case nfaState::accept:
+            break;
+        }
+    }
+};
+
+/**
+ * @brief 声明过滤规则, 解析一次后编译成路径DFA, 名称DFA和命名空间前缀树, 在遍历die时尽早求值
+ *
+ * 每行一条规则 `[+|-]类别:模式`, 省略符号时为 `+`:
+ * - `path:/src/mylib**`      简化后的声明文件路径 (glob)
+ * - `ns:mylib::detail`       命名空间前缀, 每段可以是glob, e.g. `ns:__*`; `**` 匹配零层或多层命名空间, e.g. `ns:**::detail`
+ * - `name:get*`              实体名称 (glob), `name[function,variable]:__*` 只作用于指定类别
+ * - `tag:class,enum`         实体类别: class struct union enum function variable member typedef
+ *
+ * 排除规则优先; 某一类别存在包含规则时, 必须命中其中至少一条. 被排除的命名空间, 类等连同其内容一起跳过.
+ * 包含规则只作用于命名空间级的实体, 被接受的类/函数中的成员只检查排除规则
+ */
+class declFilter
+{
+public:
+    // 实体类别, 用于 `tag:` 和 `name[...]:`
+    enum entityKind : uint8_t
+    {
+        kindClass,
+        kindStruct,
+        kindUnion,
+        kindEnum,
+        kindFunction,
+        kindVariable,
+        kindMember,
+        kindTypedef,
+        kindCount,
+        kindNone = kindCount,
+    };
+
+    /**
+     * @brief 遍历到某个命名空间时的匹配状态, 从 `rootNamespace()` 开始逐层 `enterNamespace`
+     */
+    struct nsState
+    {
+        std::vector<uint32_t> nodes{0}; // 前缀树中仍可能继续匹配的节点
+        bool                  included = false;
+        bool                  excluded = false;
+    };
+
+private:
+    static constexpr std::array<std::string_view, kindCount> kindNames{
+        "class", "struct", "union", "enum", "function", "variable", "member", "typedef"};
+
+    struct nsNode
+    {
+        std::unordered_map<std::string, uint32_t> children;
+        std::vector<std::string>                  patternTexts;
+        std::vector<uint32_t>                     patternTargets; // 与 patterns 的模式序号对应
+        globDFA                                   patterns;
+        uint32_t                                  anyDepth = 0; // `**` 组件的目标节点, 0 表示没有
+        bool                                      loop = false; // `**` 节点, 进入任意命名空间后仍然停留在这里
+        bool                                      include = false;
+        bool                                      exclude = false;
+    };
+
+    globDFA  mPathGlobs;
+    uint64_t mPathInclude = 0;
+    uint64_t mPathExclude = 0;
+
+    globDFA                             mNameGlobs;
+    std::array<uint64_t, kindCount>     mNameInclude{};
+    std::array<uint64_t, kindCount>     mNameExclude{};
+    uint8_t                             mTagInclude = 0;
+    uint8_t                             mTagExclude = 0;
+    std::vector<nsNode>                 mNsNodes{1};
+    bool                                mHasNsInclude = false;
+    std::vector<std::string>            mRules;
+
+public:
+    /**
+     * @brief `-f <prefix>` 的等价规则
+     */
+    static std::string prefixRule(std::string_view prefix)
+    {
+        return std::format("+path:{}**", globDFA::escape(prefix));
+    }
+
+    /**
+     * @brief 原先写死在dwarf2json中的跳过规则: 任意层的 std 和 __ 开头的命名空间, __ 开头的函数
+     */
+    void addDefaultRules()
+    {
+        this->addRule("-ns:**::std");
+        this->addRule("-ns:**::__*");
+        this->addRule("-name[function]:__*");
+    }
+
+    /**
+     * @return false 表示规则无法解析
+     */
+    bool addRule(std::string_view rule)
+    {
+        while (!rule.empty() && (rule.front() == ' ' || rule.front() == '\t'))
+            rule.remove_prefix(1);
+        while (!rule.empty() && (rule.back() == ' ' || rule.back() == '\t' || rule.back() == '\r'))
+            rule.remove_suffix(1);
+        if (rule.empty() || rule.front() == '#')
+            return true;
+
+        std::string_view text = rule;
+        bool             include = true;
+        if (rule.front() == '+' || rule.front() == '-')
+        {
+            include = rule.front() == '+';
+            rule.remove_prefix(1);
+        }
+        size_t colon = rule.find(':');
+        if (colon == std::string_view::npos)
+            return false;
+        std::string_view kind = rule.substr(0, colon);
+        std::string_view pattern = rule.substr(colon + 1);
+
+        if (kind == "path")
+        {
+            int id = this->mPathGlobs.addPattern(pattern);
+            if (id < 0)
+                return false;
+            (include ? this->mPathInclude : this->mPathExclude) |= uint64_t{1} << id;
+        }
+        else if (kind == "ns")
+        {
+            if (!this->addNamespaceRule(pattern, include))
+                return false;
+        }
+        else if (kind == "tag")
+        {
+            uint8_t kinds = parseKinds(pattern);
+            if (!kinds)
+                return false;
+            (include ? this->mTagInclude : this->mTagExclude) |= kinds;
+        }
+        else if (kind.starts_with("name"))
+        {
+            uint8_t kinds = (1u << kindCount) - 1;
+            if (kind != "name")
+            {
+                if (!kind.starts_with("name[") || !kind.ends_with("]"))
+                    return false;
+                kinds = parseKinds(kind.substr(5, kind.size() - 6));
+                if (!kinds)
+                    return false;
+            }
+            int id = this->mNameGlobs.addPattern(pattern);
+            if (id < 0)
+                return false;
+            for (size_t idx = 0; idx < kindCount; idx++)
+            {
+                if (kinds & (1u << idx))
+                    (include ? this->mNameInclude : this->mNameExclude)[idx] |= uint64_t{1} << id;
+            }
+        }
+        else
+            return false;
+
+        this->mRules.emplace_back(text);
+        return true;
+    }
+
+    /**
+     * @brief 从文件读取规则, 每行一条, `#` 开头为注释
+     * @return 第一条无法解析的行号, 0 表示成功, -1 表示无法打开文件
+     */
+    int addRulesFromFile(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+            return -1;
+        std::string line;
+        for (int lineNo = 1; std::getline(file, line); lineNo++)
+        {
+            if (!this->addRule(line))
+                return lineNo;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief 编译全部DFA, 添加完规则后调用一次
+     */
+    void compile()
+    {
+        this->mPathGlobs.compile();
+        this->mNameGlobs.compile();
+        for (auto &&node : this->mNsNodes)
+        {
+            if (!node.patterns.empty())
+                node.patterns.compile();
+        }
+    }
+
+    bool hasPathRules() const noexcept
+    {
+        return !this->mPathGlobs.empty();
+    }
+
+    bool hasNameRules() const noexcept
+    {
+        return !this->mNameGlobs.empty();
+    }
+
+    const std::vector<std::string> &getRules() const noexcept
+    {
+        return this->mRules;
+    }
+
+    bool allowsPath(std::string_view declFile) const noexcept
+    {
+        if (!this->hasPathRules())
+            return true;
+        uint64_t hits = this->mPathGlobs.match(declFile);
+        return !(hits & this->mPathExclude) && (!this->mPathInclude || (hits & this->mPathInclude));
+    }
+
+    nsState rootNamespace() const
+    {
+        nsState ret;
+        this->closeNamespace(ret);
+        return ret;
+    }
+
+    nsState enterNamespace(const nsState &outer, std::string_view name) const
+    {
+        nsState ret{{}, outer.included, outer.excluded};
+        if (ret.excluded)
+            return ret;
+        for (auto &&nodeIdx : outer.nodes)
+        {
+            const nsNode &node = this->mNsNodes[nodeIdx];
+            if (node.loop)
+                ret.nodes.emplace_back(nodeIdx);
+            if (auto found = node.children.find(std::string{name}); found != node.children.end())
+                ret.nodes.emplace_back(found->second);
+            for (uint64_t hits = node.patterns.match(name); hits; hits &= hits - 1)
+                ret.nodes.emplace_back(node.patternTargets[std::countr_zero(hits)]);
+        }
+        this->closeNamespace(ret);
+        return ret;
+    }
+
+    /**
+     * @brief 命名空间被排除, 或者其中不可能再出现被包含的命名空间
+     */
+    bool prunesNamespace(const nsState &state) const noexcept
+    {
+        return state.excluded || (this->mHasNsInclude && !state.included && state.nodes.empty());
+    }
+
+    /**
+     * @param ns 实体所在的命名空间
+     * @param name 实体名称, 没有名称规则时不会用到
+     * @param nested 实体位于类/函数等内部, 其外层已经通过了包含规则, 这里只检查排除规则
+     */
+    bool allowsEntity(const nsState &ns, uint16_t tag, std::string_view name, bool nested = false) const noexcept
+    {
+        if (ns.excluded || (!nested && this->mHasNsInclude && !ns.included))
+            return false;
+        entityKind kind = kindOf(tag);
+        if (kind == kindNone)
+            return true;
+        uint8_t kindBit = 1u << kind;
+        if ((this->mTagExclude & kindBit) || (!nested && this->mTagInclude && !(this->mTagInclude & kindBit)))
+            return false;
+        uint64_t nameInclude = nested ? 0 : this->mNameInclude[kind];
+        if (!nameInclude && !this->mNameExclude[kind])
+            return true;
+        uint64_t hits = this->mNameGlobs.match(name);
+        return !(hits & this->mNameExclude[kind]) && (!nameInclude || (hits & nameInclude));
+    }
+
+    static constexpr entityKind kindOf(uint16_t tag) noexcept
+    {
+        switch (tag)
+        {
+        case DW_TAG_class_type:
+            return kindClass;
+        case DW_TAG_structure_type:
+            return kindStruct;
+        case DW_TAG_union_type:
+            return kindUnion;
+        case DW_TAG_enumeration_type:
+            return kindEnum;
+        case DW_TAG_subprogram:
+            return kindFunction;
+        case DW_TAG_variable:
+            return kindVariable;
+        case DW_TAG_member:
+            return kindMember;
+        case DW_TAG_typedef:
+            return kindTypedef;
+        default:
+            return kindNone;
+        }
+    }
+
+private:
+    /**
+     * @brief 加入 `**` 组件的目标节点 (匹配零层命名空间), 去重后汇总包含/排除标记
+     */
+    void closeNamespace(nsState &state) const
+    {
+        for (size_t idx = 0; idx < state.nodes.size(); idx++)
+        {
+            uint32_t next = this->mNsNodes[state.nodes[idx]].anyDepth;
+            if (next && std::find(state.nodes.begin(), state.nodes.end(), next) == state.nodes.end())
+                state.nodes.emplace_back(next);
+        }
+        std::sort(state.nodes.begin(), state.nodes.end());
+        state.nodes.erase(std::unique(state.nodes.begin(), state.nodes.end()), state.nodes.end());
+        for (auto &&nodeIdx : state.nodes)
+        {
+            state.included |= this->mNsNodes[nodeIdx].include;
+            state.excluded |= this->mNsNodes[nodeIdx].exclude;
+        }
+    }
+
+    static uint8_t parseKinds(std::string_view list)
+    {
+        uint8_t ret = 0;
+        while (!list.empty())
+        {
+            size_t           comma = list.find(',');
+            std::string_view item = list.substr(0, comma);
+            auto             found = std::find(kindNames.begin(), kindNames.end(), item);
+            if (found == kindNames.end())
+                return 0;
+            ret |= 1u << (found - kindNames.begin());
+            list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+        }
+        return ret;
+    }
+
+    bool addNamespaceRule(std::string_view pattern, bool include)
+    {
+        uint32_t nodeIdx = 0;
+        while (true)
+        {
+            size_t           sep = pattern.find("::");
+            std::string_view component = pattern.substr(0, sep);
+            if (component.empty())
+                return false;
+
+            uint32_t next = this->mNsNodes.size();
+            nsNode  &node = this->mNsNodes[nodeIdx];
+            if (component == "**")
+            {
+                if (!node.anyDepth)
+                    node.anyDepth = next;
+                next = node.anyDepth;
+            }
+            else if (globDFA::hasWildcard(component))
+            {
+                auto found = std::find(node.patternTexts.begin(), node.patternTexts.end(), component);
+                if (found != node.patternTexts.end())
+                    next = node.patternTargets[found - node.patternTexts.begin()];
+                else if (node.patterns.addPattern(component) < 0)
+                    return false;
+                else
+                {
+                    node.patternTexts.emplace_back(component);
+                    node.patternTargets.emplace_back(next);
+                }
+            }
+            else
+                next = node.children.try_emplace(std::string{component}, next).first->second;
+
+            if (next == this->mNsNodes.size())
+                this->mNsNodes.emplace_back().loop = component == "**";
+            nodeIdx = next;
+            if (sep == std::string_view::npos)
+                break;
+            pattern.remove_prefix(sep + 2);
+        }
+        (include ? this->mNsNodes[nodeIdx].include : this->mNsNodes[nodeIdx].exclude) = true;
+        this->mHasNsInclude |= include;
+        return true;
+    }
+};
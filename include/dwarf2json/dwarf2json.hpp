@@ -3,109 +3,459 @@
 #include <nlohmann/json.hpp>
 #include <print>
 #include <fstream>
+#include <unordered_set>
 #include "dawrfInfoUtils.hpp"
+#include "declFilter.hpp"
+#include "typeNamer.hpp"
 
 class dwarf2json
 {
     using Json = nlohmann::json;
-    dw::file mDbg;
-    Json     mOutputJson;
 
-    std::string mDeclFileFilter;
+    // 各个处理函数用到的属性, 解码时只保留这些属性 (见构造函数)
+    using functionAttrs = dw::attrPack<DW_AT_specification, DW_AT_name, DW_AT_linkage_name, DW_AT_external,
+                                       DW_AT_accessibility, DW_AT_defaulted, DW_AT_deleted, DW_AT_decl_line,
+                                       DW_AT_decl_column, DW_AT_virtuality, DW_AT_inline, DW_AT_vtable_elem_location,
+                                       DW_AT_reference, DW_AT_rvalue_reference, DW_AT_artificial>;
+    using variableAttrs = dw::attrPack<DW_AT_specification, DW_AT_name, DW_AT_decl_line, DW_AT_decl_column,
+                                       DW_AT_data_member_location, DW_AT_declaration, DW_AT_external,
+                                       DW_AT_accessibility, DW_AT_inline, DW_AT_location, DW_AT_linkage_name,
+                                       DW_AT_const_value, DW_AT_bit_size, DW_AT_bit_offset>;
+    using enumAttrs = dw::attrPack<DW_AT_name, DW_AT_enum_class, DW_AT_decl_line, DW_AT_decl_column, DW_AT_const_value>;
+    using unionAttrs = dw::attrPack<DW_AT_name, DW_AT_decl_line, DW_AT_decl_column, DW_AT_byte_size>;
+    using typedefAttrs = dw::attrPack<DW_AT_name, DW_AT_decl_line, DW_AT_decl_column>;
+    using inheritanceAttrs = dw::attrPack<DW_AT_data_member_location, DW_AT_accessibility>;
+    using typeIdentityAttrs = dw::attrPack<DW_AT_declaration, DW_AT_decl_file, DW_AT_decl_line, DW_AT_byte_size>;
+
+    dw::file  mDbg;
+    typeNamer mNamer{mDbg};
+    Json      mOutputJson;
+
+    declFilter            mFilter;
+    declFilter::nsState   mNsState; // 当前所在的命名空间
+
+    // 一次解析, 多个输出: 每个输出只取路径规则匹配的顶层文件节点
+    struct output
+    {
+        std::string path;
+        declFilter  filter;
+    };
+    std::vector<output> mOutputs;
+
+    // 已输出的类型定义, 用于跨CU的ODR去重
+    std::unordered_set<std::string> mEmittedTypes;
+
+    struct scopeRoute
+    {
+        std::vector<std::string> path;
+        uint64_t                 declFileIdx = 0; // 非0时表示改为存放在该文件中
+    };
+
+    struct storeNodeKey
+    {
+        uint64_t           scopeOffset;
+        const std::string *declFile;
+
+        bool operator==(const storeNodeKey &) const = default;
+    };
+
+    struct storeNodeKeyHash
+    {
+        size_t operator()(const storeNodeKey &key) const noexcept
+        {
+            return dw::hashCombine(key.scopeOffset, reinterpret_cast<uintptr_t>(key.declFile));
+        }
+    };
+
+    std::unordered_set<std::string>                                mDeclFiles; // 简化后的源文件路径
+    std::unordered_map<uint64_t, std::vector<const std::string *>> mCUDeclFiles; // CU偏移 -> 文件表
+    std::unordered_map<uint64_t, scopeRoute>                       mScopeRoutes; // 作用域die偏移 -> 相对路径
+    std::unordered_map<storeNodeKey, Json *, storeNodeKeyHash>     mStoreNodes; // (作用域, 文件) -> json节点
+
+    std::unordered_map<const std::string *, bool> mAllowedFiles; // 源文件 -> 是否满足路径规则
+    std::vector<bool>                             mMatchingFiles; // 当前CU文件表中满足路径规则的项, 下标为 decl_file
+
+    uint64_t mParsedDIEs = 0;
+    bool     mQuiet = false; // 不输出进度信息, 见 `setQuiet`
 
 public:
     dwarf2json(std::string_view filePath) :
-        mDbg(filePath) {}
+        mDbg(filePath)
+    {
+        this->selectDecodedAttrs();
+    }
+
+    /**
+     * @brief 解析内存中的DWARF, 见 `dw::builder`
+     * @param object 生命周期须长于本对象
+     */
+    dwarf2json(Dwarf_Obj_Access_Interface_a *object, std::string_view name = "<memory>") :
+        mDbg(object, name)
+    {
+        this->selectDecodedAttrs();
+    }
 
-    int start(std::string_view filter = "")
+    dw::file &getFile() noexcept
     {
-        this->mDeclFileFilter = filter;
+        return this->mDbg;
+    }
+
+    /**
+     * @brief 上次 `start` 解析的die数, 用于 `--bench` 计算 ns/DIE
+     */
+    uint64_t getParsedDIEs() const noexcept
+    {
+        return this->mParsedDIEs;
+    }
+
+    /**
+     * @brief 不输出每个CU的 "Finished" 等进度信息, 用于基准测试
+     */
+    void setQuiet(bool quiet) noexcept
+    {
+        this->mQuiet = quiet;
+    }
+
+    /**
+     * @brief 清空上一次 `start` 的结果, 保留已打开的 dw::file 及文件表缓存, 以便在同一个文件上重复解析.
+     *        路径规则的求值结果依赖传给 `start` 的规则, 一并清空
+     */
+    void reset()
+    {
+        this->mAllowedFiles.clear();
+        this->mMatchingFiles.clear();
+        this->mOutputJson = Json{};
+        this->mEmittedTypes.clear();
+        this->mScopeRoutes.clear();
+        this->mStoreNodes.clear();
+        this->mParsedDIEs = 0;
+    }
+
+    /**
+     * @param filter 已编译的过滤规则, 见 `declFilter`
+     */
+    int start(declFilter filter = {})
+    {
+        this->mFilter = std::move(filter);
+        this->mNsState = this->mFilter.rootNamespace();
         if (!this->mDbg.isOpen())
             return -1;
+        trace::scope parseTrace{"parse"};
+        size_t       skippedCUs = 0;
         for (auto &&compileUnit : this->mDbg.getCUs())
         {
-            this->parseCU(compileUnit);
-            std::println("Finished: {}", compileUnit.getName());
-            compileUnit.clearCachedChildren();
+            if (!this->selectCU(compileUnit))
+            {
+                ++skippedCUs;
+                continue;
+            }
+            {
+                trace::scope    cuTrace{"CU", [&] { return compileUnit.traceArgs(); }};
+                memory::cuScope cuMemory{compileUnit.getName()};
+                this->parseCU(compileUnit);
+                compileUnit.clearCachedChildren();
+            }
+            if (!this->mQuiet)
+                std::println("Finished: {}", compileUnit.getName());
         }
+        if (skippedCUs && !this->mQuiet)
+            std::println("Skipped {} of {} CUs by the path rules", skippedCUs, this->mDbg.getCUs().size());
         return 0;
     }
 
-    int dumpData()
+    /**
+     * @brief 添加一个输出, 此后 `dumpData` 只写各个输出. 任一输出接受的文件都会被解析
+     *
+     * @param filter 已编译的路径规则, 作用于简化后的声明文件路径
+     */
+    void addOutput(std::string_view path, declFilter filter)
+    {
+        this->mOutputs.push_back({std::string{path}, std::move(filter)});
+    }
+
+    /**
+     * @return -1 表示有文件无法写入
+     */
+    int dumpData(const std::string &outPath = "out.json")
     {
         static TimerToken token;
         Timer             timer{token};
-        std::ofstream     file("out.json");
-        if (file.is_open())
+        trace::scope      dumpTrace{"dump"};
+        if (this->mOutputs.empty())
+            return this->dumpFiles(outPath, nullptr);
+
+        int ret = 0;
+        for (auto &&item : this->mOutputs)
         {
-            dwarfUtils::custom_format(this->mOutputJson, file);
-            std::println("File output to out.json");
-            file.close();
-            return 0;
+            if (this->dumpFiles(item.path, &item.filter) == -1)
+                ret = -1;
         }
-        return -1;
+        return ret;
+    }
+
+    /**
+     * @brief 与 `dumpData` 相同的序列化, 写入同一个流, 用于基准测试
+     */
+    void writeData(std::ostream &out)
+    {
+        if (this->mOutputs.empty())
+            this->writeFiles(out, nullptr);
+        for (auto &&item : this->mOutputs)
+            this->writeFiles(out, &item.filter);
     }
 
 private:
+    // 只解码解析过程中读取的属性
+    void selectDecodedAttrs()
+    {
+        dw::attrMask mask;
+        functionAttrs::addTo(mask);
+        variableAttrs::addTo(mask);
+        enumAttrs::addTo(mask);
+        unionAttrs::addTo(mask);
+        typedefAttrs::addTo(mask);
+        inheritanceAttrs::addTo(mask);
+        typeIdentityAttrs::addTo(mask);
+        typeNamer::usedAttrs::addTo(mask);
+        this->mDbg.setDecodedAttrs(mask);
+    }
+
+    int dumpFiles(const std::string &outPath, const declFilter *filter)
+    {
+        std::ofstream file(outPath);
+        if (!file.is_open())
+            return -1;
+        this->writeFiles(file, filter);
+        if (!this->mQuiet)
+            std::println("File output to {}", outPath);
+        return 0;
+    }
+
+    /**
+     * @brief 顶层节点为声明文件, 按输出的路径规则挑选文件节点直接写出, 不复制json
+     *
+     * @param filter nullptr 表示全部写出
+     */
+    void writeFiles(std::ostream &out, const declFilter *filter)
+    {
+        if (!filter)
+        {
+            dwarfUtils::custom_format(this->mOutputJson, out);
+            return;
+        }
+        out << "{\n";
+        bool first = true;
+        for (auto it = this->mOutputJson.begin(); it != this->mOutputJson.end(); ++it)
+        {
+            if (!filter->allowsPath(it.key()))
+                continue;
+            if (!first)
+                out << ",\n";
+            first = false;
+            out << std::format("    \"{}\": ", dwarfUtils::escape_json_string(it.key()));
+            dwarfUtils::custom_format(it.value(), out, 4);
+        }
+        out << "\n}";
+    }
+
+    /**
+     * @brief 根据CU的文件表预先筛选: 实体的 decl_file 只能指向所在CU的文件表,
+     *        文件表中没有满足过滤条件的文件时整个CU都不会产生输出, 无需读取其中的die
+     *
+     * @return false 表示跳过该CU
+     */
+    bool selectCU(dw::CU &compileUnit)
+    {
+        const auto &declFiles = this->getDeclFiles(compileUnit);
+        this->mMatchingFiles.assign(declFiles.size() + 1, false);
+        bool anyMatch = false;
+        for (size_t idx = 0; idx < declFiles.size(); idx++)
+        {
+            if (this->allowsDeclFile(declFiles[idx]))
+                this->mMatchingFiles[idx + 1] = anyMatch = true;
+        }
+        return anyMatch;
+    }
+
+    bool allowsDeclFile(const std::string *declFile)
+    {
+        auto [it, inserted] = this->mAllowedFiles.try_emplace(declFile);
+        if (inserted)
+        {
+            it->second = this->mFilter.allowsPath(*declFile) &&
+                         (this->mOutputs.empty() || std::any_of(this->mOutputs.begin(), this->mOutputs.end(), [&](const output &item) {
+                              return item.filter.allowsPath(*declFile);
+                          }));
+        }
+        return it->second;
+    }
+
+    auto pruner() const
+    {
+        return [this](const dw::rawDIE &raw) { return this->shouldPrune(raw, true); };
+    }
+
     void parseCU(dw::CU &compileUnit)
     {
-        for (auto &&child : compileUnit.getChildren(this->mDbg))
+        memory::tag memTag{memory::category::jsonDom};
+        for (auto &&child : compileUnit.getChildren(this->mDbg, [this](const dw::rawDIE &raw) { return this->pruneScopeChild(raw); }))
         {
             this->parseDIE(compileUnit, child);
         }
     }
 
+    /**
+     * @brief CU和命名空间的直接子节点: 在 `shouldPrune` 的基础上, 跳过 decl_file 不满足过滤条件的实体.
+     *        命名空间本身跨越多个文件, 带 DW_AT_specification 的定义存放在声明所在的文件, 这两类不按文件跳过
+     */
+    bool pruneScopeChild(const dw::rawDIE &raw) const
+    {
+        if (this->shouldPrune(raw, false))
+            return true;
+        if ((!this->mFilter.hasPathRules() && this->mOutputs.empty()) || raw.getTAG() == DW_TAG_namespace || raw.hasAttr(DW_AT_specification))
+            return false;
+        uint64_t declFileIdx = raw.getAttrAsInt(DW_AT_decl_file);
+        return declFileIdx >= this->mMatchingFiles.size() || !this->mMatchingFiles[declFileIdx];
+    }
+
+    /**
+     * @brief 在解码属性之前判断是否跳过整棵子树: 没有处理函数的tag (函数形参除外),
+     *        被过滤规则排除的命名空间和实体. 被跳过的die不解码属性, 其子树也不会被读取
+     *
+     * @param nested die位于类/函数内部, 只检查排除规则, 见 `declFilter::allowsEntity`
+     */
+    bool shouldPrune(const dw::rawDIE &raw, bool nested) const
+    {
+        uint16_t tag = raw.getTAG();
+        switch (tag)
+        {
+        case DW_TAG_formal_parameter:
+        case DW_TAG_unspecified_parameters:
+        case DW_TAG_GNU_formal_parameter_pack:
+            return false;
+        case DW_TAG_namespace:
+            return this->mFilter.prunesNamespace(this->mFilter.enterNamespace(this->mNsState, raw.getName()));
+        default:
+            break;
+        }
+        size_t idx = dw::tagIndex(tag);
+        if (idx >= dw::tagIndexCount || !tagTable[idx])
+            return true;
+        // 定义按声明所在的作用域过滤, 见 `isFilteredOut`
+        if (declFilter::kindOf(tag) == declFilter::kindNone || raw.hasAttr(DW_AT_specification))
+            return false;
+        return !this->mFilter.allowsEntity(this->mNsState, tag, this->mFilter.hasNameRules() ? raw.getName() : "", nested);
+    }
+
+    /**
+     * @brief 解码后的die再检查一次过滤规则, 子节点可能已经被其他地方不带剪枝地读取过.
+     *        带 DW_AT_specification 的定义按其声明的名称和所在命名空间过滤:
+     *        包含规则作用于声明所在的命名空间级实体 (e.g. 成员函数所在的类), 排除规则也作用于声明本身
+     */
+    bool isFilteredOut(const dw::die &DIE)
+    {
+        if (declFilter::kindOf(DIE.getTAG()) == declFilter::kindNone)
+            return false;
+        const dw::attr *specification = DIE.findAttrByType(DW_AT_specification);
+        if (!specification)
+            return !this->mFilter.allowsEntity(this->mNsState, DIE.getTAG(), DIE.getName(), isNested(DIE));
+
+        const dw::die *declDIE = this->mDbg.findDIEbyOffset(specification->get<uint64_t>());
+        if (!declDIE)
+            return true;
+        const dw::die                *scopeDIE = declDIE;
+        std::vector<std::string_view> namespaces;
+        for (const dw::die *parentDIE = declDIE->getParentDIE(); parentDIE; parentDIE = parentDIE->getParentDIE())
+        {
+            if (parentDIE->getTAG() == DW_TAG_namespace)
+                namespaces.emplace_back(parentDIE->getName());
+            else if (namespaces.empty() && !parentDIE->isCompileUnit())
+                scopeDIE = parentDIE;
+        }
+        declFilter::nsState ns = this->mFilter.rootNamespace();
+        for (auto it = namespaces.rbegin(); it != namespaces.rend(); ++it)
+            ns = this->mFilter.enterNamespace(ns, *it);
+        if (!this->mFilter.allowsEntity(ns, scopeDIE->getTAG(), scopeDIE->getName()))
+            return true;
+        return scopeDIE != declDIE && !this->mFilter.allowsEntity(ns, declDIE->getTAG(), declDIE->getName(), true);
+    }
+
+    /**
+     * @brief 父节点不是CU或命名空间
+     */
+    static bool isNested(const dw::die &DIE)
+    {
+        const dw::die *parentDIE = DIE.getParentDIE();
+        return parentDIE && !parentDIE->isCompileUnit() && parentDIE->getTAG() != DW_TAG_namespace;
+    }
+
 #pragma region parseDIE
 
+    using tagHandler = void (dwarf2json::*)(dw::CU &, dw::die &);
+
     void parseDIE(dw::CU &compileUnit, dw::die &DIE)
     {
         static TimerToken token;
         Timer             timer{token};
-        uint16_t          tagId = DIE.getTAG();
-        switch (tagId)
+        if (DIE.isPruned() || this->isFilteredOut(DIE))
+            return;
+        ++this->mParsedDIEs;
+        size_t idx = dw::tagIndex(DIE.getTAG());
+        if (idx < dw::tagIndexCount && tagTable[idx])
+            (this->*tagTable[idx])(compileUnit, DIE);
+    }
+
+    void parseChildren(dw::CU &compileUnit, dw::die &DIE)
+    {
+        for (auto &&childDIE : DIE.getChildren(this->mDbg, this->pruner()))
         {
-        case DW_TAG_namespace: {
-            std::string_view dieName = DIE.getName();
-            if (dieName == "std" || dieName.starts_with("__"))
+            this->parseDIE(compileUnit, childDIE);
+        }
+    }
+
+    void parseClass(dw::CU &compileUnit, dw::die &classDIE)
+    {
+        if (this->isDuplicateType(compileUnit, classDIE))
+            return this->parseDuplicateChildren(compileUnit, classDIE);
+        this->parseChildren(compileUnit, classDIE);
+    }
+
+    /**
+     * @brief 已输出过的类型在后续CU中不再重复输出数据成员, 但成员函数、编译器隐式生成的特殊成员
+     *        以及嵌套/局部类型可能只出现在后面的CU里, 仍然要展开并合并到第一次输出的节点下
+     */
+    void parseDuplicateChildren(dw::CU &compileUnit, dw::die &typeDIE)
+    {
+        for (auto &&childDIE : typeDIE.getChildren(this->mDbg, this->pruner()))
+        {
+            switch (childDIE.getTAG())
+            {
+            case DW_TAG_subprogram:
+            case DW_TAG_class_type:
+            case DW_TAG_structure_type:
+            case DW_TAG_union_type:
+            case DW_TAG_enumeration_type:
+            case DW_TAG_typedef:
+                this->parseDIE(compileUnit, childDIE);
+                break;
+            default:
                 break;
+            }
         }
-        case DW_TAG_class_type:
-        case DW_TAG_structure_type:
-        case DW_TAG_lexical_block:
-            for (auto &&childDIE : DIE.getChildren(this->mDbg))
+    }
+
+    void parseNamespace(dw::CU &compileUnit, dw::die &namespaceDIE)
+    {
+        declFilter::nsState outer = std::move(this->mNsState);
+        this->mNsState = this->mFilter.enterNamespace(outer, namespaceDIE.getName());
+        if (!this->mFilter.prunesNamespace(this->mNsState))
+        {
+            for (auto &&childDIE : namespaceDIE.getChildren(this->mDbg, [this](const dw::rawDIE &raw) { return this->pruneScopeChild(raw); }))
             {
                 this->parseDIE(compileUnit, childDIE);
             }
-            break;
-        case DW_TAG_subprogram:
-            this->parseFunction(compileUnit, DIE);
-            break;
-        case DW_TAG_enumeration_type:
-            this->parseEnum(compileUnit, DIE);
-            break;
-        case DW_TAG_union_type:
-            this->parseUnion(compileUnit, DIE);
-            break;
-        case DW_TAG_variable:
-            this->parseVariable(compileUnit, DIE);
-            break;
-        case DW_TAG_member:
-            this->parseVariable(compileUnit, DIE, true);
-            break;
-        case DW_TAG_typedef:
-            this->parseTypedef(compileUnit, DIE);
-            break;
-        case DW_TAG_inheritance:
-            this->parseInheritance(compileUnit, DIE);
-            break;
-        case DW_TAG_GNU_template_parameter_pack:
-        case DW_TAG_template_type_param:
-        case DW_TAG_template_value_param:
-            this->parseClassTemplateParams(compileUnit, DIE);
-            break;
-        default:
-            break;
         }
+        this->mNsState = std::move(outer);
     }
 
 #pragma region parseFunction
@@ -115,27 +465,25 @@ private:
         static TimerToken token;
         Timer             timer{token};
 
-        if (funcDIE.getName().starts_with("__"))
-            return;
-
-        const dw::attr *hasSpecification = funcDIE.findAttrByType(DW_AT_specification);
+        functionAttrs   attrs{funcDIE.getAttrs()};
+        const dw::attr *hasSpecification = attrs.get<DW_AT_specification>();
         if (hasSpecification)
         {
             dw::die *specificFunc = this->mDbg.findDIEbyOffset(hasSpecification->get<uint64_t>());
             if (!specificFunc)
                 return;
-            std::vector<std::string> path = this->findWhereToStore(compileUnit, *specificFunc);
-            if (path.empty())
+            Json *out = this->findWhereToStore(compileUnit, *specificFunc);
+            if (!out)
                 return;
 
-            const dw::attr *decl_line = specificFunc->findAttrByType(DW_AT_decl_line);
+            const dw::attr *decl_line = functionAttrs{specificFunc->getAttrs()}.get<DW_AT_decl_line>();
             std::string     storeKey =
                 std::format("{:05}-func: {}", decl_line ? decl_line->get<uint64_t>() : 0, specificFunc->getName("`anonymous`"));
 
             // 获取形参名
             std::vector<std::string> paramNames;
             std::vector<dw::die *>   laterToParse;
-            for (auto &&localInfoDIE : funcDIE.getChildren(this->mDbg))
+            for (auto &&localInfoDIE : funcDIE.getChildren(this->mDbg, this->pruner()))
             {
                 uint16_t tagId = localInfoDIE.getTAG();
                 switch (tagId)
@@ -154,11 +502,6 @@ private:
             }
 
             // 保存数据
-            Json *out = &this->mOutputJson;
-            for (auto &&it : path)
-            {
-                out = &(*out)[it];
-            }
             if (out->find(storeKey) == out->end())
                 this->parseFunction(compileUnit, *specificFunc);
 
@@ -167,7 +510,7 @@ private:
             if (!paramNames.empty())
                 funcInfo["2-param_name"] = paramNames;
 
-            const dw::attr *attr = funcDIE.findAttrByType(DW_AT_linkage_name);
+            const dw::attr *attr = attrs.get<DW_AT_linkage_name>();
             if (attr)
                 funcInfo["0-linkage"] = attr->get<std::string_view>();
 
@@ -180,76 +523,57 @@ private:
         }
         else
         {
-            Json                     funcInfo;
-            std::vector<std::string> path = this->findWhereToStore(compileUnit, funcDIE);
-            if (path.empty())
+            Json  funcInfo;
+            Json *out = this->findWhereToStore(compileUnit, funcDIE);
+            if (!out)
                 return;
 
-            const dw::attr *decl_line = funcDIE.findAttrByType(DW_AT_decl_line);
+            const dw::attr *decl_line = attrs.get<DW_AT_decl_line>();
             std::string     storeKey =
                 std::format("{:05}-func: {}", decl_line ? decl_line->get<uint64_t>() : 0, funcDIE.getName("`anonymous`"));
 
             funcInfo["offset"] = funcDIE.getOffset();
-            bool isRef = false, isRvRef = false;
-            for (auto &&attr : funcDIE.getAttrs())
+            if (const dw::attr *attr = attrs.get<DW_AT_name>())
+                funcInfo["0-name"] = attr->get<std::string_view>();
+            if (const dw::attr *attr = attrs.get<DW_AT_linkage_name>())
+                funcInfo["0-linkage"] = attr->get<std::string_view>();
+            if (attrs.get<DW_AT_external>())
+                funcInfo["0-external"] = 1;
+            if (const dw::attr *attr = attrs.get<DW_AT_accessibility>())
+                funcInfo["1-accessibility"] = attr->get<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_defaulted>())
+                funcInfo["1-default"] = attr->get<uint64_t>();
+            if (attrs.get<DW_AT_deleted>())
+                funcInfo["1-deleted"] = 1;
+            if (decl_line)
+                funcInfo["0-decl_pos"][0] = decl_line->get<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_decl_column>())
+                funcInfo["0-decl_pos"][1] = attr->get<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_virtuality>())
+                funcInfo["1-virtual"] = attr->get<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_inline>())
+                funcInfo["1-inline"] = attr->get<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_vtable_elem_location>())
             {
-                uint16_t typeId = attr.getType();
-                switch (typeId)
-                {
-                case DW_AT_name:
-                    funcInfo["0-name"] = attr.get<std::string_view>();
-                    break;
-                case DW_AT_linkage_name:
-                    funcInfo["0-linkage"] = attr.get<std::string_view>();
-                    break;
-                case DW_AT_external:
-                    funcInfo["0-external"] = 1;
-                    break;
-                case DW_AT_accessibility:
-                    funcInfo["1-accessibility"] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_defaulted:
-                    funcInfo["1-default"] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_deleted:
-                    funcInfo["1-deleted"] = 1;
-                    break;
-                case DW_AT_decl_line:
-                    funcInfo["0-decl_pos"][0] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_decl_column:
-                    funcInfo["0-decl_pos"][1] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_virtuality:
-                    funcInfo["1-virtual"] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_inline:
-                    funcInfo["1-inline"] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_vtable_elem_location:
-                    funcInfo["1-vtable_loc"] = attr.get<dw::LocList>()[0].opd1;
-                    break;
-                case DW_AT_reference:
-                    funcInfo["1-ref_decorate"] = 1;
-                    break;
-                case DW_AT_rvalue_reference:
-                    funcInfo["1-r_ref_decorate"] = 1;
-                    break;
-                case DW_AT_artificial:
-                    funcInfo["1-artificial"] = 1;
-                default:
-                    break;
-                }
+                dw::LocList ops = attr->get<dw::LocList>();
+                funcInfo["1-vtable_loc"] = ops.empty() ? attr->getValueAsInt<uint64_t>() : ops[0].opd1;
             }
+            if (attrs.get<DW_AT_reference>())
+                funcInfo["1-ref_decorate"] = 1;
+            if (attrs.get<DW_AT_rvalue_reference>())
+                funcInfo["1-r_ref_decorate"] = 1;
+            if (attrs.get<DW_AT_artificial>())
+                funcInfo["1-artificial"] = 1;
+
             // 获取返回值
-            funcInfo.emplace("1-type", this->getTypeInfo(funcDIE, ""));
+            funcInfo.emplace("1-type", this->mNamer.getTypeInfo(funcDIE, ""));
 
             // 获取形参信息和模板参数信息
             std::vector<std::string> paramTypes;
             std::vector<std::string> paramNames;
             std::vector<std::string> templateParams;
             std::vector<dw::die *>   laterToParse;
-            for (auto &&localInfoDIE : funcDIE.getChildren(this->mDbg))
+            for (auto &&localInfoDIE : funcDIE.getChildren(this->mDbg, this->pruner()))
             {
                 uint16_t tagId = localInfoDIE.getTAG();
                 switch (tagId)
@@ -258,13 +582,13 @@ private:
                     if (localInfoDIE.findAttrByType(DW_AT_artificial))
                     {
                         uint8_t isConst = 0;
-                        paramTypes.emplace_back(this->getTypeInfo(localInfoDIE, "{obj_ptr}", &isConst));
+                        paramTypes.emplace_back(this->mNamer.getTypeInfo(localInfoDIE, "{obj_ptr}", &isConst));
                         if (isConst & 1)
                             funcInfo["const_decorate"] = 1;
                     }
                     else
                     {
-                        paramTypes.emplace_back(this->getTypeInfo(localInfoDIE, "{}"));
+                        paramTypes.emplace_back(this->mNamer.getTypeInfo(localInfoDIE, "{}"));
                     }
                     paramNames.emplace_back(localInfoDIE.getName("/*Unnamed*/"));
                     break;
@@ -279,7 +603,7 @@ private:
                     templateParams.emplace_back(localInfoDIE.getName("/*Unnamed*/"));
                     break;
                 case DW_TAG_template_value_param:
-                    templateParams.emplace_back(this->getTypeInfo(localInfoDIE, localInfoDIE.getName("/*Unnamed*/")));
+                    templateParams.emplace_back(this->mNamer.getTypeInfo(localInfoDIE, localInfoDIE.getName("/*Unnamed*/")));
                     break;
                 case DW_TAG_GNU_template_parameter_pack:
                     templateParams.emplace_back(std::format("...{}", localInfoDIE.getName("/*Unnamed*/")));
@@ -299,11 +623,6 @@ private:
                 funcInfo.emplace("2-param_name", std::move(paramNames));
 
             // 保存数据
-            Json *out = &this->mOutputJson;
-            for (auto &&it : path)
-            {
-                out = &(*out)[it];
-            }
             out->emplace(storeKey, std::move(funcInfo));
 
             for (auto &&die : laterToParse)
@@ -321,37 +640,26 @@ private:
         Timer             timer{token};
         Json              enumInfo;
 
-        std::vector<std::string> path = this->findWhereToStore(compileUnit, enumDIE);
-        if (path.empty())
+        if (this->isDuplicateType(compileUnit, enumDIE))
             return;
 
-        enumInfo["offset"] = enumDIE.getOffset();
+        Json *out = this->findWhereToStore(compileUnit, enumDIE);
+        if (!out)
+            return;
 
-        for (auto &&attr : enumDIE.getAttrs())
-        {
-            uint16_t               attrType = attr.getType();
-            const dw::attr::value &value = attr.getValue();
-            switch (attrType)
-            {
-            case DW_AT_name:
-                enumInfo["0-name"] = attr.get<std::string_view>();
-                break;
-            case DW_AT_enum_class:
-                enumInfo["0-enum_class"] = 1;
-                break;
-            case DW_AT_decl_line:
-                enumInfo["0-decl_pos"][0] = attr.getValueAsInt<uint64_t>();
-                break;
-            case DW_AT_decl_column:
-                enumInfo["0-decl_pos"][1] = attr.getValueAsInt<uint64_t>();
-                break;
-            default:
-                break;
-            }
-        }
+        enumInfo["offset"] = enumDIE.getOffset();
+        enumAttrs attrs{enumDIE.getAttrs()};
+        if (const dw::attr *attr = attrs.get<DW_AT_name>())
+            enumInfo["0-name"] = attr->get<std::string_view>();
+        if (attrs.get<DW_AT_enum_class>())
+            enumInfo["0-enum_class"] = 1;
+        if (const dw::attr *attr = attrs.get<DW_AT_decl_line>())
+            enumInfo["0-decl_pos"][0] = attr->getValueAsInt<uint64_t>();
+        if (const dw::attr *attr = attrs.get<DW_AT_decl_column>())
+            enumInfo["0-decl_pos"][1] = attr->getValueAsInt<uint64_t>();
 
         // 获取基础类型
-        enumInfo.emplace("1-type", this->getTypeInfo(enumDIE, ""));
+        enumInfo.emplace("1-type", this->mNamer.getTypeInfo(enumDIE, ""));
 
         // 获取枚举项
         for (auto &&enumerator : enumDIE.getChildren(this->mDbg))
@@ -359,23 +667,18 @@ private:
             if (enumerator.getTAG() == DW_TAG_enumerator)
             {
                 const dw::attr *enumVal = enumerator.findAttrByType(DW_AT_const_value);
-                if (enumVal->getValue().index() == 1)
+                if (enumVal->index() == dw::attr::udata)
                     enumInfo["content"].emplace(enumerator.getName(), enumVal->get<uint64_t>());
                 else
                     enumInfo["content"].emplace(enumerator.getName(), enumVal->get<int64_t>());
             }
         }
 
-        const dw::attr *decl_line = enumDIE.findAttrByType(DW_AT_decl_line);
+        const dw::attr *decl_line = attrs.get<DW_AT_decl_line>();
         std::string     storeKey =
             std::format("{:05}-enum: {}", decl_line ? decl_line->get<uint64_t>() : 0, enumDIE.getName("`anonymous`"));
 
         // 保存数据
-        Json *out = &this->mOutputJson;
-        for (auto &&it : path)
-        {
-            out = &(*out)[it];
-        }
         out->emplace(storeKey, std::move(enumInfo));
     }
 
@@ -386,43 +689,28 @@ private:
         static TimerToken        token;
         Timer                    timer{token};
         Json                     unionInfo;
-        std::vector<std::string> path = this->findWhereToStore(compileUnit, unionDIE);
-        if (path.empty())
+        if (this->isDuplicateType(compileUnit, unionDIE))
+            return this->parseDuplicateChildren(compileUnit, unionDIE);
+
+        Json *out = this->findWhereToStore(compileUnit, unionDIE);
+        if (!out)
             return;
 
         unionInfo["offset"] = unionDIE.getOffset();
-        for (auto &&attr : unionDIE.getAttrs())
-        {
-            uint16_t               attrType = attr.getType();
-            const dw::attr::value &value = attr.getValue();
-            switch (attrType)
-            {
-            case DW_AT_name:
-                unionInfo["0-name"] = attr.get<std::string_view>();
-                break;
-            case DW_AT_decl_line:
-                unionInfo["0-decl_pos"][0] = attr.get<uint64_t>();
-                break;
-            case DW_AT_decl_column:
-                unionInfo["0-decl_pos"][1] = attr.get<uint64_t>();
-                break;
-            case DW_AT_byte_size:
-                unionInfo["0-byte_size"] = attr.get<uint64_t>();
-                break;
-            default:
-                break;
-            }
-        }
+        unionAttrs attrs{unionDIE.getAttrs()};
+        if (const dw::attr *attr = attrs.get<DW_AT_name>())
+            unionInfo["0-name"] = attr->get<std::string_view>();
+        if (const dw::attr *attr = attrs.get<DW_AT_decl_line>())
+            unionInfo["0-decl_pos"][0] = attr->get<uint64_t>();
+        if (const dw::attr *attr = attrs.get<DW_AT_decl_column>())
+            unionInfo["0-decl_pos"][1] = attr->get<uint64_t>();
+        if (const dw::attr *attr = attrs.get<DW_AT_byte_size>())
+            unionInfo["0-byte_size"] = attr->get<uint64_t>();
 
         // 保存数据
-        Json *out = &this->mOutputJson;
-        for (auto &&it : path)
-        {
-            out = &(*out)[it];
-        }
         out->emplace(std::format("union: {}", unionDIE.getName("`anonymous`")), std::move(unionInfo));
 
-        for (auto &&child : unionDIE.getChildren(this->mDbg))
+        for (auto &&child : unionDIE.getChildren(this->mDbg, this->pruner()))
         {
             this->parseDIE(compileUnit, child);
         }
@@ -430,128 +718,100 @@ private:
 
 #pragma region parseVariable
 
-    void parseVariable(dw::CU &compileUnit, dw::die &varDIE, bool memberVariable = false)
+    void parseVariable(dw::CU &compileUnit, dw::die &varDIE)
+    {
+        this->parseVariable(compileUnit, varDIE, false);
+    }
+
+    void parseMember(dw::CU &compileUnit, dw::die &memberDIE)
+    {
+        this->parseVariable(compileUnit, memberDIE, true);
+    }
+
+    void parseVariable(dw::CU &compileUnit, dw::die &varDIE, bool memberVariable)
     {
         static TimerToken token;
         Timer             timer{token};
         Json              variableInfo;
 
-        const dw::attr *hasSpecification = varDIE.findAttrByType(DW_AT_specification);
+        variableAttrs   attrs{varDIE.getAttrs()};
+        const dw::attr *hasSpecification = attrs.get<DW_AT_specification>();
         if (hasSpecification)
         {
             dw::die *specificVar = this->mDbg.findDIEbyOffset(hasSpecification->get<uint64_t>());
             if (!specificVar)
                 return;
-            std::vector<std::string> path = this->findWhereToStore(compileUnit, *specificVar);
-            if (path.empty())
+            Json *out = this->findWhereToStore(compileUnit, *specificVar);
+            if (!out)
                 return;
 
             memberVariable = specificVar->getTAG() == DW_TAG_member;
 
-            const dw::attr *decl_line = specificVar->findAttrByType(DW_AT_decl_line);
+            const dw::attr *decl_line = variableAttrs{specificVar->getAttrs()}.get<DW_AT_decl_line>();
             std::string     storeKey = std::format("{:05}-{}: {}",
                                                decl_line ? decl_line->get<uint64_t>() : 0,
                                                memberVariable ? "memb" : "var",
                                                    specificVar->getName("`Unnamed`"));
 
-            Json *out = &this->mOutputJson;
-            for (auto &&it : path)
-            {
-                out = &(*out)[it];
-            }
             if (out->find(storeKey) == out->end())
                 this->parseVariable(compileUnit, *specificVar, memberVariable);
             Json &varJson = (*out)[storeKey];
 
-            for (auto &&attr : varDIE.getAttrs())
-            {
-                uint16_t typeId = attr.getType();
-                switch (typeId)
-                {
-                case DW_AT_location:
-                    varJson.emplace("1-location", attr.get<dw::LocList>()[0].toString());
-                    break;
-                case DW_AT_linkage_name:
-                    varJson["1-linkage"] = attr.get<std::string_view>();
-                    break;
-                }
-            }
+            if (const dw::attr *attr = attrs.get<DW_AT_location>())
+                varJson.emplace("1-location", attr->getValueAsString());
+            if (const dw::attr *attr = attrs.get<DW_AT_linkage_name>())
+                varJson["1-linkage"] = attr->get<std::string_view>();
         }
         else
         {
-            std::vector<std::string> path = this->findWhereToStore(compileUnit, varDIE);
-            if (path.empty())
+            Json *out = this->findWhereToStore(compileUnit, varDIE);
+            if (!out)
                 return;
 
             // 获取属性
             variableInfo["offset"] = varDIE.getOffset();
-            for (auto &&attr : varDIE.getAttrs())
+            if (const dw::attr *attr = attrs.get<DW_AT_name>())
+                variableInfo["0-name"] = attr->get<std::string_view>();
+            if (const dw::attr *attr = attrs.get<DW_AT_decl_line>())
+                variableInfo["0-decl_pos"][0] = attr->getValueAsInt<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_decl_column>())
+                variableInfo["0-decl_pos"][1] = attr->getValueAsInt<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_data_member_location>())
+                variableInfo["1-member_location"] = attr->getValueAsInt<uint64_t>();
+            if (attrs.get<DW_AT_declaration>())
+                variableInfo["0-declaration"] = 1;
+            if (attrs.get<DW_AT_external>())
+                variableInfo["0-external"] = 1;
+            if (const dw::attr *attr = attrs.get<DW_AT_accessibility>())
+                variableInfo["1-accessibility"] = attr->getValueAsInt<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_inline>())
+                variableInfo["1-inline"] = attr->getValueAsInt<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_location>())
+                variableInfo.emplace("1-location", attr->getValueAsString());
+            if (const dw::attr *attr = attrs.get<DW_AT_linkage_name>())
+                variableInfo["1-linkage"] = attr->get<std::string_view>();
+            if (const dw::attr *attr = attrs.get<DW_AT_const_value>())
             {
-                uint16_t attrType = attr.getType();
-                switch (attrType)
-                {
-                case DW_AT_name:
-                    variableInfo["0-name"] = attr.get<std::string_view>();
-                    break;
-                case DW_AT_decl_line:
-                    variableInfo["0-decl_pos"][0] = attr.getValueAsInt<uint64_t>();
-                    break;
-                case DW_AT_decl_column:
-                    variableInfo["0-decl_pos"][1] = attr.getValueAsInt<uint64_t>();
-                    break;
-                case DW_AT_data_member_location:
-                    variableInfo["1-member_location"] = attr.getValueAsInt<uint64_t>();
-                    break;
-                case DW_AT_declaration:
-                    variableInfo["0-declaration"] = 1;
-                    break;
-                case DW_AT_external:
-                    variableInfo["0-external"] = 1;
-                    break;
-                case DW_AT_accessibility:
-                    variableInfo["1-accessibility"] = attr.getValueAsInt<uint64_t>();
-                    break;
-                case DW_AT_inline:
-                    variableInfo["1-inline"] = attr.getValueAsInt<uint64_t>();
-                    break;
-                case DW_AT_location:
-                    variableInfo.emplace("1-location", attr.get<dw::LocList>()[0].toString());
-                    break;
-                case DW_AT_linkage_name:
-                    variableInfo["1-linkage"] = attr.get<std::string_view>();
-                    break;
-                case DW_AT_const_value:
-                    if (attr.index() == 1 || attr.index() == 2)
-                        variableInfo["1-const_val"] = attr.getValueAsInt<uint64_t>();
-                    else if (attr.index() == 3 || attr.index() == 4)
-                        variableInfo["1-const_val"] = attr.getValueAsInt<int64_t>();
-                    break;
-                case DW_AT_bit_size:
-                    variableInfo["1-bit_size"] = attr.get<uint64_t>();
-                    break;
-                case DW_AT_bit_offset:
-                    variableInfo["1-bit_offset"] = attr.get<uint64_t>();
-                    break;
-                default:
-                    break;
-                }
+                if (attr->index() == dw::attr::udata || attr->index() == dw::attr::udata32)
+                    variableInfo["1-const_val"] = attr->getValueAsInt<uint64_t>();
+                else if (attr->index() == dw::attr::sdata || attr->index() == dw::attr::sdata32)
+                    variableInfo["1-const_val"] = attr->getValueAsInt<int64_t>();
             }
+            if (const dw::attr *attr = attrs.get<DW_AT_bit_size>())
+                variableInfo["1-bit_size"] = attr->get<uint64_t>();
+            if (const dw::attr *attr = attrs.get<DW_AT_bit_offset>())
+                variableInfo["1-bit_offset"] = attr->get<uint64_t>();
 
             // 获取类型
-            variableInfo.emplace("1-type", this->getTypeInfo(varDIE, varDIE.getName("`Unnamed`")));
+            variableInfo.emplace("1-type", this->mNamer.getTypeInfo(varDIE, varDIE.getName("`Unnamed`")));
 
-            const dw::attr *decl_line = varDIE.findAttrByType(DW_AT_decl_line);
+            const dw::attr *decl_line = attrs.get<DW_AT_decl_line>();
             std::string     storeKey = std::format("{:05}-{}: {}",
                                                decl_line ? decl_line->get<uint64_t>() : 0,
                                                memberVariable ? "memb" : "var",
                                                    varDIE.getName("`Unnamed`"));
 
             // 保存数据
-            Json *out = &this->mOutputJson;
-            for (auto &&it : path)
-            {
-                out = &(*out)[it];
-            }
             out->emplace(storeKey, std::move(variableInfo));
         }
     }
@@ -564,41 +824,27 @@ private:
         Timer             timer{token};
         Json              typedefInfo;
 
-        std::vector<std::string> path = this->findWhereToStore(compileUnit, typedefDIE);
-        if (path.empty())
+        Json *out = this->findWhereToStore(compileUnit, typedefDIE);
+        if (!out)
             return;
 
         typedefInfo["offset"] = typedefDIE.getOffset();
-        for (auto &&attr : typedefDIE.getAttrs())
-        {
-            uint16_t attrType = attr.getType();
-            switch (attrType)
-            {
-            case DW_AT_name:
-                typedefInfo["0-name"] = attr.get<std::string_view>();
-                break;
-            case DW_AT_decl_line:
-                typedefInfo["0-decl_pos"][0] = attr.get<uint64_t>();
-                break;
-            case DW_AT_decl_column:
-                typedefInfo["0-decl_pos"][1] = attr.get<uint64_t>();
-                break;
-            }
-        }
+        typedefAttrs attrs{typedefDIE.getAttrs()};
+        if (const dw::attr *attr = attrs.get<DW_AT_name>())
+            typedefInfo["0-name"] = attr->get<std::string_view>();
+        if (const dw::attr *attr = attrs.get<DW_AT_decl_line>())
+            typedefInfo["0-decl_pos"][0] = attr->get<uint64_t>();
+        if (const dw::attr *attr = attrs.get<DW_AT_decl_column>())
+            typedefInfo["0-decl_pos"][1] = attr->get<uint64_t>();
 
         // 获取原始类型
-        typedefInfo.emplace("1-ori_type", this->getTypeInfo(typedefDIE));
+        typedefInfo.emplace("1-ori_type", this->mNamer.getTypeInfo(typedefDIE));
 
-        const dw::attr *decl_line = typedefDIE.findAttrByType(DW_AT_decl_line);
+        const dw::attr *decl_line = attrs.get<DW_AT_decl_line>();
         std::string     storeKey =
             std::format("{:05}-typedef: {}", decl_line ? decl_line->get<uint64_t>() : 0, typedefDIE.getName("`anonymous`"));
 
         // 保存数据
-        Json *out = &this->mOutputJson;
-        for (auto &&it : path)
-        {
-            out = &(*out)[it];
-        }
         out->emplace(storeKey, std::move(typedefInfo));
     }
 
@@ -610,20 +856,16 @@ private:
         Timer             timer{token};
 
         dw::die                 &parentDIE = *inheriDIE.getParentDIE();
-        std::vector<std::string> path = this->findWhereToStore(compileUnit, parentDIE);
-        if (path.empty())
+        Json *out = this->findWhereToStore(compileUnit, parentDIE);
+        if (!out)
             return;
 
-        path.emplace_back(std::format("{}: {}", parentDIE.getTAG() == DW_TAG_class_type ? "class" : "struct", parentDIE.getName("`anonymous`")));
+        out = &(*out)[std::format("{}: {}", parentDIE.getTAG() == DW_TAG_class_type ? "class" : "struct", parentDIE.getName("`anonymous`"))];
 
-        const dw::attr *data_loc = inheriDIE.findAttrByType(DW_AT_data_member_location);
-        const dw::attr *accessibility = inheriDIE.findAttrByType(DW_AT_accessibility);
-        std::string     storeKey = std::format("{:05}-{}", data_loc ? data_loc->get<uint64_t>() : 0, this->getTypeInfo(inheriDIE, ""));
-        Json           *out = &this->mOutputJson;
-        for (auto &&it : path)
-        {
-            out = &(*out)[it];
-        }
+        inheritanceAttrs attrs{inheriDIE.getAttrs()};
+        const dw::attr  *data_loc = attrs.get<DW_AT_data_member_location>();
+        const dw::attr  *accessibility = attrs.get<DW_AT_accessibility>();
+        std::string     storeKey = std::format("{:05}-{}", data_loc ? data_loc->get<uint64_t>() : 0, this->mNamer.getTypeInfo(inheriDIE, ""));
         (*out)["0-inheri"].emplace(storeKey, accessibility ? accessibility->get<uint64_t>() : 0);
     }
 
@@ -636,18 +878,13 @@ private:
         std::vector<std::string> templateInfo;
 
         dw::die                 *parent = templateDIE.getParentDIE();
-        std::vector<std::string> path = this->findWhereToStore(compileUnit, *templateDIE.getParentDIE());
-        if (path.empty())
+        Json *out = this->findWhereToStore(compileUnit, *templateDIE.getParentDIE());
+        if (!out)
             return;
 
-        path.emplace_back(std::format("{}: {}", parent->getTAG() == DW_TAG_class_type ? "class" : "struct", parent->getName("`anonymous`")));
+        out = &(*out)[std::format("{}: {}", parent->getTAG() == DW_TAG_class_type ? "class" : "struct", parent->getName("`anonymous`"))];
 
         // 保存数据
-        Json *out = &this->mOutputJson;
-        for (auto &&it : path)
-        {
-            out = &(*out)[it];
-        }
         Json &out_ = (*out)["0-template_param"];
         if (out_.empty())
         {
@@ -655,58 +892,142 @@ private:
             if (tagId == DW_TAG_template_type_param)
                 templateInfo.emplace_back(templateDIE.getName("/*Unnamed*/"));
             else if (tagId == DW_TAG_template_value_param)
-                templateInfo.emplace_back(this->getTypeInfo(templateDIE, templateDIE.getName("/*Unnamed*/")));
+                templateInfo.emplace_back(this->mNamer.getTypeInfo(templateDIE, templateDIE.getName("/*Unnamed*/")));
             else if (tagId == DW_TAG_GNU_template_parameter_pack)
                 templateInfo.emplace_back(std::format("...", templateDIE.getName("/*Unnamed*/")));
             out_ = templateInfo;
         }
     }
 
+#pragma region tagTable
+
+    // 每种tag对应的处理函数, 编译期生成按 `dw::tagIndex` 索引的表
+    static constexpr dw::tagRoute<tagHandler> tagRoutes[] = {
+        {DW_TAG_class_type, &dwarf2json::parseClass},
+        {DW_TAG_structure_type, &dwarf2json::parseClass},
+        {DW_TAG_namespace, &dwarf2json::parseNamespace},
+        {DW_TAG_lexical_block, &dwarf2json::parseChildren},
+        {DW_TAG_subprogram, &dwarf2json::parseFunction},
+        {DW_TAG_enumeration_type, &dwarf2json::parseEnum},
+        {DW_TAG_union_type, &dwarf2json::parseUnion},
+        {DW_TAG_variable, &dwarf2json::parseVariable},
+        {DW_TAG_member, &dwarf2json::parseMember},
+        {DW_TAG_typedef, &dwarf2json::parseTypedef},
+        {DW_TAG_inheritance, &dwarf2json::parseInheritance},
+        {DW_TAG_GNU_template_parameter_pack, &dwarf2json::parseClassTemplateParams},
+        {DW_TAG_template_type_param, &dwarf2json::parseClassTemplateParams},
+        {DW_TAG_template_value_param, &dwarf2json::parseClassTemplateParams},
+    };
+    static constexpr auto tagTable = dw::makeTagTable(tagRoutes);
+
+#pragma region isDuplicateType
+
+    /**
+     * @brief 跨CU的ODR去重. 同一个头文件里的类型定义会出现在大量CU中,
+     *        以 (decl_file, decl_line, tag, 完整名称, byte_size) 判断是否已经输出过,
+     *        已输出的定义不再重复输出数据成员, 只展开成员函数和嵌套类型 (见 parseDuplicateChildren)
+     *
+     * @param typeDIE class/struct/union/enum 的die
+     * @return true 表示同一定义已经输出过
+     */
+    bool isDuplicateType(dw::CU &compileUnit, const dw::die &typeDIE)
+    {
+        // 仅声明的die没有完整定义, 不参与去重
+        typeIdentityAttrs attrs{typeDIE.getAttrs()};
+        if (attrs.get<DW_AT_declaration>())
+            return false;
+
+        const dw::attr *declFileAttr = attrs.get<DW_AT_decl_file>();
+        if (!declFileAttr)
+            return false;
+
+        const std::string *declFile = this->getDeclFile(compileUnit, declFileAttr->getValueAsInt<uint64_t>());
+        if (!declFile)
+            return false;
+
+        const dw::attr *declLine = attrs.get<DW_AT_decl_line>();
+        const dw::attr *byteSize = attrs.get<DW_AT_byte_size>();
+        std::string     key = std::format("{}:{}:{}:{}:{}",
+                                          *declFile,
+                                          declLine ? declLine->getValueAsInt<uint64_t>() : 0,
+                                          typeDIE.getTAG(),
+                                          this->mNamer.completeNameScope(typeDIE),
+                                          byteSize ? byteSize->getValueAsInt<uint64_t>() : 0);
+        return !this->mEmittedTypes.emplace(std::move(key)).second;
+    }
+
 #pragma region findWhereToStore
 
     /**
-     * @brief 查找json存放路径
+     * @brief 查找json存放位置. 同一作用域和同一源文件的结果会被缓存, nlohmann::json 的 object 节点地址稳定
      *
-     * @param die 需要查找的die，其父级应当是命名空间、类、结构体、union或CU，自身不包括在return值中
-     * @return e.g. {"/src/foo.h" , "nmspc: mce", "nmspc: `anonymous``", "class: Foo /16", "struct: Bar /16"} \n
-     *           或 {"unknownRoute"} 表示查找出错 或 {} 表示无需存放
+     * @param die 需要查找的die，其父级应当是命名空间、类、结构体、union或CU
+     * @return 存放die的json节点, e.g. `["/src/foo.h"]["nmspc: mce"]["class: Foo"]`, nullptr 表示无需存放
      */
-    std::vector<std::string> findWhereToStore(dw::CU &compileUnit, const dw::die &DIE)
+    Json *findWhereToStore(dw::CU &compileUnit, const dw::die &DIE)
     {
         static TimerToken token;
         Timer             timer{token};
         const dw::attr   *attr = DIE.findAttrByType(DW_AT_decl_file);
         if (!attr)
-            return {};
+            return nullptr;
 
-        uint64_t                        declFileIdx = attr->getValueAsInt<uint64_t>();
-        const std::vector<std::string> &declFiles = compileUnit.getSrcfiles(this->mDbg);
-        if (declFileIdx > declFiles.size())
-            return {};
+        const std::string *declFile = this->getDeclFile(compileUnit, attr->getValueAsInt<uint64_t>());
+        if (!declFile || !this->allowsDeclFile(declFile))
+            return nullptr;
+
+        const dw::die *parentDIE = DIE.getParentDIE();
+        storeNodeKey   key{parentDIE ? parentDIE->getOffset() : UINT64_MAX, declFile};
+        if (auto found = this->mStoreNodes.find(key); found != this->mStoreNodes.end())
+            return found->second;
+
+        const scopeRoute &route = this->getScopeRoute(parentDIE);
+        if (route.declFileIdx)
+        {
+            // 类外定义的函数内部的die存放在函数声明所在的文件
+            const std::string *specificationFile = this->getDeclFile(compileUnit, route.declFileIdx);
+            if (specificationFile)
+                declFile = specificationFile;
+        }
+        Json *out = &this->mOutputJson[*declFile];
+        for (auto &&it : route.path)
+        {
+            out = &(*out)[it];
+        }
+        this->mStoreNodes.emplace(key, out);
+        return out;
+    }
 
-        std::string declFile = dwarfUtils::simplifyPath(declFiles[declFileIdx - 1]);
-        if (!declFile.starts_with(this->mDeclFileFilter))
-            return {};
+    /**
+     * @brief 作用域到json节点的相对路径
+     *
+     * @return e.g. {"nmspc: mce", "nmspc: `anonymous``", "class: Foo", "struct: Bar"}
+     */
+    const scopeRoute &getScopeRoute(const dw::die *scopeDIE)
+    {
+        uint64_t scopeOffset = scopeDIE ? scopeDIE->getOffset() : UINT64_MAX;
+        if (auto found = this->mScopeRoutes.find(scopeOffset); found != this->mScopeRoutes.end())
+            return found->second;
 
-        std::vector<std::string> ret;
-        for (const dw::die *parentDIE = DIE.getParentDIE(); parentDIE; parentDIE = parentDIE->getParentDIE())
+        scopeRoute ret;
+        for (const dw::die *parentDIE = scopeDIE; parentDIE; parentDIE = parentDIE->getParentDIE())
         {
             uint16_t         tag = parentDIE->getTAG();
             std::string_view name = parentDIE->getName("`anonymous`");
             switch (tag)
             {
             case DW_TAG_namespace:
-                ret.emplace_back(std::format("namespace: {}", name));
+                ret.path.emplace_back(std::format("namespace: {}", name));
                 break;
             case DW_TAG_class_type:
-                ret.emplace_back(std::format("class: {}", name));
+                ret.path.emplace_back(std::format("class: {}", name));
                 break;
             case DW_TAG_structure_type:
-                ret.emplace_back(std::format("struct: {}", name));
+                ret.path.emplace_back(std::format("struct: {}", name));
                 break;
             case DW_TAG_union_type:
-                ret.emplace_back("content");
-                ret.emplace_back(std::format("union: {}", name));
+                ret.path.emplace_back("content");
+                ret.path.emplace_back(std::format("union: {}", name));
                 break;
             case DW_TAG_subprogram: {
                 const dw::attr *specificationAttr = parentDIE->findAttrByType(DW_AT_specification);
@@ -717,267 +1038,54 @@ private:
                     if (!specification)
                         break;
                     const dw::attr *decl_line = specification->findAttrByType(DW_AT_decl_line);
-                    ret.emplace_back("local_info");
-                    ret.emplace_back(std::format("{:05}-func: {}", decl_line ? decl_line->get<uint64_t>() : 0, specification->getName()));
+                    ret.path.emplace_back("local_info");
+                    ret.path.emplace_back(std::format("{:05}-func: {}", decl_line ? decl_line->get<uint64_t>() : 0, specification->getName()));
                     const dw::attr *attr = specification->findAttrByType(DW_AT_decl_file);
                     if (attr)
-                        declFileIdx = attr->getValueAsInt<uint64_t>();
-                    declFile = dwarfUtils::simplifyPath(declFiles[declFileIdx - 1]);
+                        ret.declFileIdx = attr->getValueAsInt<uint64_t>();
                     parentDIE = specification;
                 }
                 else
                 {
                     const dw::attr *decl_line = parentDIE->findAttrByType(DW_AT_decl_line);
-                    ret.emplace_back("local_info");
-                    ret.emplace_back(std::format("{:05}-func: {}", decl_line ? decl_line->get<uint64_t>() : 0, parentDIE->getName()));
+                    ret.path.emplace_back("local_info");
+                    ret.path.emplace_back(std::format("{:05}-func: {}", decl_line ? decl_line->get<uint64_t>() : 0, parentDIE->getName()));
                 }
                 break;
             }
             case DW_TAG_lexical_block: {
-                ret.emplace_back(std::format("{}-lexical_block", parentDIE->getOffset()));
-            }
-            case DW_TAG_compile_unit:
-                break;
-            }
-        }
-        ret.emplace_back(declFile);
-        std::reverse(ret.begin(), ret.end());
-        return ret;
-    }
-
-#pragma region getTypeInfo
-    /**
-     * @brief DW_AT_type的类型信息
-     *
-     * @param die 变量die或函数die
-     * @param varName 传入变量名或者占位符
-     * @return 格式化完毕的信息, e.g. `"volatile const int *{}[10][20]"`
-     */
-    std::string getTypeInfo(const dw::die &die, std::string_view varName = "{}", uint8_t *constOrVolatile = nullptr)
-    {
-        static TimerToken token;
-        Timer             timer{token};
-        const dw::attr   *typeAttr = die.findAttrByType(DW_AT_type);
-        if (!typeAttr)
-            return std::format("void {}", varName);
-
-        uint64_t    typeDIEoffset = typeAttr->get<uint64_t>();
-        bool        isConst = false, isVolatile = false;
-        std::string typeName{varName};
-        int8_t      readDirection = 1;
-        for (dw::die *typeDIE = this->mDbg.findDIEbyOffset(typeDIEoffset); typeDIE;)
-        {
-            uint16_t         tagId = typeDIE->getTAG();
-            std::string_view name = typeDIE->getName();
-            if (!name.empty())
-            {
-                typeName = std::format("{} {}", this->completeNameScope(*typeDIE), typeName);
-                break;
-            }
-            bool noVoidType = false;
-            switch (tagId)
-            {
-            case DW_TAG_const_type:
-                isConst = true;
-                break;
-            case DW_TAG_volatile_type:
-                isVolatile = true;
-                break;
-            case DW_TAG_pointer_type:
-                typeName = "*" + typeName;
-                readDirection = -1;
-                break;
-            case DW_TAG_reference_type:
-                typeName = "&" + typeName;
-                readDirection = -1;
-                break;
-            case DW_TAG_rvalue_reference_type:
-                typeName = "&&" + typeName;
-                readDirection = -1;
-                break;
-            case DW_TAG_restrict_type:
-                typeName = "__restrict " + typeName;
-                readDirection = -1;
-                break;
-            case DW_TAG_array_type:
-                if (readDirection == -1)
-                    typeName = std::format("({})", typeName);
-                for (auto &&child : typeDIE->getChildren(this->mDbg))
-                {
-                    if (child.getTAG() == DW_TAG_subrange_type)
-                    {
-                        const dw::attr *countAttr = child.findAttrByType(DW_AT_count);
-                        const dw::attr *countAttr2 = child.findAttrByType(DW_AT_upper_bound);
-                        if (countAttr)
-                        {
-                            typeName += std::format("[{}]", countAttr->get<uint64_t>());
-                        }
-                        else if (countAttr2)
-                        {
-                            typeName += std::format("[{}]", countAttr2->get<uint64_t>() + 1);
-                        }
-                        else
-                        {
-                            typeName += "[no_range]";
-                        }
-                    }
-                }
-                readDirection = 1;
-                break;
-            case DW_TAG_ptr_to_member_type:
-                this->parsePtrToMemberType(*typeDIE, typeName);
-                readDirection = -1;
-                break;
-            case DW_TAG_subroutine_type:
-                if (readDirection == -1)
-                    typeName = std::format("({})", typeName);
-                this->parseSubroutineType(*typeDIE, typeName);
-                readDirection = 1;
-                break;
-            case DW_TAG_union_type:
-                typeName = std::format("`anony_union_{}` {}", typeDIE->getOffset(), typeName);
-                noVoidType = true;
-                break;
-            case DW_TAG_class_type:
-                typeName = std::format("`anony_class_{}` {}", typeDIE->getOffset(), typeName);
-                noVoidType = true;
-                break;
-            case DW_TAG_structure_type:
-                typeName = std::format("`anony_struct_{}` {}", typeDIE->getOffset(), typeName);
-                noVoidType = true;
-                break;
-            case DW_TAG_enumeration_type:
-                typeName = std::format("`anony_enum_{}` {}", typeDIE->getOffset(), typeName);
-                noVoidType = true;
-                break;
-            }
-            const dw::attr *nextTypeAttr = typeDIE->findAttrByType(DW_AT_type);
-            if (!nextTypeAttr)
-            {
-                if (!noVoidType)
-                    typeName = "void " + std::move(typeName);
-                break;
+                ret.path.emplace_back(std::format("{}-lexical_block", parentDIE->getOffset()));
             }
-            typeDIE = this->mDbg.findDIEbyOffset(nextTypeAttr->get<uint64_t>());
-        }
-        if (constOrVolatile)
-            *constOrVolatile = isVolatile * 2 + isConst;
-        // (volatile) (const) (typename, with &&/&/*/__restrict/[array])
-        return std::format("{}{}{}", isVolatile ? "volatile " : "", isConst ? "const " : "", typeName);
-    }
-
-#pragma region completeNameScope
-    /**
-     * @brief 补全命名作用域
-     *
-     * @param die die
-     * @return e.g. `shared_ptr<int>` -> `std::shared_ptr<int>`
-     */
-    std::string completeNameScope(const dw::die &die)
-    {
-        static TimerToken token;
-        Timer             timer{token};
-        std::string       nameStr = std::format("{}", die.getName());
-        for (const dw::die *iterDie = die.getParentDIE(); iterDie; iterDie = iterDie->getParentDIE())
-        {
-            const uint16_t   tagId = iterDie->getTAG();
-            std::string_view name = iterDie->getName();
-            switch (tagId)
-            {
-            case DW_TAG_namespace:
-                if (nameStr.empty())
-                    nameStr = std::format("`anon_nmsp_{}`::{}", iterDie->getOffset(), nameStr);
-                break;
-            case DW_TAG_class_type:
-                if (nameStr.empty())
-                    nameStr = std::format("`anon_class_{}`::{}", iterDie->getOffset(), nameStr);
-                break;
-            case DW_TAG_structure_type:
-                if (nameStr.empty())
-                    nameStr = std::format("`anon_struct_{}`::{}", iterDie->getOffset(), nameStr);
-                break;
-            case DW_TAG_union_type:
-                if (nameStr.empty())
-                    nameStr = std::format("`anon_union_{}`::{}", iterDie->getOffset(), nameStr);
-                break;
-            case DW_TAG_enumeration_type:
-                if (nameStr.empty())
-                    nameStr = std::format("`anon_enum_{}`::{}", iterDie->getOffset(), nameStr);
-                break;
             case DW_TAG_compile_unit:
-                return nameStr;
-            default:
                 break;
             }
-            nameStr = std::format("{}::{}", name, nameStr);
         }
-        return std::string{die.getName()};
+        std::reverse(ret.path.begin(), ret.path.end());
+        return this->mScopeRoutes.emplace(scopeOffset, std::move(ret)).first->second;
     }
 
-#pragma region PtrToMember
     /**
-     * @brief 当类型信息出现指向成员函数或成员变量的指针时，由这个处理
+     * @brief 简化后的源文件路径, 每个CU的文件表只简化一次, 字符串全局唯一
      *
-     * @param ptrToMembDie
-     * @param retName 例：`varName` -> `StructA::*varName`
+     * @return nullptr 表示文件序号无效
      */
-    void parsePtrToMemberType(const dw::die &ptrToMembDie, std::string &typeName)
+    const std::string *getDeclFile(dw::CU &compileUnit, uint64_t declFileIdx)
     {
-        const dw::attr *containingType = ptrToMembDie.findAttrByType(DW_AT_containing_type);
-        if (!containingType)
-        {
-            typeName = "`err_type`::*" + typeName;
-            return;
-        }
-        uint64_t       ctTypeOffset = containingType->get<uint64_t>();
-        const dw::die *ctTypeDie = this->mDbg.findDIEbyOffset(ctTypeOffset);
-        if (!ctTypeDie)
-        {
-            typeName = std::format("`err_type_{}`::*{}", ctTypeOffset, typeName);
-            return;
-        }
-        typeName = std::format("{}::*{}", this->completeNameScope(*ctTypeDie), typeName);
+        const auto &declFiles = this->getDeclFiles(compileUnit);
+        if (declFileIdx == 0 || declFileIdx > declFiles.size())
+            return nullptr;
+        return declFiles[declFileIdx - 1];
     }
 
-#pragma region SubroutineType
-    /**
-     * @brief
-     *
-     * @param subroutineDie
-     * @param typeName e.g. `(StructA::*varName)` -> `(StructA::*varName)(int, int)`
-     */
-    void parseSubroutineType(const dw::die &subroutineDie, std::string &typeName)
+    const std::vector<const std::string *> &getDeclFiles(dw::CU &compileUnit)
     {
-        typeName += "(";
-        bool isConstFunction = false;
-        for (auto &&child : subroutineDie.getChildren(this->mDbg))
+        auto [it, inserted] = this->mCUDeclFiles.try_emplace(compileUnit.getOffset());
+        if (inserted)
         {
-            uint16_t tagId = child.getTAG();
-            switch (tagId)
-            {
-            case DW_TAG_formal_parameter:
-                if (child.findAttrByOffset(DW_AT_artificial))
-                {
-                    uint8_t isConst = 0;
-                    this->getTypeInfo(child, "this", &isConst);
-                    isConstFunction = isConst & 1;
-                }
-                else
-                {
-                    typeName = std::format("{}{}, ", typeName, this->getTypeInfo(child, ""));
-                }
-                break;
-            case DW_TAG_unspecified_parameters:
-                typeName += "..., ";
-                break;
-            }
+            memory::tag memTag{memory::category::srcFiles};
+            for (auto &&declFile : compileUnit.getSrcfiles(this->mDbg))
+                it->second.emplace_back(&*this->mDeclFiles.emplace(dwarfUtils::simplifyPath(declFile)).first);
         }
-        typeName.erase(typeName.length() - 2, 2);
-
-        bool isRef = subroutineDie.findAttrByOffset(DW_AT_reference) != nullptr;
-        bool isRvalueRef = subroutineDie.findAttrByOffset(DW_AT_rvalue_reference) != nullptr;
-
-        // {(StructA::*varName)(int, int}){ const}{ &/&&}
-        typeName = std::format("{}){}{}", typeName, isConstFunction ? " const" : "", isRef ? " &" : (isRvalueRef ? " &&" : ""));
+        return it->second;
     }
 };
\ No newline at end of file
@@ -0,0 +1,710 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <print>
+#include <set>
+#include <tuple>
+#include "typeModel.hpp"
+
+/**
+ * @brief 直接从die生成C++头文件, 每个声明所在的源文件对应一个头文件, 不经过json
+ */
+class headerEmitter
+{
+public:
+    /**
+     * @brief 命名空间/类/枚举的作用域节点. 同一作用域在多个CU中出现时合并, 相同的声明只保留一份
+     */
+    struct scopeNode
+    {
+        uint64_t                                            line = UINT64_MAX; // 用于和同级声明排序
+        std::string                                         open; // 作用域的开头一行
+        std::string                                         close;
+        std::set<std::tuple<uint64_t, size_t, std::string>> decls; // {decl_line, 数据成员的序号, 声明}
+        std::map<std::string, scopeNode>                    children; // key 通常就是开头一行, 匿名成员的开头相同, 用类型名区分
+        std::set<std::string>                               includes; // 只用于文件根节点, 其他源文件的头文件
+
+        void merge(scopeNode &&other)
+        {
+            this->line = std::min(this->line, other.line);
+            if (this->open.empty())
+                this->open = std::move(other.open);
+            if (this->close.empty())
+                this->close = std::move(other.close);
+            this->decls.merge(other.decls);
+            this->includes.merge(other.includes);
+            for (auto &&[open, child] : other.children)
+            {
+                auto [it, inserted] = this->children.try_emplace(open);
+                it->second.merge(std::move(child));
+            }
+        }
+    };
+
+    using fileMap = std::unordered_map<std::string, scopeNode>;
+
+private:
+    /**
+     * @brief 单个工作线程的收集器, 只访问自己的 dw::file
+     */
+    class collector
+    {
+        struct scopeStep
+        {
+            std::string open;
+            std::string close;
+        };
+
+        dw::file           &mDbg;
+        typeNamer           mNamer;
+        const declFilter   &mFilter;
+        declFilter::nsState mNsState; // 当前所在的命名空间
+        fileMap             mFiles;
+        std::string         mCurrentFile; // 正在收集的顶层实体所在的源文件
+
+    public:
+        collector(dw::file &dbg, const declFilter &filter) :
+            mDbg(dbg), mNamer(dbg, true), mFilter(filter), mNsState(filter.rootNamespace()) {}
+
+        /**
+         * @param childBegin, childEnd 只收集这一段顶层子die, 见 `dw::cuTask`
+         */
+        void collectCU(dw::CU &compileUnit, size_t childBegin = 0, size_t childEnd = SIZE_MAX)
+        {
+            trace::scope           cuTrace{"CU", [&] { return compileUnit.traceArgs(); }};
+            std::vector<scopeStep> path;
+            this->mNsState = this->mFilter.rootNamespace();
+            for (auto &&child : compileUnit.getChildRange(this->mDbg, childBegin, childEnd))
+                this->collectChild(compileUnit, child, path);
+        }
+
+        fileMap &getFiles() noexcept
+        {
+            return this->mFiles;
+        }
+
+    private:
+        static uint64_t declLine(const dw::die &DIE)
+        {
+            const dw::attr *attr = DIE.findAttrByType(DW_AT_decl_line);
+            return attr ? attr->getValueAsInt<uint64_t>() : 0;
+        }
+
+        static std::string_view accessPrefix(const dw::die &DIE, uint64_t defaultAccess)
+        {
+            const dw::attr *attr = DIE.findAttrByType(DW_AT_accessibility);
+            uint64_t        access = attr ? attr->getValueAsInt<uint64_t>() : defaultAccess;
+            if (access == defaultAccess)
+                return "";
+            switch (access)
+            {
+            case DW_ACCESS_public: return "public: ";
+            case DW_ACCESS_protected: return "protected: ";
+            case DW_ACCESS_private: return "private: ";
+            default: return "";
+            }
+        }
+
+        static scopeStep namespaceStep(std::string_view name)
+        {
+            if (name.empty())
+                return {"namespace {", "} // namespace"};
+            return {std::format("namespace {} {{", name), std::format("}} // namespace {}", name)};
+        }
+
+        /**
+         * @brief die的声明文件, 没有时返回空串
+         * @param compileUnit die所在的CU, 为空时沿父节点查找
+         */
+        std::string declFileOf(const dw::die &DIE, dw::CU *compileUnit = nullptr)
+        {
+            const dw::attr *declFileAttr = DIE.findAttrByType(DW_AT_decl_file);
+            if (!declFileAttr)
+                return "";
+            if (!compileUnit)
+            {
+                dw::die *iter = DIE.getParentDIE();
+                while (iter && !iter->isCompileUnit())
+                    iter = iter->getParentDIE();
+                if (!iter)
+                    return "";
+                compileUnit = static_cast<dw::CU *>(iter);
+            }
+            uint64_t                        declFileIdx = declFileAttr->getValueAsInt<uint64_t>();
+            const std::vector<std::string> &declFiles = compileUnit->getSrcfiles(this->mDbg);
+            if (declFileIdx == 0 || declFileIdx > declFiles.size())
+                return "";
+            return dwarfUtils::simplifyPath(declFiles[declFileIdx - 1]);
+        }
+
+        /**
+         * @brief 找到实体所在头文件中对应的命名空间节点, 不满足过滤条件时返回nullptr
+         */
+        scopeNode *findNode(dw::CU &compileUnit, const dw::die &DIE, const std::vector<scopeStep> &path)
+        {
+            std::string declFile = this->declFileOf(DIE, &compileUnit);
+            if (declFile.empty() || !this->mFilter.allowsPath(declFile))
+                return nullptr;
+
+            uint64_t   line = declLine(DIE);
+            this->mCurrentFile = declFile;
+            scopeNode *node = &this->mFiles[std::move(declFile)];
+            for (auto &&step : path)
+            {
+                node = &node->children[step.open];
+                node->open = step.open;
+                node->close = step.close;
+                node->line = std::min(node->line, line);
+            }
+            return node;
+        }
+
+        void collectNamespace(dw::CU &compileUnit, const dw::die &scope, std::vector<scopeStep> &path)
+        {
+            if (!scope.hasChild())
+                return;
+
+            for (auto &&child : scope.getChildren(this->mDbg))
+                this->collectChild(compileUnit, child, path);
+        }
+
+        void collectChild(dw::CU &compileUnit, const dw::die &child, std::vector<scopeStep> &path)
+        {
+            uint16_t         tag = child.getTAG();
+            std::string_view name = child.getName();
+            if (tag == DW_TAG_namespace)
+            {
+                declFilter::nsState outer = std::move(this->mNsState);
+                this->mNsState = this->mFilter.enterNamespace(outer, name);
+                if (!this->mFilter.prunesNamespace(this->mNsState))
+                {
+                    path.push_back(namespaceStep(name));
+                    this->collectNamespace(compileUnit, child, path);
+                    path.pop_back();
+                }
+                this->mNsState = std::move(outer);
+                return;
+            }
+
+            // 类外定义的成员函数/静态成员已经在类里声明过
+            if (child.findAttrByType(DW_AT_specification) || child.findAttrByType(DW_AT_abstract_origin))
+                return;
+            if (tag != DW_TAG_class_type && tag != DW_TAG_structure_type && tag != DW_TAG_union_type &&
+                tag != DW_TAG_enumeration_type && tag != DW_TAG_typedef &&
+                tag != DW_TAG_subprogram && tag != DW_TAG_variable)
+                return;
+            if (tag == DW_TAG_subprogram && child.findAttrByType(DW_AT_artificial))
+                return;
+            if (!this->mFilter.allowsEntity(this->mNsState, tag, name))
+                return;
+
+            scopeNode *node = this->findNode(compileUnit, child, path);
+            if (node)
+                this->collectEntity(child, *node, DW_ACCESS_public, "");
+        }
+
+        /**
+         * @param defaultAccess 所在作用域的默认访问权限
+         * @param className 所在类的名称, 用于识别构造/析构函数
+         * @param order 数据成员在所在类中的序号, 同一行声明的多个数据成员按原顺序输出
+         */
+        void collectEntity(const dw::die &DIE, scopeNode &node, uint64_t defaultAccess, std::string_view className, size_t order = 0)
+        {
+            uint64_t         line = declLine(DIE);
+            std::string_view name = DIE.getName();
+            switch (DIE.getTAG())
+            {
+            case DW_TAG_class_type:
+            case DW_TAG_structure_type:
+            case DW_TAG_union_type:
+                // 模板实例的前置声明需要主模板, 跳过
+                if (DIE.findAttrByType(DW_AT_declaration))
+                {
+                    if (!name.empty() && name.find('<') == std::string_view::npos)
+                        node.decls.emplace(line, 0, std::format("{}{} {};", accessPrefix(DIE, defaultAccess), keyword(DIE.getTAG()), name));
+                }
+                else
+                    this->collectClass(DIE, node, defaultAccess);
+                break;
+            case DW_TAG_enumeration_type:
+                this->collectEnum(DIE, node, defaultAccess);
+                break;
+            case DW_TAG_typedef:
+                this->requireType(DIE);
+                node.decls.emplace(line, 0, std::format("{}typedef {};", accessPrefix(DIE, defaultAccess), this->mNamer.getTypeInfo(DIE, name)));
+                break;
+            case DW_TAG_subprogram:
+                if (!DIE.findAttrByType(DW_AT_artificial))
+                    node.decls.emplace(line, 0, std::format("{}{};", accessPrefix(DIE, defaultAccess), this->prototype(DIE, className)));
+                break;
+            case DW_TAG_variable:
+                this->requireType(DIE);
+                node.decls.emplace(line, 0, std::format("{}{} {};", accessPrefix(DIE, defaultAccess),
+                                                     className.empty() ? "extern" : "static",
+                                                     this->mNamer.getTypeInfo(DIE, name)));
+                break;
+            case DW_TAG_member: {
+                if (DIE.findAttrByType(DW_AT_artificial))
+                    break;
+                this->requireType(DIE);
+                std::string     decl = this->mNamer.getTypeInfo(DIE, name);
+                const dw::attr *bitSize = DIE.findAttrByType(DW_AT_bit_size);
+                if (bitSize)
+                    decl += std::format(" : {}", bitSize->getValueAsInt<uint64_t>());
+                if (DIE.findAttrByType(DW_AT_declaration))
+                    decl = "static " + decl;
+                node.decls.emplace(line, order, std::format("{}{}; // offset {}", accessPrefix(DIE, defaultAccess), decl,
+                                                     typeCollector::memberOffset(DIE.findAttrByType(DW_AT_data_member_location))));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        static std::string_view keyword(uint16_t tag)
+        {
+            return tag == DW_TAG_class_type ? "class" : (tag == DW_TAG_union_type ? "union" : "struct");
+        }
+
+        /**
+         * @param anonymousMember 非空时类型是这个无名成员的匿名struct/union, 直接写在成员的位置
+         */
+        void collectClass(const dw::die &classDIE, scopeNode &parent, uint64_t defaultAccess, const dw::die *anonymousMember = nullptr)
+        {
+            uint16_t         tag = classDIE.getTAG();
+            std::string      anonymousName = classDIE.getName().empty() ? this->mNamer.cxxAnonymousName(classDIE) : "";
+            std::string_view name = anonymousName.empty() ? classDIE.getName() : anonymousName;
+            uint64_t         classAccess = tag == DW_TAG_class_type ? DW_ACCESS_private : DW_ACCESS_public;
+
+            std::string              bases;
+            std::vector<std::string> templateParams;
+            std::set<uint64_t>       inlineTypes; // 无名成员的匿名类型, 不再单独声明
+            for (auto &&child : classDIE.getChildren(this->mDbg))
+            {
+                switch (child.getTAG())
+                {
+                case DW_TAG_member:
+                    if (const dw::die *memberType = this->anonymousMemberType(child))
+                        inlineTypes.insert(memberType->getOffset());
+                    break;
+                case DW_TAG_inheritance: {
+                    const dw::attr *access = child.findAttrByType(DW_AT_accessibility);
+                    const dw::attr *virtuality = child.findAttrByType(DW_AT_virtuality);
+                    uint64_t        accessValue = access ? access->getValueAsInt<uint64_t>() : classAccess;
+                    this->requireType(child);
+                    bases += std::format("{}{}{} {}", bases.empty() ? " : " : ", ",
+                                         virtuality && virtuality->getValueAsInt<uint64_t>() ? "virtual " : "",
+                                         accessValue == DW_ACCESS_public ? "public" : (accessValue == DW_ACCESS_protected ? "protected" : "private"),
+                                         typeCollector::trimTypeName(this->mNamer.getTypeInfo(child, "")));
+                    break;
+                }
+                case DW_TAG_template_type_param:
+                    this->requireType(child);
+                    templateParams.emplace_back(std::format("typename {}", templateParamName(child, templateParams.size())));
+                    break;
+                case DW_TAG_template_value_param:
+                    this->requireType(child);
+                    templateParams.emplace_back(typeCollector::trimTypeName(
+                        this->mNamer.getTypeInfo(child, templateParamName(child, templateParams.size()))));
+                    break;
+                case DW_TAG_GNU_template_parameter_pack:
+                    templateParams.emplace_back(std::format("typename... {}", templateParamName(child, templateParams.size())));
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            // 模板实例的名字带有参数, 构造函数名只取 `<` 之前的部分
+            std::string_view shortName = name.substr(0, name.find('<'));
+            uint64_t         line = declLine(classDIE);
+
+            // 模板实例写成显式特化, 前面补一个只有声明的主模板
+            std::string open;
+            if (anonymousMember)
+                open = std::format("{}{} {{", accessPrefix(*anonymousMember, defaultAccess), keyword(tag));
+            else if (templateParams.empty() || shortName.size() == name.size())
+                open = std::format("{}{} {}{} {{", accessPrefix(classDIE, defaultAccess), keyword(tag), name, bases);
+            else
+            {
+                std::string params;
+                for (auto &&param : templateParams)
+                    params += params.empty() ? param : ", " + param;
+                // 同一行的作用域先于声明输出, 主模板的声明提前一行
+                parent.decls.emplace(std::max<uint64_t>(line, 1) - 1, 0,
+                                     std::format("{}template <{}> {} {};", accessPrefix(classDIE, defaultAccess), params, keyword(tag), shortName));
+                open = std::format("{}template <> {} {}{} {{", accessPrefix(classDIE, defaultAccess), keyword(tag), name, bases);
+            }
+            // 无名成员的开头都是 `union {`, 用生成的类型名区分
+            scopeNode &node = parent.children[anonymousMember ? std::string{name} : open];
+            node.open = std::move(open);
+            node.close = "};";
+            node.line = std::min(node.line, line);
+            if (const dw::attr *byteSize = classDIE.findAttrByType(DW_AT_byte_size))
+                node.decls.emplace(0, 0, std::format("// size {}", byteSize->getValueAsInt<uint64_t>()));
+
+            // 数据成员和基类决定对象布局, 不受过滤规则影响
+            size_t order = 0;
+            for (auto &&child : classDIE.getChildren(this->mDbg))
+            {
+                if (inlineTypes.contains(child.getOffset()))
+                    continue;
+                if (child.getTAG() != DW_TAG_member && !this->mFilter.allowsEntity(this->mNsState, child.getTAG(), child.getName(), true))
+                    continue;
+                if (const dw::die *memberType = this->anonymousMemberType(child))
+                    this->collectClass(*memberType, node, classAccess, &child);
+                else
+                    this->collectEntity(child, node, classAccess, shortName, child.getTAG() == DW_TAG_member ? order++ : 0);
+            }
+        }
+
+        /**
+         * @brief 无名成员 (匿名union/struct成员) 直接引用的匿名类型定义, 其他情况返回nullptr
+         */
+        const dw::die *anonymousMemberType(const dw::die &member)
+        {
+            if (member.getTAG() != DW_TAG_member || !member.getName().empty())
+                return nullptr;
+            const dw::attr *typeAttr = member.findAttrByType(DW_AT_type);
+            const dw::die  *typeDIE = typeAttr ? this->mDbg.findDIEbyOffset(typeAttr->get<uint64_t>()) : nullptr;
+            if (!typeDIE || !typeDIE->getName().empty() || typeDIE->findAttrByType(DW_AT_declaration))
+                return nullptr;
+            uint16_t tag = typeDIE->getTAG();
+            return tag == DW_TAG_structure_type || tag == DW_TAG_union_type || tag == DW_TAG_class_type ? typeDIE : nullptr;
+        }
+
+        /**
+         * @brief 模板参数名, 编译器省略时按位置补一个
+         */
+        static std::string templateParamName(const dw::die &param, size_t idx)
+        {
+            std::string_view name = param.getName();
+            return name.empty() ? std::format("T{}", idx) : std::string{name};
+        }
+
+        /**
+         * @brief 声明用到其他源文件中的具名类型时, 在当前头文件里补上依赖:
+         *        只经过指针/引用使用的命名空间级非模板类写前置声明, 其余 `#include` 该类型所在的头文件
+         */
+        void requireType(const dw::die &DIE)
+        {
+            bool indirect = false;
+            for (const dw::attr *typeAttr = DIE.findAttrByType(DW_AT_type); typeAttr;)
+            {
+                const dw::die *typeDIE = this->mDbg.findDIEbyOffset(typeAttr->get<uint64_t>());
+                if (!typeDIE)
+                    return;
+                switch (typeDIE->getTAG())
+                {
+                case DW_TAG_pointer_type:
+                case DW_TAG_reference_type:
+                case DW_TAG_rvalue_reference_type:
+                    indirect = true;
+                    break;
+                case DW_TAG_const_type:
+                case DW_TAG_volatile_type:
+                case DW_TAG_restrict_type:
+                case DW_TAG_array_type:
+                    break;
+                case DW_TAG_class_type:
+                case DW_TAG_structure_type:
+                case DW_TAG_union_type:
+                case DW_TAG_enumeration_type:
+                case DW_TAG_typedef:
+                    this->requireDecl(*typeDIE, indirect);
+                    return;
+                default:
+                    return;
+                }
+                typeAttr = typeDIE->findAttrByType(DW_AT_type);
+            }
+        }
+
+        void requireDecl(const dw::die &typeDIE, bool indirect)
+        {
+            std::string_view name = typeDIE.getName();
+            std::string      declFile = this->declFileOf(typeDIE);
+            if (name.empty() || declFile.empty() || declFile == this->mCurrentFile)
+                return;
+
+            // std 和保留命名空间中的类型不能由用户声明
+            uint16_t                      tag = typeDIE.getTAG();
+            bool                          forward = indirect && tag != DW_TAG_enumeration_type && tag != DW_TAG_typedef &&
+                                                    name.find('<') == std::string_view::npos;
+            std::vector<std::string_view> namespaces;
+            for (dw::die *scope = typeDIE.getParentDIE(); forward && scope && !scope->isCompileUnit(); scope = scope->getParentDIE())
+            {
+                std::string_view scopeName = scope->getName();
+                forward = scope->getTAG() == DW_TAG_namespace && scopeName != "std" && !scopeName.starts_with("__");
+                namespaces.emplace_back(scopeName);
+            }
+
+            scopeNode &root = this->mFiles[this->mCurrentFile];
+            if (!forward)
+            {
+                root.includes.insert(this->mFilter.allowsPath(declFile) ? headerPath(declFile) : declFile);
+                return;
+            }
+            // 前置声明放在文件开头单独的命名空间块里, 不影响原有命名空间块的位置
+            scopeNode *node = &root;
+            for (auto it = namespaces.rbegin(); it != namespaces.rend(); ++it)
+            {
+                scopeStep step = namespaceStep(*it);
+                step.open += " // forward declarations";
+                node = &node->children[step.open];
+                node->open = std::move(step.open);
+                node->close = std::move(step.close);
+                node->line = 0;
+            }
+            node->decls.emplace(0, 0, std::format("{} {};", keyword(tag), name));
+        }
+
+        void collectEnum(const dw::die &enumDIE, scopeNode &parent, uint64_t defaultAccess)
+        {
+            std::string underlying;
+            if (enumDIE.findAttrByType(DW_AT_type))
+                underlying = " : " + typeCollector::trimTypeName(this->mNamer.getTypeInfo(enumDIE, ""));
+
+            std::string_view name = enumDIE.getName();
+            std::string      open = std::format("{}enum {}{}{} {{", accessPrefix(enumDIE, defaultAccess),
+                                                enumDIE.findAttrByType(DW_AT_enum_class) ? "class " : "",
+                                                name.empty() ? this->mNamer.cxxAnonymousName(enumDIE) : name, underlying);
+            scopeNode       &node = parent.children[open];
+            node.open = open;
+            node.close = "};";
+            node.line = std::min(node.line, declLine(enumDIE));
+
+            // 枚举项没有行号, 用序号保持原有顺序
+            uint64_t idx = 0;
+            for (auto &&enumerator : enumDIE.getChildren(this->mDbg))
+            {
+                const dw::attr *enumVal = enumerator.findAttrByType(DW_AT_const_value);
+                if (enumerator.getTAG() != DW_TAG_enumerator || !enumVal)
+                    continue;
+                std::string value = enumVal->index() == dw::attr::sdata || enumVal->index() == dw::attr::sdata32
+                                        ? std::to_string(enumVal->getValueAsInt<int64_t>())
+                                        : std::to_string(enumVal->getValueAsInt<uint64_t>());
+                node.decls.emplace(idx++, 0, std::format("{} = {},", enumerator.getName(), value));
+            }
+        }
+
+        /**
+         * @brief 函数原型, e.g. `virtual const char *name(int a, ...) const = 0`
+         */
+        std::string prototype(const dw::die &funcDIE, std::string_view className)
+        {
+            std::string_view name = funcDIE.getName();
+            std::string      params;
+            std::string      templateParams;
+            bool             isConst = false, hasThis = false;
+            for (auto &&child : funcDIE.getChildren(this->mDbg))
+            {
+                std::string param;
+                switch (child.getTAG())
+                {
+                case DW_TAG_formal_parameter:
+                    if (child.findAttrByType(DW_AT_artificial))
+                    {
+                        uint8_t constOrVolatile = 0;
+                        this->mNamer.getTypeInfo(child, "this", &constOrVolatile);
+                        isConst = constOrVolatile & 1;
+                        hasThis = true;
+                        continue;
+                    }
+                    this->requireType(child);
+                    param = typeCollector::trimTypeName(this->mNamer.getTypeInfo(child, child.getName()));
+                    break;
+                case DW_TAG_unspecified_parameters:
+                    param = "...";
+                    break;
+                case DW_TAG_template_type_param:
+                    templateParams += std::format("{}{}", templateParams.empty() ? "" : ", ", child.getName());
+                    continue;
+                default:
+                    continue;
+                }
+                params += params.empty() ? param : ", " + param;
+            }
+
+            std::string signature = std::format("{}({}){}", name, params, isConst ? " const" : "");
+            if (funcDIE.findAttrByType(DW_AT_reference))
+                signature += " &";
+            else if (funcDIE.findAttrByType(DW_AT_rvalue_reference))
+                signature += " &&";
+
+            // 构造/析构/类型转换函数没有返回值
+            bool noReturnType = !funcDIE.findAttrByType(DW_AT_type) &&
+                                (name == className || name.starts_with("~"));
+            bool isConversion = name.starts_with("operator ") && name.size() > 9 && std::isalpha((unsigned char)name[9]);
+            std::string ret = noReturnType || isConversion ? signature : this->mNamer.getTypeInfo(funcDIE, signature);
+            this->requireType(funcDIE);
+
+            const dw::attr *virtuality = funcDIE.findAttrByType(DW_AT_virtuality);
+            const dw::attr *defaulted = funcDIE.findAttrByType(DW_AT_defaulted);
+            if (virtuality && virtuality->getValueAsInt<uint64_t>() != DW_VIRTUALITY_none)
+                ret = "virtual " + ret;
+            else if (!className.empty() && !hasThis)
+                ret = "static " + ret;
+            if (virtuality && virtuality->getValueAsInt<uint64_t>() == DW_VIRTUALITY_pure_virtual)
+                ret += " = 0";
+            if (funcDIE.findAttrByType(DW_AT_deleted))
+                ret += " = delete";
+            else if (defaulted && defaulted->getValueAsInt<uint64_t>() == 1)
+                ret += " = default";
+            // 函数模板实例只有实参, 写不出主模板的签名, 整个声明保留为注释
+            if (!templateParams.empty())
+                ret = std::format("// template <{}> {}", templateParams, ret);
+            return ret;
+        }
+    };
+
+    std::string mFilePath;
+    unsigned    mThreadCount;
+    fileMap     mFiles;
+
+public:
+    headerEmitter(std::string_view filePath, unsigned threadCount = 0) :
+        mFilePath(filePath), mThreadCount(threadCount) {}
+
+    /**
+     * @brief 并行遍历所有CU, 每个工作线程各自打开一个 dw::file, 最后合并各线程的结果.
+     *        调度方式见 `dw::schedule`
+     * @param filter 已经 compile 过的过滤规则, 类的数据成员和基类不受其影响
+     * @return -1 表示无法打开文件
+     */
+    int start(const declFilter &filter)
+    {
+        static TimerToken token;
+        Timer             timer{token};
+
+        dw::file mainFile{this->mFilePath};
+        if (!mainFile.isOpen())
+            return -1;
+
+        size_t                                  cuCount = mainFile.getCUs().size();
+        unsigned                                workers = dw::workerCount(this->mThreadCount, cuCount);
+        std::vector<std::unique_ptr<dw::file>>  files(workers);
+        std::vector<std::unique_ptr<collector>> collectors(workers);
+        dw::schedule("header", mainFile.planTasks(workers), workers, [&](unsigned workerIdx, const dw::cuTask &task) {
+            dw::file *dwFile = &mainFile;
+            if (workerIdx != 0)
+            {
+                if (!files[workerIdx])
+                    files[workerIdx] = std::make_unique<dw::file>(this->mFilePath);
+                dwFile = files[workerIdx].get();
+            }
+            if (!collectors[workerIdx])
+                collectors[workerIdx] = std::make_unique<collector>(*dwFile, filter);
+            if (!dwFile->isOpen() || task.cuIdx >= dwFile->getCUs().size())
+                return;
+
+            dw::CU &compileUnit = dwFile->getCUs()[task.cuIdx];
+            collectors[workerIdx]->collectCU(compileUnit, task.childBegin, task.childEnd);
+            compileUnit.clearCachedChildren();
+        });
+
+        trace::scope mergeTrace{"merge"};
+        for (auto &&worker : collectors)
+        {
+            if (!worker)
+                continue;
+            for (auto &&[declFile, root] : worker->getFiles())
+                this->mFiles[declFile].merge(std::move(root));
+        }
+        return 0;
+    }
+
+    /**
+     * @brief 每个源文件写一个头文件, 目录结构与源文件路径一致
+     * @return 写入失败的文件数
+     */
+    int dumpHeaders(const std::string &outDir)
+    {
+        static TimerToken token;
+        Timer             timer{token};
+        trace::scope      dumpTrace{"dump"};
+
+        std::vector<const std::pair<const std::string, scopeNode> *> items;
+        items.reserve(this->mFiles.size());
+        for (auto &&item : this->mFiles)
+            items.emplace_back(&item);
+
+        std::atomic<int> failed = 0;
+        dw::parallelFor(items.size(), dw::workerCount(this->mThreadCount, items.size()), [&](unsigned, size_t idx) {
+            auto &&[declFile, root] = *items[idx];
+            std::filesystem::path outPath = outDir;
+            outPath /= headerPath(declFile);
+
+            std::error_code ec;
+            std::filesystem::create_directories(outPath.parent_path(), ec);
+            std::ofstream out(outPath);
+            if (!out.is_open())
+            {
+                ++failed;
+                return;
+            }
+            out << "#pragma once\n// generated from " << declFile << "\n\n";
+            for (auto &&include : root.includes)
+                out << "#include \"" << include << "\"\n";
+            if (!root.includes.empty())
+                out << '\n';
+            writeScope(root, out, 0);
+        });
+        std::println("Headers output to {}", outDir);
+        return failed;
+    }
+
+private:
+    /**
+     * @brief `/src/foo.cpp` -> `src/foo.cpp.h`, 盘符中的 `:` 去掉
+     */
+    static std::string headerPath(std::string_view declFile)
+    {
+        std::string ret;
+        for (char c : declFile)
+        {
+            if (c != ':')
+                ret += c;
+        }
+        while (!ret.empty() && (ret.front() == '/' || ret.front() == '\\'))
+            ret.erase(0, 1);
+
+        std::string_view extension = dw::splitExtension(dw::splitPath(ret).second).second;
+        if (extension != "h" && extension != "hpp" && extension != "hh" && extension != "hxx" && extension != "inl")
+            ret += ".h";
+        return ret;
+    }
+
+    /**
+     * @brief 同级的声明和子作用域按行号交错输出, 同一行时先输出作用域, e.g. `struct { ... } halves;` 的类型在成员之前
+     */
+    static void writeScope(const scopeNode &node, std::ostream &out, int indent)
+    {
+        std::vector<const std::pair<const std::string, scopeNode> *> children;
+        children.reserve(node.children.size());
+        for (auto &&child : node.children)
+            children.emplace_back(&child);
+        std::stable_sort(children.begin(), children.end(), [](auto *a, auto *b) { return a->second.line < b->second.line; });
+
+        const std::string indentStr(indent, ' ');
+        auto              decl = node.decls.begin();
+        auto              child = children.begin();
+        while (decl != node.decls.end() || child != children.end())
+        {
+            if (child == children.end() || (decl != node.decls.end() && std::get<0>(*decl) < (*child)->second.line))
+            {
+                out << indentStr << std::get<2>(*decl) << '\n';
+                ++decl;
+                continue;
+            }
+            out << indentStr << (*child)->second.open << '\n';
+            writeScope((*child)->second, out, indent + 4);
+            out << indentStr << (*child)->second.close << "\n\n";
+            ++child;
+        }
+    }
+};
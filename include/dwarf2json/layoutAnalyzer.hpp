@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <print>
+#include "typeModel.hpp"
+
+/**
+ * @brief 类似pahole的结构体布局分析: 填充空洞, 跨缓存行的成员, 浪费的字节数,
+ *        建议的成员顺序, 以及与其他成员共享缓存行的锁/原子变量 (潜在的伪共享)
+ */
+class layoutAnalyzer
+{
+public:
+    static constexpr uint64_t cacheLineSize = 64;
+
+    struct finding
+    {
+        const typeRecord        *type = nullptr;
+        uint64_t                 wastedBytes = 0; // 空洞 + 尾部填充
+        uint64_t                 tailPadding = 0;
+        uint64_t                 packedSize = 0; // 按建议顺序重排后的大小, 0 表示没有建议
+        std::vector<std::string> suggestedOrder;
+        std::vector<std::string> notes; // 按成员顺序排列的注释行
+    };
+
+private:
+    std::string mFilePath;
+    unsigned    mThreadCount;
+
+    std::unordered_map<std::string, typeRecord> mTypes;
+    std::vector<finding>                         mFindings;
+
+public:
+    layoutAnalyzer(std::string_view filePath, unsigned threadCount = 0) :
+        mFilePath(filePath), mThreadCount(threadCount) {}
+
+    /**
+     * @brief 并行收集所有CU中的结构体定义并分析, 每个工作线程各自打开一个 dw::file,
+     *        大的CU先开始, 过大的CU按顶层子die拆开, 见 `dw::schedule`
+     * @param filter 已经 compile 过的过滤规则
+     * @return -1 表示无法打开文件
+     */
+    int start(const declFilter &filter)
+    {
+        static TimerToken token;
+        Timer             timer{token};
+
+        dw::file mainFile{this->mFilePath};
+        if (!mainFile.isOpen())
+            return -1;
+
+        size_t                                      cuCount = mainFile.getCUs().size();
+        unsigned                                    workers = dw::workerCount(this->mThreadCount, cuCount);
+        std::vector<std::unique_ptr<dw::file>>      files(workers);
+        std::vector<std::unique_ptr<typeCollector>> collectors(workers);
+        dw::schedule("layout", mainFile.planTasks(workers), workers, [&](unsigned workerIdx, const dw::cuTask &task) {
+            dw::file *dwFile = &mainFile;
+            if (workerIdx != 0)
+            {
+                if (!files[workerIdx])
+                    files[workerIdx] = std::make_unique<dw::file>(this->mFilePath);
+                dwFile = files[workerIdx].get();
+            }
+            if (!collectors[workerIdx])
+                collectors[workerIdx] = std::make_unique<typeCollector>(*dwFile, filter);
+            if (!dwFile->isOpen() || task.cuIdx >= dwFile->getCUs().size())
+                return;
+
+            dw::CU &compileUnit = dwFile->getCUs()[task.cuIdx];
+            collectors[workerIdx]->collectCU(compileUnit, task.childBegin, task.childEnd);
+            compileUnit.clearCachedChildren();
+        });
+
+        trace::scope analyzeTrace{"analyze"};
+        for (auto &&collector : collectors)
+        {
+            if (collector)
+                this->mTypes.merge(collector->getTypes());
+        }
+
+        std::vector<const typeRecord *> structs;
+        for (auto &&[name, record] : this->mTypes)
+        {
+            if (record.tag == DW_TAG_class_type || record.tag == DW_TAG_structure_type)
+                structs.emplace_back(&record);
+        }
+
+        std::vector<finding> findings(structs.size());
+        dw::parallelFor(structs.size(), dw::workerCount(this->mThreadCount, structs.size()),
+                        [&](unsigned, size_t idx) { findings[idx] = analyze(*structs[idx]); });
+
+        for (auto &&item : findings)
+        {
+            if (!item.notes.empty() || item.wastedBytes)
+                this->mFindings.emplace_back(std::move(item));
+        }
+        std::sort(this->mFindings.begin(), this->mFindings.end(), [](const finding &a, const finding &b) {
+            return a.wastedBytes != b.wastedBytes ? a.wastedBytes > b.wastedBytes : a.type->name < b.type->name;
+        });
+        return 0;
+    }
+
+    int dumpReport(const std::string &outPath = "layout.txt")
+    {
+        static TimerToken token;
+        Timer             timer{token};
+        trace::scope      dumpTrace{"dump"};
+        std::ofstream     file(outPath);
+        if (!file.is_open())
+            return -1;
+
+        uint64_t totalWasted = 0;
+        for (auto &&item : this->mFindings)
+        {
+            const typeRecord &type = *item.type;
+            totalWasted += item.wastedBytes;
+            std::println(file, "{} {} {{ /* {}:{} */", type.tag == DW_TAG_class_type ? "class" : "struct", type.name, type.declFile, type.declLine);
+            for (auto &&note : item.notes)
+                std::println(file, "    {}", note);
+            std::println(file, "    /* size: {}, cachelines: {}, align: {} */", type.byteSize,
+                         (type.byteSize + cacheLineSize - 1) / cacheLineSize, type.alignment);
+            std::println(file, "    /* wasted: {}, padding: {} */", item.wastedBytes, item.tailPadding);
+            if (item.packedSize)
+                std::println(file, "    /* suggested order ({} bytes, saves {}): {} */", item.packedSize,
+                             type.byteSize - item.packedSize, joinNames(item.suggestedOrder));
+            std::println(file, "}};\n");
+        }
+        std::println(file, "/* {} types reported, {} bytes wasted in total */", this->mFindings.size(), totalWasted);
+        std::println("File output to {}", outPath);
+        return 0;
+    }
+
+    const std::vector<finding> &getFindings() const noexcept
+    {
+        return this->mFindings;
+    }
+
+    static finding analyze(const typeRecord &type)
+    {
+        struct field
+        {
+            std::string_view name;
+            uint64_t         beginBit;
+            uint64_t         endBit;
+            bool             isBitField;
+            bool             isSync;
+        };
+
+        finding ret;
+        ret.type = &type;
+
+        std::vector<field> fields;
+        for (auto &&base : type.bases)
+        {
+            if (!base.isVirtual)
+                fields.push_back({base.type, base.offset * 8, (base.offset + base.byteSize) * 8, false, false});
+        }
+        for (auto &&member : type.members)
+        {
+            uint64_t beginBit = member.offset * 8 + member.bitOffset;
+            uint64_t endBit = member.bitSize ? beginBit + member.bitSize : beginBit + member.byteSize * 8;
+            fields.push_back({member.name, beginBit, endBit, member.bitSize != 0, member.isSync});
+        }
+        std::stable_sort(fields.begin(), fields.end(), [](const field &a, const field &b) { return a.beginBit < b.beginBit; });
+
+        // 空洞和跨缓存行
+        uint64_t cursorBit = 0;
+        for (auto &&item : fields)
+        {
+            if (item.beginBit > cursorBit)
+            {
+                uint64_t holeBits = item.beginBit - cursorBit;
+                if (holeBits >= 8)
+                {
+                    ret.wastedBytes += holeBits / 8;
+                    ret.notes.emplace_back(std::format("/* XXX {} bytes hole before {} */", holeBits / 8, item.name));
+                }
+                else
+                    ret.notes.emplace_back(std::format("/* XXX {} bits hole before {} */", holeBits, item.name));
+            }
+            cursorBit = std::max(cursorBit, item.endBit);
+
+            uint64_t byteSize = (item.endBit - item.beginBit + 7) / 8;
+            uint64_t offset = item.beginBit / 8;
+            if (!item.isBitField && byteSize > 0 && byteSize <= cacheLineSize &&
+                offset / cacheLineSize != (offset + byteSize - 1) / cacheLineSize)
+                ret.notes.emplace_back(std::format("/* {} ({} bytes at {}) straddles cache line {} */",
+                                                   item.name, byteSize, offset, (offset + byteSize - 1) / cacheLineSize));
+        }
+        uint64_t usedBytes = (cursorBit + 7) / 8;
+        if (type.byteSize > usedBytes)
+        {
+            ret.tailPadding = type.byteSize - usedBytes;
+            ret.wastedBytes += ret.tailPadding;
+        }
+
+        // 锁/原子变量与其他成员共享缓存行
+        for (auto &&sync : fields)
+        {
+            if (!sync.isSync)
+                continue;
+            uint64_t                      firstLine = sync.beginBit / 8 / cacheLineSize;
+            uint64_t                      lastLine = (std::max(sync.endBit, sync.beginBit + 1) - 1) / 8 / cacheLineSize;
+            std::vector<std::string_view> neighbours;
+            for (auto &&other : fields)
+            {
+                if (&other == &sync || other.endBit <= other.beginBit)
+                    continue;
+                uint64_t otherFirst = other.beginBit / 8 / cacheLineSize;
+                uint64_t otherLast = (other.endBit - 1) / 8 / cacheLineSize;
+                if (otherFirst <= lastLine && otherLast >= firstLine)
+                    neighbours.emplace_back(other.name);
+            }
+            if (!neighbours.empty())
+                ret.notes.emplace_back(std::format("/* false sharing: {} shares cache line {} with {} */",
+                                                   sync.name, firstLine, joinNames(neighbours)));
+        }
+
+        suggestOrder(type, ret);
+        return ret;
+    }
+
+private:
+    template <typename Names>
+    static std::string joinNames(const Names &names)
+    {
+        std::string ret;
+        for (auto &&name : names)
+        {
+            if (!ret.empty())
+                ret += ", ";
+            ret += name.empty() ? std::string_view{"`anonymous`"} : std::string_view{name};
+        }
+        return ret;
+    }
+
+    /**
+     * @brief 按对齐从大到小重排成员, 基类和虚表指针保持在前面. 含位域或虚基类的类型不给建议
+     */
+    static void suggestOrder(const typeRecord &type, finding &ret)
+    {
+        if (ret.wastedBytes == 0 || type.members.empty())
+            return;
+
+        uint64_t cursor = 0;
+        for (auto &&base : type.bases)
+        {
+            if (base.isVirtual)
+                return;
+            cursor = std::max(cursor, base.offset + base.byteSize);
+        }
+
+        std::vector<const typeRecord::member *> movable;
+        for (auto &&member : type.members)
+        {
+            if (member.bitSize)
+                return;
+            if (member.name.starts_with("_vptr"))
+                cursor = std::max(cursor, member.offset + member.byteSize);
+            else
+                movable.emplace_back(&member);
+        }
+        std::stable_sort(movable.begin(), movable.end(), [](const typeRecord::member *a, const typeRecord::member *b) {
+            return a->alignment != b->alignment ? a->alignment > b->alignment : a->byteSize > b->byteSize;
+        });
+
+        for (auto &&member : movable)
+        {
+            uint64_t align = std::max<uint64_t>(member->alignment, 1);
+            cursor = (cursor + align - 1) / align * align + member->byteSize;
+        }
+        uint64_t align = std::max<uint64_t>(type.alignment, 1);
+        uint64_t packedSize = std::max<uint64_t>((cursor + align - 1) / align * align, 1);
+        if (packedSize >= type.byteSize)
+            return;
+
+        ret.packedSize = packedSize;
+        for (auto &&member : movable)
+            ret.suggestedOrder.emplace_back(member->name);
+    }
+};
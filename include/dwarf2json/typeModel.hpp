@@ -0,0 +1,429 @@
+#pragma once
+#include <dwarfng/dwarfng.hpp>
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "dawrfInfoUtils.hpp"
+#include "declFilter.hpp"
+#include "typeNamer.hpp"
+
+/**
+ * @brief 一个类型定义的布局摘要, 只保留比较ABI需要的信息, 不依赖json
+ */
+struct typeRecord
+{
+    struct member
+    {
+        std::string name;
+        std::string type;
+        uint64_t    offset = 0;    // 字节偏移
+        uint64_t    bitSize = 0;   // 0 表示不是位域
+        uint64_t    bitOffset = 0; // 位域在所在字节内的偏移 (从最低位算起)
+        uint64_t    byteSize = 0;
+        uint64_t    alignment = 1;
+        bool        isSync = false; // 原子变量或锁, 见 typeCollector::isSyncType
+    };
+
+    struct base
+    {
+        std::string type;
+        uint64_t    offset = 0;
+        bool        isVirtual = false;
+        uint64_t    byteSize = 0;
+    };
+
+    struct virtualFunc
+    {
+        std::string name;
+        uint64_t    slot = 0;
+    };
+
+    struct enumerator
+    {
+        std::string name;
+        int64_t     value = 0;
+    };
+
+    std::string name; // 带命名空间的完整名称
+    std::string declFile;
+    uint64_t    declLine = 0;
+    uint16_t    tag = 0;
+    uint64_t    byteSize = 0;
+    uint64_t    alignment = 1;
+    uint64_t    hash = 0; // dw::file::typeHash
+
+    std::vector<member>      members;
+    std::vector<base>        bases;
+    std::vector<virtualFunc> vtable;
+    std::vector<enumerator>  enumerators;
+};
+
+/**
+ * @brief 遍历整个文件, 为每个具名的 class/struct/union/enum 定义生成一条 typeRecord,
+ *        同名的定义只保留第一次出现的
+ */
+class typeCollector
+{
+    dw::file           &mDbg;
+    typeNamer           mNamer;
+    const declFilter   &mFilter;
+    declFilter::nsState mNsState; // 当前所在的命名空间
+
+    std::unordered_map<std::string, typeRecord> mTypes;
+
+    // type die offset -> {byte size, alignment}
+    std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> mSizeAlign;
+
+public:
+    /**
+     * @param filter 已经 compile 过的过滤规则, 与 dwarf2json 相同: 按声明文件、命名空间和类型名筛选
+     */
+    typeCollector(dw::file &dbg, const declFilter &filter) :
+        mDbg(dbg), mNamer(dbg), mFilter(filter), mNsState(filter.rootNamespace()) {}
+
+    void collect()
+    {
+        for (auto &&compileUnit : this->mDbg.getCUs())
+        {
+            this->collectCU(compileUnit);
+            compileUnit.clearCachedChildren();
+        }
+    }
+
+    /**
+     * @param childBegin, childEnd 只收集这一段顶层子die, 用于拆分过大的CU, 见 `dw::cuTask`
+     */
+    void collectCU(dw::CU &compileUnit, size_t childBegin = 0, size_t childEnd = SIZE_MAX)
+    {
+        trace::scope    cuTrace{"CU", [&] { return compileUnit.traceArgs(); }};
+        memory::cuScope cuMemory{compileUnit.getName()};
+        this->mNsState = this->mFilter.rootNamespace();
+        for (auto &&child : compileUnit.getChildRange(this->mDbg, childBegin, childEnd))
+            this->collectEntry(compileUnit, child);
+    }
+
+    std::unordered_map<std::string, typeRecord> &getTypes() noexcept
+    {
+        return this->mTypes;
+    }
+
+    /**
+     * @brief DW_AT_data_member_location 可能是常量, 也可能是 `DW_OP_plus_uconst n` 表达式
+     */
+    static uint64_t memberOffset(const dw::attr *dataLoc)
+    {
+        if (!dataLoc)
+            return 0;
+        if (dataLoc->index() == dw::attr::exprloc)
+        {
+            dw::LocList locList = dataLoc->get<dw::LocList>();
+            return locList.empty() ? 0 : locList[0].opd1;
+        }
+        return dataLoc->getValueAsInt<uint64_t>();
+    }
+
+    /**
+     * @brief 去掉 getTypeInfo 在空变量名时留下的尾部空格
+     */
+    static std::string trimTypeName(std::string typeName)
+    {
+        while (!typeName.empty() && typeName.back() == ' ')
+            typeName.pop_back();
+        return typeName;
+    }
+
+    /**
+     * @brief 锁和原子变量: 去掉cv修饰和数组维度后, 最外层的模板名在 `syncTypeNames` 中.
+     *        指针和引用不算, e.g. `std::vector<std::mutex *>`, `std::mutex *` 都不是
+     */
+    static bool isSyncType(std::string_view typeName)
+    {
+        static constexpr std::string_view syncTypeNames[] = {
+            "std::atomic", "std::atomic_flag", "std::atomic_ref", "std::mutex", "std::recursive_mutex", "std::timed_mutex",
+            "std::recursive_timed_mutex", "std::shared_mutex", "std::shared_timed_mutex", "std::condition_variable",
+            "std::condition_variable_any", "std::counting_semaphore", "std::binary_semaphore", "std::latch", "std::barrier",
+            "std::once_flag", "pthread_mutex_t", "pthread_rwlock_t", "pthread_spinlock_t", "pthread_cond_t", "pthread_once_t"};
+
+        for (std::string_view qualifier : {"volatile ", "const "})
+        {
+            if (typeName.starts_with(qualifier))
+                typeName.remove_prefix(qualifier.size());
+        }
+        // 数组维度在最外层的 `<>` 之外, e.g. `std::atomic<int> [4]`
+        int depth = 0;
+        for (size_t idx = 0; idx < typeName.size(); idx++)
+        {
+            depth += typeName[idx] == '<' ? 1 : (typeName[idx] == '>' ? -1 : 0);
+            if (depth == 0 && typeName[idx] == '[')
+            {
+                typeName = typeName.substr(0, idx);
+                break;
+            }
+        }
+        while (typeName.ends_with(' '))
+            typeName.remove_suffix(1);
+        if (typeName.empty() || typeName.back() == '*' || typeName.back() == '&')
+            return false;
+
+        std::string name{typeName.substr(0, typeName.find('<'))};
+        while (name.ends_with(' '))
+            name.pop_back();
+        // 标准库的内联命名空间, e.g. `std::__1::mutex`, `std::__cxx11::`
+        if (name.starts_with("std::__"))
+        {
+            if (size_t sep = name.find("::", 5); sep != std::string::npos)
+                name.erase(5, sep + 2 - 5);
+        }
+        return std::find(std::begin(syncTypeNames), std::end(syncTypeNames), name) != std::end(syncTypeNames);
+    }
+
+    /**
+     * @brief 类型的大小和对齐, 沿 typedef/cv 修饰找到实际类型, 结果按die偏移缓存
+     * @return {byte size, alignment}, 找不到类型时为 {0, 1}
+     */
+    std::pair<uint64_t, uint64_t> sizeAndAlign(uint64_t typeOffset)
+    {
+        auto found = this->mSizeAlign.find(typeOffset);
+        if (found != this->mSizeAlign.end())
+            return found->second;
+
+        std::pair<uint64_t, uint64_t> ret{0, 1};
+        if (const dw::die *typeDIE = this->mDbg.findDIEbyOffset(typeOffset))
+            ret = this->computeSizeAndAlign(*typeDIE);
+        this->mSizeAlign.emplace(typeOffset, ret);
+        return ret;
+    }
+
+private:
+    static uint64_t naturalAlign(uint64_t size)
+    {
+        uint64_t align = 1;
+        while (align * 2 <= size && align < 16)
+            align *= 2;
+        return align;
+    }
+
+    std::pair<uint64_t, uint64_t> computeSizeAndAlign(const dw::die &typeDIE)
+    {
+        const dw::attr *byteSizeAttr = typeDIE.findAttrByType(DW_AT_byte_size);
+        const dw::attr *alignAttr = typeDIE.findAttrByType(DW_AT_alignment);
+        const dw::attr *nextType = typeDIE.findAttrByType(DW_AT_type);
+        uint64_t        size = byteSizeAttr ? byteSizeAttr->getValueAsInt<uint64_t>() : 0;
+        uint64_t        align = alignAttr ? alignAttr->getValueAsInt<uint64_t>() : 0;
+
+        switch (typeDIE.getTAG())
+        {
+        case DW_TAG_typedef:
+        case DW_TAG_const_type:
+        case DW_TAG_volatile_type:
+        case DW_TAG_restrict_type:
+        case DW_TAG_atomic_type: {
+            if (!nextType)
+                return {0, 1};
+            auto [nextSize, nextAlign] = this->sizeAndAlign(nextType->get<uint64_t>());
+            return {nextSize, align ? align : nextAlign};
+        }
+        case DW_TAG_pointer_type:
+        case DW_TAG_reference_type:
+        case DW_TAG_rvalue_reference_type:
+            size = size ? size : 8;
+            break;
+        case DW_TAG_ptr_to_member_type:
+            if (!size)
+            {
+                // 成员函数指针是 {函数地址, this调整}
+                const dw::die *pointee = nextType ? this->mDbg.findDIEbyOffset(nextType->get<uint64_t>()) : nullptr;
+                size = pointee && pointee->getTAG() == DW_TAG_subroutine_type ? 16 : 8;
+            }
+            break;
+        case DW_TAG_array_type: {
+            auto [elemSize, elemAlign] = nextType ? this->sizeAndAlign(nextType->get<uint64_t>()) : std::pair<uint64_t, uint64_t>{0, 1};
+            uint64_t count = 1;
+            for (auto &&subrange : typeDIE.getChildren(this->mDbg))
+            {
+                if (subrange.getTAG() != DW_TAG_subrange_type)
+                    continue;
+                const dw::attr *countAttr = subrange.findAttrByType(DW_AT_count);
+                const dw::attr *upperBound = subrange.findAttrByType(DW_AT_upper_bound);
+                if (countAttr)
+                    count *= countAttr->getValueAsInt<uint64_t>();
+                else if (upperBound)
+                    count *= upperBound->getValueAsInt<uint64_t>() + 1;
+                else
+                    count = 0;
+            }
+            return {size ? size : elemSize * count, align ? align : elemAlign};
+        }
+        case DW_TAG_class_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_union_type: {
+            if (align)
+                return {size, align};
+            align = 1;
+            for (auto &&child : typeDIE.getChildren(this->mDbg))
+            {
+                uint16_t tag = child.getTAG();
+                if ((tag != DW_TAG_member && tag != DW_TAG_inheritance) || child.findAttrByType(DW_AT_declaration))
+                    continue;
+                if (const dw::attr *memberType = child.findAttrByType(DW_AT_type))
+                    align = std::max(align, this->sizeAndAlign(memberType->get<uint64_t>()).second);
+            }
+            return {size, align};
+        }
+        case DW_TAG_subroutine_type:
+            return {0, 1};
+        default:
+            break;
+        }
+        return {size, align ? align : naturalAlign(size)};
+    }
+
+    void collectScope(dw::CU &compileUnit, const dw::die &scope)
+    {
+        if (!scope.hasChild())
+            return;
+
+        for (auto &&child : scope.getChildren(this->mDbg))
+            this->collectEntry(compileUnit, child);
+    }
+
+    void collectEntry(dw::CU &compileUnit, const dw::die &DIE)
+    {
+        switch (DIE.getTAG())
+        {
+        case DW_TAG_namespace: {
+            declFilter::nsState outer = std::move(this->mNsState);
+            this->mNsState = this->mFilter.enterNamespace(outer, DIE.getName());
+            if (!this->mFilter.prunesNamespace(this->mNsState))
+                this->collectScope(compileUnit, DIE);
+            this->mNsState = std::move(outer);
+            break;
+        }
+        case DW_TAG_class_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_union_type:
+        case DW_TAG_enumeration_type:
+            this->collectType(compileUnit, DIE);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /**
+     * @param nested 嵌套在另一个已收集的类型中, 只检查排除规则, 见 `declFilter::allowsEntity`
+     */
+    void collectType(dw::CU &compileUnit, const dw::die &typeDIE, bool nested = false)
+    {
+        if (typeDIE.getName().empty() || typeDIE.findAttrByType(DW_AT_declaration))
+            return;
+        if (!this->mFilter.allowsEntity(this->mNsState, typeDIE.getTAG(), typeDIE.getName(), nested))
+            return;
+
+        std::string name = this->mNamer.completeNameScope(typeDIE);
+        if (this->mTypes.contains(name))
+            return;
+
+        std::string     declFile;
+        const dw::attr *declFileAttr = typeDIE.findAttrByType(DW_AT_decl_file);
+        if (declFileAttr)
+        {
+            uint64_t                        declFileIdx = declFileAttr->getValueAsInt<uint64_t>();
+            const std::vector<std::string> &declFiles = compileUnit.getSrcfiles(this->mDbg);
+            if (declFileIdx > 0 && declFileIdx <= declFiles.size())
+                declFile = dwarfUtils::simplifyPath(declFiles[declFileIdx - 1]);
+        }
+        if (!this->mFilter.allowsPath(declFile))
+            return;
+
+        const dw::attr *declLine = typeDIE.findAttrByType(DW_AT_decl_line);
+        const dw::attr *byteSize = typeDIE.findAttrByType(DW_AT_byte_size);
+
+        typeRecord record;
+        record.name = name;
+        record.declFile = std::move(declFile);
+        record.declLine = declLine ? declLine->getValueAsInt<uint64_t>() : 0;
+        record.tag = typeDIE.getTAG();
+        record.byteSize = byteSize ? byteSize->getValueAsInt<uint64_t>() : 0;
+        record.alignment = this->computeSizeAndAlign(typeDIE).second;
+        record.hash = this->mDbg.typeHash(typeDIE);
+
+        std::vector<const dw::die *> nestedTypes;
+        for (auto &&child : typeDIE.getChildren(this->mDbg))
+        {
+            switch (child.getTAG())
+            {
+            case DW_TAG_member:
+            case DW_TAG_variable: {
+                // 静态成员不占用对象空间
+                if (child.getTAG() == DW_TAG_variable || child.findAttrByType(DW_AT_declaration))
+                    break;
+                typeRecord::member member;
+                const dw::attr    *memberType = child.findAttrByType(DW_AT_type);
+                const dw::attr    *bitSize = child.findAttrByType(DW_AT_bit_size);
+                const dw::attr    *dataBitOffset = child.findAttrByType(DW_AT_data_bit_offset);
+                const dw::attr    *bitOffset = child.findAttrByType(DW_AT_bit_offset);
+                member.name = child.getName();
+                member.type = trimTypeName(this->mNamer.getTypeInfo(child, ""));
+                member.offset = memberOffset(child.findAttrByType(DW_AT_data_member_location));
+                if (memberType)
+                    std::tie(member.byteSize, member.alignment) = this->sizeAndAlign(memberType->get<uint64_t>());
+                member.isSync = isSyncType(member.type);
+                if (bitSize)
+                    member.bitSize = bitSize->getValueAsInt<uint64_t>();
+                if (dataBitOffset)
+                {
+                    member.offset = dataBitOffset->getValueAsInt<uint64_t>() / 8;
+                    member.bitOffset = dataBitOffset->getValueAsInt<uint64_t>() % 8;
+                }
+                else if (bitOffset && bitSize)
+                {
+                    // DWARF2/3: DW_AT_bit_offset 从存储单元的最高位算起 (小端)
+                    const dw::attr *storageSize = child.findAttrByType(DW_AT_byte_size);
+                    uint64_t        storageBits = (storageSize ? storageSize->getValueAsInt<uint64_t>() : member.byteSize) * 8;
+                    uint64_t        bitStart = storageBits - bitOffset->getValueAsInt<uint64_t>() - member.bitSize;
+                    member.offset += bitStart / 8;
+                    member.bitOffset = bitStart % 8;
+                }
+                record.members.emplace_back(std::move(member));
+                break;
+            }
+            case DW_TAG_inheritance: {
+                const dw::attr *virtuality = child.findAttrByType(DW_AT_virtuality);
+                const dw::attr *baseType = child.findAttrByType(DW_AT_type);
+                record.bases.push_back({trimTypeName(this->mNamer.getTypeInfo(child, "")),
+                                        memberOffset(child.findAttrByType(DW_AT_data_member_location)),
+                                        virtuality && virtuality->getValueAsInt<uint64_t>() != 0,
+                                        baseType ? this->sizeAndAlign(baseType->get<uint64_t>()).first : 0});
+                break;
+            }
+            case DW_TAG_subprogram: {
+                const dw::attr *vtableLoc = child.findAttrByType(DW_AT_vtable_elem_location);
+                if (vtableLoc)
+                    record.vtable.push_back({std::string{child.getName()}, memberOffset(vtableLoc)});
+                break;
+            }
+            case DW_TAG_enumerator: {
+                const dw::attr *enumVal = child.findAttrByType(DW_AT_const_value);
+                if (enumVal)
+                    record.enumerators.push_back({std::string{child.getName()}, enumVal->getValueAsInt<int64_t>()});
+                break;
+            }
+            case DW_TAG_class_type:
+            case DW_TAG_structure_type:
+            case DW_TAG_union_type:
+            case DW_TAG_enumeration_type:
+                nestedTypes.emplace_back(&child);
+                break;
+            default:
+                break;
+            }
+        }
+        this->mTypes.emplace(std::move(name), std::move(record));
+
+        for (auto &&nested : nestedTypes)
+            this->collectType(compileUnit, *nested, true);
+    }
+};
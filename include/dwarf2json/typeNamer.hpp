@@ -0,0 +1,415 @@
+#pragma once
+#include <dwarfng/dwarfng.hpp>
+#include <format>
+#include <unordered_map>
+#include <Timer.hpp>
+
+/**
+ * @brief 把die的类型信息格式化成C++声明, dwarf2json和其他后端共用
+ */
+class typeNamer
+{
+    /**
+     * @brief 格式化后的类型以变量名为界分成前后两段, e.g. `const int (*` + name + `)[4]`
+     */
+    struct formattedType
+    {
+        std::string prefix;
+        std::string suffix;
+        uint8_t     constOrVolatile;
+    };
+
+    struct scopePrefix
+    {
+        std::string prefix;
+        bool        rooted; // 作用域链是否到达CU, 否则不加前缀
+    };
+
+    dw::file                                    &mDbg;
+    std::unordered_map<uint64_t, formattedType>  mTypeCache; // 类型die偏移 -> 格式化结果
+    std::unordered_map<uint64_t, scopePrefix>    mScopePrefixes; // 作用域die偏移 -> 限定前缀
+    bool                                         mCxxNames; // 生成可编译的名称, 匿名命名空间不出现在前缀中
+
+public:
+    // 格式化类型时读取的属性
+    using usedAttrs = dw::attrPack<DW_AT_name, DW_AT_type, DW_AT_count, DW_AT_upper_bound, DW_AT_containing_type,
+                                   DW_AT_artificial, DW_AT_reference, DW_AT_rvalue_reference, DW_AT_decl_file,
+                                   DW_AT_decl_line, DW_AT_decl_column, DW_AT_comp_dir>;
+
+    /**
+     * @param cxxNames 为true时省略匿名命名空间, 得到的名称可以直接写进头文件 (见 `headerEmitter`)
+     */
+    typeNamer(dw::file &dbg, bool cxxNames = false) :
+        mDbg(dbg), mCxxNames(cxxNames) {}
+
+#pragma region getTypeInfo
+    /**
+     * @brief DW_AT_type的类型信息
+     *
+     * @param die 变量die或函数die
+     * @param varName 传入变量名或者占位符
+     * @return 格式化完毕的信息, e.g. `"volatile const int *{}[10][20]"`
+     */
+    std::string getTypeInfo(const dw::die &die, std::string_view varName = "{}", uint8_t *constOrVolatile = nullptr)
+    {
+        static TimerToken token;
+        Timer             timer{token};
+        const dw::attr   *typeAttr = die.findAttrByType(DW_AT_type);
+        if (!typeAttr)
+            return std::format("void {}", varName);
+
+        uint64_t typeDIEoffset = typeAttr->get<uint64_t>();
+        auto     cached = this->mTypeCache.find(typeDIEoffset);
+        if (cached == this->mTypeCache.end())
+        {
+            // 用占位符格式化一次, 之后的调用只需拼接
+            constexpr std::string_view placeholder = "\x01";
+            uint8_t                    cv = 0;
+            std::string                formatted = this->formatTypeChain(typeDIEoffset, placeholder, cv);
+            size_t                     pos = formatted.find(placeholder);
+            if (pos == std::string::npos)
+            {
+                // 占位符被截断 (无参数的函数类型), 不缓存
+                if (constOrVolatile)
+                    *constOrVolatile = cv;
+                return this->formatTypeChain(typeDIEoffset, varName, cv);
+            }
+            cached = this->mTypeCache.emplace(typeDIEoffset, formattedType{formatted.substr(0, pos), formatted.substr(pos + placeholder.size()), cv}).first;
+        }
+        if (constOrVolatile)
+            *constOrVolatile = cached->second.constOrVolatile;
+
+        std::string ret;
+        ret.reserve(cached->second.prefix.size() + varName.size() + cached->second.suffix.size());
+        ret += cached->second.prefix;
+        ret += varName;
+        ret += cached->second.suffix;
+        return ret;
+    }
+
+private:
+    /**
+     * @brief 沿DW_AT_type链格式化类型
+     */
+    std::string formatTypeChain(uint64_t typeDIEoffset, std::string_view varName, uint8_t &constOrVolatile)
+    {
+        bool        isConst = false, isVolatile = false;
+        std::string typeName{varName};
+        int8_t      readDirection = 1;
+        for (dw::die *typeDIE = this->mDbg.findDIEbyOffset(typeDIEoffset); typeDIE;)
+        {
+            uint16_t         tagId = typeDIE->getTAG();
+            std::string_view name = typeDIE->getName();
+            if (!name.empty())
+            {
+                typeName = std::format("{} {}", this->completeNameScope(*typeDIE), typeName);
+                break;
+            }
+            bool noVoidType = false;
+            switch (tagId)
+            {
+            case DW_TAG_const_type:
+                isConst = true;
+                break;
+            case DW_TAG_volatile_type:
+                isVolatile = true;
+                break;
+            case DW_TAG_pointer_type:
+                typeName = "*" + typeName;
+                readDirection = -1;
+                break;
+            case DW_TAG_reference_type:
+                typeName = "&" + typeName;
+                readDirection = -1;
+                break;
+            case DW_TAG_rvalue_reference_type:
+                typeName = "&&" + typeName;
+                readDirection = -1;
+                break;
+            case DW_TAG_restrict_type:
+                typeName = "__restrict " + typeName;
+                readDirection = -1;
+                break;
+            case DW_TAG_array_type:
+                if (readDirection == -1)
+                    typeName = std::format("({})", typeName);
+                for (auto &&child : typeDIE->getChildren(this->mDbg))
+                {
+                    if (child.getTAG() == DW_TAG_subrange_type)
+                    {
+                        const dw::attr *countAttr = child.findAttrByType(DW_AT_count);
+                        const dw::attr *countAttr2 = child.findAttrByType(DW_AT_upper_bound);
+                        if (countAttr)
+                        {
+                            typeName += std::format("[{}]", countAttr->get<uint64_t>());
+                        }
+                        else if (countAttr2)
+                        {
+                            typeName += std::format("[{}]", countAttr2->get<uint64_t>() + 1);
+                        }
+                        else
+                        {
+                            typeName += "[no_range]";
+                        }
+                    }
+                }
+                readDirection = 1;
+                break;
+            case DW_TAG_ptr_to_member_type:
+                this->parsePtrToMemberType(*typeDIE, typeName);
+                readDirection = -1;
+                break;
+            case DW_TAG_subroutine_type:
+                if (readDirection == -1)
+                    typeName = std::format("({})", typeName);
+                this->parseSubroutineType(*typeDIE, typeName);
+                readDirection = 1;
+                break;
+            case DW_TAG_union_type:
+                typeName = std::format("{} {}", this->anonymousTypeName(*typeDIE, "union"), typeName);
+                noVoidType = true;
+                break;
+            case DW_TAG_class_type:
+                typeName = std::format("{} {}", this->anonymousTypeName(*typeDIE, "class"), typeName);
+                noVoidType = true;
+                break;
+            case DW_TAG_structure_type:
+                typeName = std::format("{} {}", this->anonymousTypeName(*typeDIE, "struct"), typeName);
+                noVoidType = true;
+                break;
+            case DW_TAG_enumeration_type:
+                typeName = std::format("{} {}", this->anonymousTypeName(*typeDIE, "enum"), typeName);
+                noVoidType = true;
+                break;
+            }
+            const dw::attr *nextTypeAttr = typeDIE->findAttrByType(DW_AT_type);
+            if (!nextTypeAttr)
+            {
+                if (!noVoidType)
+                    typeName = "void " + std::move(typeName);
+                break;
+            }
+            typeDIE = this->mDbg.findDIEbyOffset(nextTypeAttr->get<uint64_t>());
+        }
+        constOrVolatile = isVolatile * 2 + isConst;
+        // (volatile) (const) (typename, with &&/&/*/__restrict/[array])
+        return std::format("{}{}{}", isVolatile ? "volatile " : "", isConst ? "const " : "", typeName);
+    }
+
+public:
+
+#pragma region completeNameScope
+    /**
+     * @brief 补全命名作用域
+     *
+     * @param die die
+     * @return e.g. `shared_ptr<int>` -> `std::shared_ptr<int>`
+     */
+    std::string completeNameScope(const dw::die &die)
+    {
+        static TimerToken  token;
+        Timer              timer{token};
+        const scopePrefix &scope = this->getScopePrefix(die.getParentDIE());
+        if (!scope.rooted)
+            return std::string{die.getName()};
+        std::string ret;
+        ret.reserve(scope.prefix.size() + die.getName().size());
+        ret += scope.prefix;
+        ret += die.getName();
+        return ret;
+    }
+
+    /**
+     * @brief 匿名类型在生成的头文件中使用的标识符, 按声明位置命名, 同一类型在各个CU中得到同一个名字:
+     *        e.g. `anon_struct_12_5` (行_列), 没有列号时用同一行上同类匿名类型的序号, e.g. `anon_union_12_n1`
+     */
+    std::string cxxAnonymousName(const dw::die &DIE)
+    {
+        uint16_t         tag = DIE.getTAG();
+        std::string_view kind = tag == DW_TAG_class_type ? "class" : (tag == DW_TAG_union_type ? "union" : (tag == DW_TAG_enumeration_type ? "enum" : "struct"));
+        const dw::attr  *declLine = DIE.findAttrByType(DW_AT_decl_line);
+        uint64_t         line = declLine ? declLine->getValueAsInt<uint64_t>() : 0;
+        if (const dw::attr *declColumn = DIE.findAttrByType(DW_AT_decl_column))
+            return std::format("anon_{}_{}_{}", kind, line, declColumn->getValueAsInt<uint64_t>());
+        if (!DIE.getParentDIE())
+            return std::format("anon_{}_{}", kind, line);
+
+        size_t   ordinal = 0;
+        dw::die *parent = DIE.getParentDIE();
+        for (auto &&sibling : parent->getChildren(this->mDbg))
+        {
+            if (sibling.getOffset() == DIE.getOffset())
+                break;
+            const dw::attr *siblingLine = sibling.findAttrByType(DW_AT_decl_line);
+            if (sibling.getTAG() == tag && sibling.getName().empty() && (siblingLine ? siblingLine->getValueAsInt<uint64_t>() : 0) == line)
+                ++ordinal;
+        }
+        return std::format("anon_{}_{}_n{}", kind, line, ordinal);
+    }
+
+private:
+    /**
+     * @brief 匿名命名空间和匿名类型的名称. 尽量不含die偏移, 重新编译后保持不变, 以便按名称比较两次构建 (`--diff`):
+     *        命名空间按所在CU的完整路径区分, e.g. `anon_namespace@/src/a/util.cpp`;
+     *        类型按完整的声明位置 (文件:行:列) 区分, e.g. `anon_struct@/src/a.hpp:12:5`,
+     *        没有列号时追加die偏移, e.g. `anon_struct@/src/a.hpp:12#0x1a4`
+     */
+    std::string anonymousName(const dw::die &DIE, std::string_view kind)
+    {
+        dw::die *iter = DIE.getParentDIE();
+        while (iter && !iter->isCompileUnit())
+            iter = iter->getParentDIE();
+        auto *compileUnit = static_cast<dw::CU *>(iter);
+
+        const dw::attr *declFile = DIE.findAttrByType(DW_AT_decl_file);
+        const dw::attr *declLine = DIE.findAttrByType(DW_AT_decl_line);
+        if (kind != "namespace" && compileUnit && declFile && declLine)
+        {
+            uint64_t                        declFileIdx = declFile->getValueAsInt<uint64_t>();
+            const std::vector<std::string> &declFiles = compileUnit->getSrcfiles(this->mDbg);
+            if (declFileIdx > 0 && declFileIdx <= declFiles.size())
+            {
+                std::string ret = std::format("anon_{}@{}:{}", kind, declFiles[declFileIdx - 1], declLine->getValueAsInt<uint64_t>());
+                if (const dw::attr *declColumn = DIE.findAttrByType(DW_AT_decl_column))
+                    return std::format("{}:{}", ret, declColumn->getValueAsInt<uint64_t>());
+                return std::format("{}#{:#x}", ret, DIE.getOffset());
+            }
+        }
+        if (kind != "namespace")
+            return std::format("anon_{}#{:#x}", kind, DIE.getOffset());
+        if (!compileUnit)
+            return std::format("anon_{}", kind);
+
+        std::string_view cuName = compileUnit->getName();
+        const dw::attr  *compDir = compileUnit->findAttrByType(DW_AT_comp_dir);
+        if (cuName.starts_with('/') || !compDir)
+            return std::format("anon_{}@{}", kind, cuName);
+        return std::format("anon_{}@{}/{}", kind, compDir->get<std::string_view>(), cuName);
+    }
+
+    /**
+     * @brief 类型链中匿名类型的写法: 生成头文件时是带作用域前缀的标识符, 否则是带反引号的描述名
+     */
+    std::string anonymousTypeName(const dw::die &DIE, std::string_view kind)
+    {
+        if (!this->mCxxNames)
+            return std::format("`{}`", this->anonymousName(DIE, kind));
+        return this->getScopePrefix(DIE.getParentDIE()).prefix + this->cxxAnonymousName(DIE);
+    }
+
+    /**
+     * @brief 作用域的限定前缀, e.g. `std::chrono::`
+     *
+     * @param scope 作用域die, 为空时返回不以CU为根的空前缀
+     */
+    const scopePrefix &getScopePrefix(const dw::die *scope)
+    {
+        static const scopePrefix unrooted{"", false};
+        if (!scope)
+            return unrooted;
+        if (auto found = this->mScopePrefixes.find(scope->getOffset()); found != this->mScopePrefixes.end())
+            return found->second;
+
+        scopePrefix      ret{"", true};
+        uint16_t         tagId = scope->getTAG();
+        std::string_view name = scope->getName();
+        if (tagId != DW_TAG_compile_unit)
+        {
+            const scopePrefix &parent = this->getScopePrefix(scope->getParentDIE());
+            ret.rooted = parent.rooted;
+            ret.prefix = parent.prefix;
+            switch (name.empty() ? tagId : 0)
+            {
+            case DW_TAG_namespace:
+                if (!this->mCxxNames)
+                    ret.prefix += std::format("`{}`::", this->anonymousName(*scope, "namespace"));
+                break;
+            case DW_TAG_class_type:
+                ret.prefix += std::format("{}::", this->mCxxNames ? this->cxxAnonymousName(*scope) : std::format("`{}`", this->anonymousName(*scope, "class")));
+                break;
+            case DW_TAG_structure_type:
+                ret.prefix += std::format("{}::", this->mCxxNames ? this->cxxAnonymousName(*scope) : std::format("`{}`", this->anonymousName(*scope, "struct")));
+                break;
+            case DW_TAG_union_type:
+                ret.prefix += std::format("{}::", this->mCxxNames ? this->cxxAnonymousName(*scope) : std::format("`{}`", this->anonymousName(*scope, "union")));
+                break;
+            case DW_TAG_enumeration_type:
+                ret.prefix += std::format("{}::", this->mCxxNames ? this->cxxAnonymousName(*scope) : std::format("`{}`", this->anonymousName(*scope, "enum")));
+                break;
+            default:
+                ret.prefix += name;
+                ret.prefix += "::";
+                break;
+            }
+        }
+        return this->mScopePrefixes.emplace(scope->getOffset(), std::move(ret)).first->second;
+    }
+
+public:
+#pragma region PtrToMember
+    /**
+     * @brief 当类型信息出现指向成员函数或成员变量的指针时，由这个处理
+     *
+     * @param ptrToMembDie
+     * @param retName 例：`varName` -> `StructA::*varName`
+     */
+    void parsePtrToMemberType(const dw::die &ptrToMembDie, std::string &typeName)
+    {
+        const dw::attr *containingType = ptrToMembDie.findAttrByType(DW_AT_containing_type);
+        if (!containingType)
+        {
+            typeName = "`err_type`::*" + typeName;
+            return;
+        }
+        uint64_t       ctTypeOffset = containingType->get<uint64_t>();
+        const dw::die *ctTypeDie = this->mDbg.findDIEbyOffset(ctTypeOffset);
+        if (!ctTypeDie)
+        {
+            typeName = std::format("`err_type_{}`::*{}", ctTypeOffset, typeName);
+            return;
+        }
+        typeName = std::format("{}::*{}", this->completeNameScope(*ctTypeDie), typeName);
+    }
+
+#pragma region SubroutineType
+    /**
+     * @brief
+     *
+     * @param subroutineDie
+     * @param typeName e.g. `(StructA::*varName)` -> `(StructA::*varName)(int, int)`
+     */
+    void parseSubroutineType(const dw::die &subroutineDie, std::string &typeName)
+    {
+        typeName += "(";
+        bool isConstFunction = false;
+        for (auto &&child : subroutineDie.getChildren(this->mDbg))
+        {
+            uint16_t tagId = child.getTAG();
+            switch (tagId)
+            {
+            case DW_TAG_formal_parameter:
+                if (child.findAttrByOffset(DW_AT_artificial))
+                {
+                    uint8_t isConst = 0;
+                    this->getTypeInfo(child, "this", &isConst);
+                    isConstFunction = isConst & 1;
+                }
+                else
+                {
+                    typeName = std::format("{}{}, ", typeName, this->getTypeInfo(child, ""));
+                }
+                break;
+            case DW_TAG_unspecified_parameters:
+                typeName += "..., ";
+                break;
+            }
+        }
+        typeName.erase(typeName.length() - 2, 2);
+
+        bool isRef = subroutineDie.findAttrByOffset(DW_AT_reference) != nullptr;
+        bool isRvalueRef = subroutineDie.findAttrByOffset(DW_AT_rvalue_reference) != nullptr;
+
+        // {(StructA::*varName)(int, int}){ const}{ &/&&}
+        typeName = std::format("{}){}{}", typeName, isConstFunction ? " const" : "", isRef ? " &" : (isRvalueRef ? " &&" : ""));
+    }
+};
@@ -6,8 +6,10 @@
 #include <libdwarf/dwarf.h>
 #include <libdwarf/libdwarf.h>
 #include <cstdint>
+#include <limits>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <type_traits>
 #include "loc.hpp"
 
 namespace dw
@@ -15,20 +17,45 @@ namespace dw
     class attr
     {
     public:
-        typedef std::variant<std::string_view, uint64_t, uint32_t, int64_t, int32_t, dw::LocList> value;
+        // what the value holds, numbered like the alternatives of the former std::variant
+        enum kind : uint8_t
+        {
+            string = 0, // DW_FORM_str*
+            udata = 1,  // refs, addresses, unsigned constants, 8 byte blocks
+            udata32 = 2, // 4 byte blocks
+            sdata = 3,  // signed constants
+            sdata32 = 4, // flags
+            exprloc = 5, // DW_FORM_exprloc, see `dw::exprArena`
+            none = 6,
+        };
 
     private:
-        uint64_t mOffset = 0;
-        uint16_t mType;
-        uint16_t mForm;
-        value    mValue;
+        // string: data + length; exprloc: first op + op count; numbers: mBits only
+        const void *mData = nullptr;
+        uint64_t    mBits = 0;
+        uint64_t    mOffset = 0;
+        uint16_t    mType;
+        uint16_t    mForm;
+        kind        mKind = none;
 
     public:
-        attr(uint64_t offset, value attrValue, Dwarf_Half attrType, Dwarf_Half attrForm) :
-            mOffset(offset), mValue(attrValue), mType(attrType), mForm(attrForm) {}
-
         attr(uint64_t offset, std::string_view attrValue, Dwarf_Half attrType, Dwarf_Half attrForm) :
-            mOffset(offset), mValue(attrValue), mType(attrType), mForm(attrForm) {}
+            mData(attrValue.data()), mBits(attrValue.size()), mOffset(offset), mType(attrType), mForm(attrForm), mKind(string) {}
+
+        attr(uint64_t offset, dw::LocList attrValue, Dwarf_Half attrType, Dwarf_Half attrForm) :
+            mData(attrValue.data()), mBits(attrValue.size()), mOffset(offset), mType(attrType), mForm(attrForm), mKind(exprloc) {}
+
+        template <typename NumberType>
+            requires(std::is_integral_v<NumberType>)
+        attr(uint64_t offset, NumberType attrValue, Dwarf_Half attrType, Dwarf_Half attrForm) :
+            mBits(static_cast<uint64_t>(static_cast<std::conditional_t<std::is_signed_v<NumberType>, int64_t, uint64_t>>(attrValue))),
+            mOffset(offset), mType(attrType), mForm(attrForm)
+        {
+            if constexpr (std::is_signed_v<NumberType>)
+                this->mKind = sizeof(NumberType) > 4 ? sdata : sdata32;
+            else
+                this->mKind = sizeof(NumberType) > 4 ? udata : udata32;
+        }
 
         uint64_t getOffset() const
         {
@@ -68,80 +95,57 @@ namespace dw
 
         constexpr std::size_t index() const noexcept
         {
-            return this->mValue.index();
+            return this->mKind;
         }
 
-        template <typename RET>
-        constexpr decltype(auto) get() const noexcept
+        bool isInteger() const noexcept
         {
-            return std::get<RET>(this->mValue);
+            return this->mKind >= udata && this->mKind <= sdata32;
         }
 
-        const value &getValue() const
+        /**
+         * @brief never throws: a string or an expression of the wrong kind is empty,
+         *        any integer kind converts to the requested integer type
+         */
+        template <typename RET>
+        RET get() const noexcept
         {
-            return this->mValue;
+            if constexpr (std::is_same_v<RET, std::string_view>)
+                return this->mKind == string ? std::string_view{static_cast<const char *>(this->mData), this->mBits} : std::string_view{};
+            else if constexpr (std::is_same_v<RET, dw::LocList>)
+                return this->mKind == exprloc ? dw::LocList{static_cast<const LocationOp *>(this->mData), this->mBits} : dw::LocList{};
+            else
+                return this->getValueAsInt<RET>();
         }
 
         std::string getValueAsString() const
         {
-            return std::visit(
-                [](const auto &var) -> std::string {
-                    if constexpr (std::is_same_v<std::decay_t<decltype(var)>, std::string_view>)
-                    {
-                        return std::string{var};
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, uint64_t>)
-                    {
-                        return std::to_string(var);
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, uint32_t>)
-                    {
-                        return std::to_string(var);
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, int64_t>)
-                    {
-                        return std::to_string(var);
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, int32_t>)
-                    {
-                        return std::to_string(var);
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, LocList>)
-                    {
-                        return var[0].toString();
-                    }
-                },
-                this->mValue);
+            switch (this->mKind)
+            {
+            case string:
+                return std::string{this->get<std::string_view>()};
+            case udata:
+            case udata32:
+                return std::to_string(this->mBits);
+            case sdata:
+            case sdata32:
+                return std::to_string(static_cast<int64_t>(this->mBits));
+            case exprloc:
+                return this->mBits ? this->get<dw::LocList>()[0].toString() : "";
+            default:
+                return "";
+            }
         }
 
         template <typename NumberType>
             requires(std::is_integral_v<NumberType>)
-        NumberType getValueAsInt() const
-        {
-            return std::visit(
-                [](const auto &var) -> NumberType {
-                    if constexpr (std::is_same_v<std::decay_t<decltype(var)>, uint64_t>)
-                    {
-                        return var;
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, uint32_t>)
-                    {
-                        return var;
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, int64_t>)
-                    {
-                        return var;
-                    }
-                    else if constexpr (std::is_same_v<std::decay_t<decltype(var)>, int32_t>)
-                    {
-                        return var;
-                    }
-                    else
-                    {
-                        return std::numeric_limits<uint64_t>::max();
-                    }
-                },
-                this->mValue);
+        NumberType getValueAsInt() const noexcept
+        {
+            if (!this->isInteger())
+                return static_cast<NumberType>(std::numeric_limits<uint64_t>::max());
+            if (this->mKind == sdata || this->mKind == sdata32)
+                return static_cast<NumberType>(static_cast<int64_t>(this->mBits));
+            return static_cast<NumberType>(this->mBits);
         }
 
         bool operator==(const attr rhs) const
@@ -165,4 +169,6 @@ namespace dw
         }
     };
 
+    static_assert(sizeof(dw::attr) == 32, "dw::attr should stay 16 bytes of value plus 16 bytes of header");
+
 } // namespace dw
\ No newline at end of file
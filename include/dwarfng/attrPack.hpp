@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "attr.hpp"
+
+namespace dw
+{
+    // one bit per DW_AT_xxx code, DW_AT_hi_user is 0x3fff
+    using attrMask = std::bitset<0x4000>;
+
+    /**
+     * @brief the attributes a handler consumes, picked out of a die in a single pass
+     *
+     * e.g. `attrPack<DW_AT_name, DW_AT_decl_line> attrs{DIE.getAttrs()}; attrs.get<DW_AT_decl_line>()`
+     * the lookup of a code is resolved at compile time, an attribute that is absent gives nullptr
+     */
+    template <uint16_t... ATs>
+    class attrPack
+    {
+        static constexpr std::array<uint16_t, sizeof...(ATs)> codes{ATs...};
+
+        std::array<const dw::attr *, sizeof...(ATs)> mSlots{};
+
+        static constexpr size_t slotOf(uint16_t type) noexcept
+        {
+            for (size_t idx = 0; idx < codes.size(); idx++)
+            {
+                if (codes[idx] == type)
+                    return idx;
+            }
+            return codes.size();
+        }
+
+        template <size_t... Is>
+        void _assign(const dw::attr &attr, std::index_sequence<Is...>) noexcept
+        {
+            const uint16_t type = attr.getType();
+            (void)((type == ATs ? (this->mSlots[Is] = &attr, true) : false) || ...);
+        }
+
+    public:
+        explicit attrPack(const std::vector<dw::attr> &attrs) noexcept
+        {
+            for (auto &&attr : attrs)
+                this->_assign(attr, std::make_index_sequence<sizeof...(ATs)>{});
+        }
+
+        template <uint16_t AT>
+        const dw::attr *get() const noexcept
+        {
+            constexpr size_t slot = slotOf(AT);
+            static_assert(slot < sizeof...(ATs), "attribute is not part of this pack");
+            return this->mSlots[slot];
+        }
+
+        /**
+         * @brief mark the attributes of this pack in `mask`, see `dw::file::setDecodedAttrs`
+         */
+        static void addTo(attrMask &mask)
+        {
+            (mask.set(ATs), ...);
+        }
+    };
+
+    // dense index of a DW_TAG_xxx: the standard tags, then the GNU extensions from 0x4100
+    inline constexpr size_t tagIndexCount = 0x90;
+
+    constexpr size_t tagIndex(uint16_t tag) noexcept
+    {
+        if (tag < 0x80)
+            return tag;
+        if (tag >= 0x4100 && tag < 0x4110)
+            return 0x80 + (tag - 0x4100);
+        return tagIndexCount;
+    }
+
+    template <typename Handler>
+    struct tagRoute
+    {
+        uint16_t tag;
+        Handler  handler;
+    };
+
+    /**
+     * @brief build a table indexed by `tagIndex`, unrouted tags map to a null handler
+     */
+    template <typename Handler, size_t N>
+    constexpr std::array<Handler, tagIndexCount> makeTagTable(const tagRoute<Handler> (&routes)[N])
+    {
+        std::array<Handler, tagIndexCount> table{};
+        for (auto &&route : routes)
+        {
+            if (tagIndex(route.tag) < tagIndexCount)
+                table[tagIndex(route.tag)] = route.handler;
+        }
+        return table;
+    }
+
+} // namespace dw
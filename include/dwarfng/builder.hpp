@@ -0,0 +1,531 @@
+#pragma once
+
+#ifndef LIBDWARF_STATIC
+#define LIBDWARF_STATIC
+#endif
+#include <libdwarf/dwarf.h>
+#include <libdwarf/libdwarf.h>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dw
+{
+    /**
+     * @brief assembles .debug_info, .debug_abbrev, .debug_str and .debug_line in memory and hands them to
+     *        libdwarf through its object access interface, so a `dw::file` can be opened on exact DIE trees
+     *        without compiling anything
+     *
+     * Only what the extractor reads is produced: 32-bit little endian DWARF 4 or 5 compile units sharing one
+     * abbreviation table, strings as DW_FORM_strp, unsigned/signed constants as DW_FORM_udata/sdata, references as
+     * DW_FORM_ref4 within a CU and DW_FORM_ref_addr across CUs, and a version 4 line table per CU carrying only
+     * the file names (so DW_AT_decl_file `n` is the n-th file given to `addCU`).
+     *
+     *     dw::builder build;
+     *     auto cu = build.addCU("a.cpp", {"a.cpp", "a.hpp"});
+     *     auto i32 = build.addBaseType(cu, "int", 4, DW_ATE_signed);
+     *     auto point = build.add(cu, DW_TAG_structure_type).name("point").udata(DW_AT_byte_size, 8).id();
+     *     build.addMember(point, "x", i32, 0);
+     *     dw::file dwFile{build.finish()};
+     *
+     * The builder owns the section bytes and must outlive the `dw::file`.
+     */
+    class builder
+    {
+    public:
+        using dieId = uint32_t;
+
+        // fluent access to the attributes of one die
+        class dieRef
+        {
+            builder &mBuilder;
+            dieId    mId;
+
+        public:
+            dieRef(builder &owner, dieId id) :
+                mBuilder(owner), mId(id) {}
+
+            dieId id() const noexcept
+            {
+                return this->mId;
+            }
+
+            dieRef &name(std::string_view value)
+            {
+                return this->string(DW_AT_name, value);
+            }
+
+            dieRef &string(uint16_t type, std::string_view value)
+            {
+                this->mBuilder._addAttr(this->mId, {type, DW_FORM_strp, this->mBuilder._intern(value)});
+                return *this;
+            }
+
+            dieRef &udata(uint16_t type, uint64_t value)
+            {
+                this->mBuilder._addAttr(this->mId, {type, DW_FORM_udata, value});
+                return *this;
+            }
+
+            dieRef &sdata(uint16_t type, int64_t value)
+            {
+                this->mBuilder._addAttr(this->mId, {type, DW_FORM_sdata, static_cast<uint64_t>(value)});
+                return *this;
+            }
+
+            dieRef &flag(uint16_t type)
+            {
+                this->mBuilder._addAttr(this->mId, {type, DW_FORM_flag_present, 0});
+                return *this;
+            }
+
+            // the form (ref4 or ref_addr) is chosen by `finish` once both CUs are known
+            dieRef &ref(uint16_t type, dieId target)
+            {
+                this->mBuilder._addAttr(this->mId, {type, DW_FORM_ref4, target});
+                return *this;
+            }
+        };
+
+    private:
+        struct attrValue
+        {
+            uint16_t type;
+            uint16_t form;
+            uint64_t value; // string offset for strp, target die for references
+        };
+
+        struct node
+        {
+            uint16_t               tag;
+            dieId                  parent;
+            dieId                  cu;
+            std::vector<dieId>     children;
+            std::vector<attrValue> attrs;
+            uint32_t               abbrev = 0;
+            uint64_t               offset = 0; // in .debug_info, set by `finish`
+        };
+
+        struct unitInfo
+        {
+            dieId                    root;
+            std::vector<std::string> files;
+        };
+
+        enum sectionIdx : uint8_t
+        {
+            nullSection, // libdwarf skips index 0 like the ELF null section
+            info,
+            abbrev,
+            str,
+            line,
+            sectionCount
+        };
+
+        static constexpr std::array<const char *, sectionCount> sectionNames{"", ".debug_info", ".debug_abbrev", ".debug_str", ".debug_line"};
+
+        uint16_t                                       mVersion;
+        std::vector<node>                              mNodes;
+        std::vector<unitInfo>                          mUnits;
+        std::unordered_map<std::string, uint64_t>      mStrings;
+        std::array<std::vector<uint8_t>, sectionCount> mSections;
+        Dwarf_Obj_Access_Interface_a                   mInterface{};
+        bool                                           mFinished = false;
+
+    public:
+        /**
+         * @param version 4 or 5, the version of every CU header
+         */
+        explicit builder(uint16_t version = 5) :
+            mVersion(version)
+        {
+            this->mSections[str].push_back(0); // offset 0 is the empty string
+        }
+
+        builder(const builder &) = delete;
+
+        /**
+         * @param files the line table, `DW_AT_decl_file` 1 is `files[0]`
+         */
+        dieId addCU(std::string_view name, std::vector<std::string> files = {}, uint16_t language = DW_LANG_C_plus_plus)
+        {
+            dieId id = static_cast<dieId>(this->mNodes.size());
+            this->mNodes.push_back({DW_TAG_compile_unit, id, id, {}, {}});
+            this->mUnits.push_back({id, std::move(files)});
+            this->at(id).name(name).string(DW_AT_producer, "dwarfng builder").udata(DW_AT_language, language);
+            return id;
+        }
+
+        dieRef add(dieId parent, uint16_t tag)
+        {
+            dieId id = static_cast<dieId>(this->mNodes.size());
+            this->mNodes.push_back({tag, parent, this->mNodes[parent].cu, {}, {}});
+            this->mNodes[parent].children.push_back(id);
+            return {*this, id};
+        }
+
+        dieRef at(dieId id)
+        {
+            return {*this, id};
+        }
+
+        dieId addBaseType(dieId parent, std::string_view name, uint64_t byteSize, uint16_t encoding)
+        {
+            return this->add(parent, DW_TAG_base_type).name(name).udata(DW_AT_byte_size, byteSize).udata(DW_AT_encoding, encoding).id();
+        }
+
+        dieId addPointer(dieId parent, dieId target, uint64_t byteSize = 8)
+        {
+            return this->add(parent, DW_TAG_pointer_type).udata(DW_AT_byte_size, byteSize).ref(DW_AT_type, target).id();
+        }
+
+        dieId addMember(dieId parent, std::string_view name, dieId type, uint64_t offset)
+        {
+            return this->add(parent, DW_TAG_member).name(name).ref(DW_AT_type, type).udata(DW_AT_data_member_location, offset).id();
+        }
+
+        dieId addEnumerator(dieId parent, std::string_view name, int64_t value)
+        {
+            return this->add(parent, DW_TAG_enumerator).name(name).sdata(DW_AT_const_value, value).id();
+        }
+
+        size_t dieCount() const noexcept
+        {
+            return this->mNodes.size();
+        }
+
+        // offset of the die in .debug_info, valid after `finish`
+        uint64_t offsetOf(dieId id) const noexcept
+        {
+            return this->mNodes[id].offset;
+        }
+
+        const std::vector<uint8_t> &debugInfo() const noexcept
+        {
+            return this->mSections[info];
+        }
+
+        /**
+         * @brief lay out and encode the sections, no die can be added afterwards
+         * @return the interface to pass to `dwarf_object_init_b` or the `dw::file` constructor
+         */
+        Dwarf_Obj_Access_Interface_a *finish()
+        {
+            if (!this->mFinished)
+            {
+                this->_encodeLines();
+                this->_assignAbbrevs();
+                this->_layout();
+                this->_encodeInfo();
+                this->mFinished = true;
+            }
+            static constexpr Dwarf_Obj_Access_Methods_a methods{
+                _sectionInfo, _byteOrder, _lengthSize, _pointerSize, _fileSize, _sectionCount, _loadSection, _relocate};
+            this->mInterface = {this, &methods};
+            return &this->mInterface;
+        }
+
+    private:
+        void _addAttr(dieId id, attrValue value)
+        {
+            this->mNodes[id].attrs.push_back(value);
+        }
+
+        uint64_t _intern(std::string_view value)
+        {
+            auto [it, inserted] = this->mStrings.try_emplace(std::string{value}, this->mSections[str].size());
+            if (inserted)
+            {
+                this->mSections[str].insert(this->mSections[str].end(), value.begin(), value.end());
+                this->mSections[str].push_back(0);
+            }
+            return it->second;
+        }
+
+        /* ---------------------------------------- encoding ---------------------------------------- */
+
+        static void _put(std::vector<uint8_t> &out, uint64_t value, size_t bytes)
+        {
+            for (size_t idx = 0; idx < bytes; idx++)
+                out.push_back(static_cast<uint8_t>(value >> (8 * idx)));
+        }
+
+        static void _putULEB(std::vector<uint8_t> &out, uint64_t value)
+        {
+            do
+            {
+                uint8_t byte = value & 0x7f;
+                value >>= 7;
+                out.push_back(value ? byte | 0x80 : byte);
+            } while (value);
+        }
+
+        static void _putSLEB(std::vector<uint8_t> &out, int64_t value)
+        {
+            while (true)
+            {
+                uint8_t byte = value & 0x7f;
+                value >>= 7;
+                if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)))
+                {
+                    out.push_back(byte);
+                    return;
+                }
+                out.push_back(byte | 0x80);
+            }
+        }
+
+        static size_t _ulebSize(uint64_t value) noexcept
+        {
+            size_t size = 1;
+            while (value >>= 7)
+                ++size;
+            return size;
+        }
+
+        static size_t _slebSize(int64_t value) noexcept
+        {
+            std::vector<uint8_t> tmp;
+            _putSLEB(tmp, value);
+            return tmp.size();
+        }
+
+        static void _patch32(std::vector<uint8_t> &out, size_t at, uint64_t value)
+        {
+            for (size_t idx = 0; idx < 4; idx++)
+                out[at + idx] = static_cast<uint8_t>(value >> (8 * idx));
+        }
+
+        // one version 4 line table per CU, only the header with the file names and an empty sequence
+        void _encodeLines()
+        {
+            static constexpr uint8_t standardOpcodeLengths[] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+            std::vector<uint8_t>    &out = this->mSections[line];
+            for (auto &&unit : this->mUnits)
+            {
+                this->_addAttr(unit.root, {DW_AT_stmt_list, DW_FORM_sec_offset, out.size()});
+                size_t begin = out.size();
+                _put(out, 0, 4); // unit_length
+                _put(out, 4, 2);
+                size_t headerLength = out.size();
+                _put(out, 0, 4);
+                out.insert(out.end(), {1, 1, 1, static_cast<uint8_t>(-5), 14, 13}); // min inst, max ops, is_stmt, base, range, opcode base
+                out.insert(out.end(), std::begin(standardOpcodeLengths), std::end(standardOpcodeLengths));
+                out.push_back(0); // no include directories
+                for (auto &&file : unit.files)
+                {
+                    out.insert(out.end(), file.begin(), file.end());
+                    out.insert(out.end(), {0, 0, 0, 0}); // terminator, directory, mtime, length
+                }
+                out.push_back(0);
+                _patch32(out, headerLength, out.size() - headerLength - 4);
+                out.insert(out.end(), {0, 1, 1}); // DW_LNE_end_sequence
+                _patch32(out, begin, out.size() - begin - 4);
+            }
+        }
+
+        void _assignAbbrevs()
+        {
+            std::map<std::vector<uint16_t>, uint32_t> codes;
+            std::vector<uint8_t>                     &out = this->mSections[abbrev];
+            for (auto &&item : this->mNodes)
+            {
+                for (auto &&attr : item.attrs)
+                {
+                    if (attr.form == DW_FORM_ref4 || attr.form == DW_FORM_ref_addr)
+                        attr.form = this->mNodes[attr.value].cu == item.cu ? DW_FORM_ref4 : DW_FORM_ref_addr;
+                }
+
+                std::vector<uint16_t> key{item.tag, uint16_t(!item.children.empty())};
+                for (auto &&attr : item.attrs)
+                    key.insert(key.end(), {attr.type, attr.form});
+                auto [it, inserted] = codes.try_emplace(std::move(key), uint32_t(codes.size() + 1));
+                item.abbrev = it->second;
+                if (!inserted)
+                    continue;
+                _putULEB(out, item.abbrev);
+                _putULEB(out, item.tag);
+                out.push_back(item.children.empty() ? DW_CHILDREN_no : DW_CHILDREN_yes);
+                for (auto &&attr : item.attrs)
+                {
+                    _putULEB(out, attr.type);
+                    _putULEB(out, attr.form);
+                }
+                out.insert(out.end(), {0, 0});
+            }
+            out.push_back(0);
+        }
+
+        size_t _headerSize() const noexcept
+        {
+            return this->mVersion >= 5 ? 12 : 11;
+        }
+
+        static size_t _attrSize(const attrValue &attr) noexcept
+        {
+            switch (attr.form)
+            {
+            case DW_FORM_udata: return _ulebSize(attr.value);
+            case DW_FORM_sdata: return _slebSize(static_cast<int64_t>(attr.value));
+            case DW_FORM_flag_present: return 0;
+            default: return 4; // strp, ref4, ref_addr, sec_offset
+            }
+        }
+
+        // the dies of a CU in .debug_info order, iterative so that deep nesting does not overflow the stack
+        template <typename Fn>
+        void _preorder(dieId root, Fn &&fn)
+        {
+            std::vector<std::pair<dieId, size_t>> stack{{root, 0}};
+            fn(root, false);
+            while (!stack.empty())
+            {
+                auto &[id, next] = stack.back();
+                if (next == this->mNodes[id].children.size())
+                {
+                    dieId done = id;
+                    stack.pop_back();
+                    if (!this->mNodes[done].children.empty())
+                        fn(done, true); // the null entry closing the children
+                    continue;
+                }
+                dieId child = this->mNodes[id].children[next++];
+                fn(child, false);
+                stack.push_back({child, 0});
+            }
+        }
+
+        void _layout()
+        {
+            uint64_t offset = 0;
+            for (auto &&unit : this->mUnits)
+            {
+                offset += this->_headerSize();
+                this->_preorder(unit.root, [&](dieId id, bool closing) {
+                    if (closing)
+                    {
+                        ++offset;
+                        return;
+                    }
+                    node &item = this->mNodes[id];
+                    item.offset = offset;
+                    offset += _ulebSize(item.abbrev);
+                    for (auto &&attr : item.attrs)
+                        offset += _attrSize(attr);
+                });
+            }
+        }
+
+        void _encodeInfo()
+        {
+            std::vector<uint8_t> &out = this->mSections[info];
+            for (auto &&unit : this->mUnits)
+            {
+                size_t begin = out.size();
+                _put(out, 0, 4);
+                _put(out, this->mVersion, 2);
+                if (this->mVersion >= 5)
+                {
+                    out.push_back(DW_UT_compile);
+                    out.push_back(8);
+                    _put(out, 0, 4);
+                }
+                else
+                {
+                    _put(out, 0, 4);
+                    out.push_back(8);
+                }
+
+                this->_preorder(unit.root, [&](dieId id, bool closing) {
+                    if (closing)
+                    {
+                        out.push_back(0);
+                        return;
+                    }
+                    const node &item = this->mNodes[id];
+                    _putULEB(out, item.abbrev);
+                    for (auto &&attr : item.attrs)
+                    {
+                        switch (attr.form)
+                        {
+                        case DW_FORM_udata: _putULEB(out, attr.value); break;
+                        case DW_FORM_sdata: _putSLEB(out, static_cast<int64_t>(attr.value)); break;
+                        case DW_FORM_flag_present: break;
+                        case DW_FORM_ref4: _put(out, this->mNodes[attr.value].offset - begin, 4); break;
+                        case DW_FORM_ref_addr: _put(out, this->mNodes[attr.value].offset, 4); break;
+                        default: _put(out, attr.value, 4); break; // strp, sec_offset
+                        }
+                    }
+                });
+                _patch32(out, begin, out.size() - begin - 4);
+            }
+        }
+
+        /* ---------------------------------- object access interface ---------------------------------- */
+
+        static builder &_self(void *obj) noexcept
+        {
+            return *static_cast<builder *>(obj);
+        }
+
+        static int _sectionInfo(void *obj, Dwarf_Unsigned index, Dwarf_Obj_Access_Section_a *section, int *)
+        {
+            if (index >= sectionCount)
+                return DW_DLV_NO_ENTRY;
+            *section = {};
+            section->as_name = sectionNames[index];
+            section->as_type = index == nullSection ? 0 : 1; // SHT_PROGBITS
+            section->as_size = _self(obj).mSections[index].size();
+            section->as_addralign = 1;
+            return DW_DLV_OK;
+        }
+
+        static Dwarf_Small _byteOrder(void *)
+        {
+            return DW_END_little;
+        }
+
+        static Dwarf_Small _lengthSize(void *)
+        {
+            return 4;
+        }
+
+        static Dwarf_Small _pointerSize(void *)
+        {
+            return 8;
+        }
+
+        static Dwarf_Unsigned _fileSize(void *obj)
+        {
+            Dwarf_Unsigned size = 0;
+            for (auto &&section : _self(obj).mSections)
+                size += section.size();
+            return size;
+        }
+
+        static Dwarf_Unsigned _sectionCount(void *)
+        {
+            return sectionCount;
+        }
+
+        static int _loadSection(void *obj, Dwarf_Unsigned index, Dwarf_Small **data, int *)
+        {
+            if (index >= sectionCount || _self(obj).mSections[index].empty())
+                return DW_DLV_NO_ENTRY;
+            *data = _self(obj).mSections[index].data();
+            return DW_DLV_OK;
+        }
+
+        // nothing to relocate, every offset is final
+        static int _relocate(void *, Dwarf_Unsigned, Dwarf_Debug, int *)
+        {
+            return DW_DLV_OK;
+        }
+    };
+
+} // namespace dw
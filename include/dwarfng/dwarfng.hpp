@@ -9,18 +9,105 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <array>
 #include <memory>
 #include <mutex>
+#include <span>
+#include <unordered_map>
+#include <Memory.hpp>
+#include <Trace.hpp>
 #include "attr.hpp"
+#include "attrPack.hpp"
 #include "global.hpp"
 #include "arange.hpp"
 #include "linetable.hpp"
 #include "utils.hpp"
+#include "parallel.hpp"
+#include "stats.hpp"
 
 namespace dw
 {
     class file;
 
+    // the attributes looked up on almost every die get a fixed slot, see `die::findAttrByType`
+    inline constexpr size_t commonAttrCount = 16;
+
+    inline constexpr std::array<uint8_t, 0x80> commonAttrSlots = [] {
+        std::array<uint8_t, 0x80> slots{};
+        slots.fill(commonAttrCount);
+        constexpr uint16_t common[commonAttrCount] = {
+            DW_AT_name, DW_AT_type, DW_AT_decl_file, DW_AT_decl_line, DW_AT_decl_column, DW_AT_specification,
+            DW_AT_abstract_origin, DW_AT_byte_size, DW_AT_data_member_location, DW_AT_declaration,
+            DW_AT_linkage_name, DW_AT_accessibility, DW_AT_artificial, DW_AT_external, DW_AT_const_value,
+            DW_AT_containing_type};
+        for (uint8_t slot = 0; slot < commonAttrCount; slot++)
+            slots[common[slot]] = slot;
+        return slots;
+    }();
+
+    /**
+     * @return the slot of a common `DW_AT_xxx`, or `commonAttrCount` for the others
+     */
+    constexpr size_t commonAttrSlot(uint16_t type) noexcept
+    {
+        return type < commonAttrSlots.size() ? commonAttrSlots[type] : commonAttrCount;
+    }
+
+    /**
+     * @brief a child die as seen by a prune predicate, before a `dw::die` is built for it
+     */
+    class rawDIE
+    {
+        Dwarf_Die mRaw;
+
+    public:
+        explicit rawDIE(Dwarf_Die raw_die) noexcept :
+            mRaw(raw_die) {}
+
+        uint16_t getTAG() const noexcept
+        {
+            Dwarf_Half tag = 0;
+            dwarf_tag(this->mRaw, &tag, nullptr);
+            return tag;
+        }
+
+        uint64_t getOffset() const noexcept
+        {
+            Dwarf_Off off = 0;
+            dwarf_dieoffset(this->mRaw, &off, nullptr);
+            return off;
+        }
+
+        // `DW_AT_name`, read straight from the string section
+        std::string_view getName() const noexcept
+        {
+            char *name = nullptr;
+            if (dwarf_diename(this->mRaw, &name, nullptr) != DW_DLV_OK || !name)
+                return "";
+            return name;
+        }
+
+        bool hasAttr(uint16_t type) const noexcept
+        {
+            Dwarf_Bool ret = false;
+            dwarf_hasattr(this->mRaw, type, &ret, nullptr);
+            return ret;
+        }
+
+        // an unsigned constant attribute such as `DW_AT_decl_file`, `defaultVal` if absent
+        uint64_t getAttrAsInt(uint16_t type, uint64_t defaultVal = 0) const noexcept
+        {
+            Dwarf_Attribute attr = nullptr;
+            if (dwarf_attr(this->mRaw, type, &attr, nullptr) != DW_DLV_OK)
+                return defaultVal;
+            Dwarf_Unsigned value = 0;
+            if (dwarf_formudata(attr, &value, nullptr) != DW_DLV_OK)
+                value = defaultVal;
+            dwarf_dealloc_attribute(attr);
+            return value;
+        }
+    };
+
     /**
      * @brief debugging info entry
      */
@@ -37,6 +124,13 @@ namespace dw
         uint64_t mOffset;
         uint16_t mTAG;
         bool     mHasChildren;
+        bool     mCommonIndexed = false; // false if there are too many attributes for `mCommonSlots`
+        bool     mPruned = false;        // attributes not decoded yet, see `getChildren(dwFile, prune)`
+        uint32_t mPrunedCount = 0;       // pruned dies in mChildren
+
+        // bit i set: the i-th common attribute (see `commonAttrSlot`) is mAttrs[mCommonSlots[i]]
+        uint16_t                             mCommonMask = 0;
+        std::array<uint8_t, commonAttrCount> mCommonSlots;
 
     public:
         /**
@@ -44,8 +138,9 @@ namespace dw
          * @param raw_die a ptr to the raw die from `libdwarf`, must be dealloc right away
          * @param parent parent die, or nullptr if not exists
          * @param file which `dw::file` contain this die
+         * @param decodeAttrs false to build a pruned stub, see `getChildren(dwFile, prune)`
          */
-        die(Dwarf_Die raw_die, dw::die *parent, dw::file *file);
+        die(Dwarf_Die raw_die, dw::die *parent, dw::file *file, bool decodeAttrs = true);
         die(const dw::die &die) = delete;
         die(dw::die &&die) noexcept;
 
@@ -64,9 +159,9 @@ namespace dw
         // get value of `DW_AT_name`
         std::string_view getName(const char *whenNull = "") const noexcept
         {
-            auto found = std::find(this->mAttrs.begin(), this->mAttrs.end(), (uint16_t)DW_AT_name);
-            if (found != this->mAttrs.end())
-                return std::get<std::string_view>(found->getValue());
+            const dw::attr *found = this->findAttrByType(DW_AT_name);
+            if (found)
+                return found->get<std::string_view>();
             else
                 return whenNull;
         }
@@ -104,9 +199,39 @@ namespace dw
         std::vector<dw::die> &getChildren(dw::file &dwFile);
         std::vector<dw::die> &getChildren(dw::file &dwFile) const;
 
-        void clearCachedChildren() noexcept
+        /**
+         * @brief like `getChildren(dwFile)`, but a child for which `prune(const dw::rawDIE &)` returns true
+         *        is only recorded by offset, tag and whether it has children: none of its attributes are
+         *        decoded and nothing below it is read. libdwarf steps over the pruned subtree with
+         *        DW_AT_sibling when present, otherwise with the abbrev driven skip.
+         *
+         *        Pruned children stay in the returned vector with `isPruned()` set, the caller skips them.
+         *        They are decoded on demand by `getChildren(dwFile)` on this die or by
+         *        `file::findDIEbyOffset`. Has no effect if the children are already cached.
+         */
+        template <typename Prune>
+        std::vector<dw::die> &getChildren(dw::file &dwFile, Prune &&prune);
+
+        /**
+         * @brief the children in [begin, end) with their attributes decoded, the others are left as pruned
+         *        stubs. Lets the workers of a split CU each decode only their own part, see `dw::cuTask`.
+         *        [0, SIZE_MAX) is the same as `getChildren(dwFile)`.
+         */
+        std::span<dw::die> getChildRange(dw::file &dwFile, size_t begin, size_t end);
+
+        bool isPruned() const noexcept
+        {
+            return this->mPruned;
+        }
+
+        /**
+         * @brief drop the cached children. Virtual so that a CU reached through a `die &` also releases
+         *        its location expression arena
+         */
+        virtual void clearCachedChildren() noexcept
         {
             this->mChildren.clear();
+            this->mPrunedCount = 0;
         }
 
         const dw::attr *findAttrByOffset(uint64_t off) const noexcept;
@@ -116,15 +241,31 @@ namespace dw
     protected:
         void _initAttrs(Dwarf_Die raw_die, dw::file *file);
 
-        void _initChildren(Dwarf_Die raw_die, dw::file &dwFile);
+        template <typename Prune>
+        void _initChildren(Dwarf_Die raw_die, dw::file &dwFile, Prune &&prune);
+
+        std::vector<dw::die> &_loadChildren(dw::file &dwFile);
+
+        void _decodePruned(dw::file &dwFile);
 
-        std::vector<dw::die>::iterator _findChildByOffset(uint64_t offset, dw::file &dwFile);
+        void _indexCommonAttrs() noexcept;
+
+        dw::exprArena &_exprArena(dw::file *file) noexcept;
+
+        dw::die *_findChildByOffset(uint64_t offset, dw::file &dwFile);
     };
 
     class CU : public die
     {
+        friend class die;
+        friend class file;
+
         dw::linetable            mLineTable;
         std::vector<std::string> mSrcfiles;
+        dw::exprArena            mExprArena; // location expressions of the dies below this CU
+        uint64_t                 mByteSize = 0; // whole unit in .debug_info, header included
+        uint64_t                 mEndOffset = 0; // offset of the next unit
+        uint32_t                 mEvictions = 0;
 
     public:
         CU(Dwarf_Die raw_die, dw::die *parent, dw::file *file) :
@@ -132,13 +273,39 @@ namespace dw
         CU(dw::CU &&other) noexcept :
             die(std::move(other)),
             mLineTable(std::move(other.mLineTable)),
-            mSrcfiles(std::move(other.mSrcfiles)) {}
+            mSrcfiles(std::move(other.mSrcfiles)),
+            mExprArena(std::move(other.mExprArena)),
+            mByteSize(other.mByteSize),
+            mEndOffset(other.mEndOffset),
+            mEvictions(other.mEvictions) {}
 
         virtual bool isCompileUnit() const noexcept override
         {
             return true;
         }
 
+        uint64_t getByteSize() const noexcept
+        {
+            return this->mByteSize;
+        }
+
+        // `args` of the per-CU trace event
+        std::string traceArgs() const
+        {
+            return std::format(R"("name": "{}", "bytes": {})", trace::escape(this->getName()), this->mByteSize);
+        }
+
+        /**
+         * @brief drop the cached children together with their location expressions
+         */
+        void clearCachedChildren() noexcept override
+        {
+            if (!this->mChildren.empty())
+                ++this->mEvictions;
+            die::clearCachedChildren();
+            this->mExprArena.reset();
+        }
+
         const std::vector<std::string> &getSrcfiles(dw::file &dwFile);
 
         dw::linetable &getLineTable(dw::file &dwFile);
@@ -152,8 +319,32 @@ namespace dw
         std::string mFilePath;
         int         mStatue = 1; // 0: success; 1: error; -1: no dwarf
 
-        Dwarf_Debug         mRawDbg;
-        std::vector<dw::CU> mCompileUnits;
+    public:
+        // wall time of the two steps of opening, see `getInitTimes`
+        struct initTimes
+        {
+            uint64_t openNs = 0; // dwarf_init_path
+            uint64_t scanNs = 0; // walking the CU headers
+        };
+
+    private:
+        initTimes mInitTimes;
+
+        Dwarf_Debug                  mRawDbg = nullptr;
+        Dwarf_Obj_Access_Interface_a *mObject = nullptr; // opened from memory, see `file(Dwarf_Obj_Access_Interface_a *)`
+        std::vector<dw::CU>          mCompileUnits;
+
+        // type die offset -> structural hash, see `typeHash`
+        std::unordered_map<uint64_t, uint64_t> mTypeHashes;
+
+        // attributes to decode, nullptr means all of them, see `setDecodedAttrs`
+        std::unique_ptr<dw::attrMask> mDecodedAttrs;
+
+        // location expressions of the CU dies themselves
+        dw::exprArena mExprArena;
+
+        // nullptr unless `statsRegistry` was enabled when the file was opened
+        std::unique_ptr<dw::fileStats> mStats;
 
     public:
         file() {}
@@ -164,6 +355,13 @@ namespace dw
          */
         file(const std::string &filePath);
         file(std::string_view filePath);
+
+        /**
+         * @brief open dwarf sections served by an object access interface, e.g. `dw::builder::finish()`
+         * @param object must outlive the file
+         * @param name only reported by `getFilePath`, `hashAllTypes` reopens `object` once per worker
+         */
+        file(Dwarf_Obj_Access_Interface_a *object, std::string_view name = "<memory>");
         file(dw::file &&other) noexcept;
         dw::file &operator=(const dw::file &other) = delete;
         dw::file &operator=(dw::file &&other) noexcept;
@@ -184,6 +382,25 @@ namespace dw
             return this->mStatue;
         }
 
+        const std::string &getFilePath() const noexcept
+        {
+            return this->mFilePath;
+        }
+
+        const initTimes &getInitTimes() const noexcept
+        {
+            return this->mInitTimes;
+        }
+
+        /**
+         * @brief only decode the attributes in `mask` for the dies read from now on,
+         *        the others are skipped before their form is even looked at
+         */
+        void setDecodedAttrs(const dw::attrMask &mask)
+        {
+            this->mDecodedAttrs = std::make_unique<dw::attrMask>(mask);
+        }
+
         std::vector<dw::CU> &getCUs() noexcept
         {
             return this->mCompileUnits;
@@ -205,12 +422,63 @@ namespace dw
 
         std::vector<dw::arange> getAranges();
 
+        /**
+         * @brief structural hash of a type, in the spirit of the DWARF5 type signature (section 7.32)
+         *
+         * The hash covers the tag, the layout related attributes, the children and the referenced
+         * types, but never a DIE offset, so the same type gets the same hash in two different builds.
+         * Pointers and references to named types are hashed by qualified name, other references are
+         * hashed recursively; a reference back into a type that is still being hashed is encoded by
+         * its distance on the stack. Results are memoized per type DIE.
+         *
+         * @param offset offset of the type DIE
+         * @return 0 if there is no DIE at `offset`
+         */
+        uint64_t typeHash(uint64_t offset);
+        uint64_t typeHash(const dw::die &typeDIE);
+
+        /**
+         * @brief hash every type DIE in the file
+         *
+         * The CUs are spread over `threadCount` workers, each with its own `dw::file` opened on the
+         * same path or object since a `Dwarf_Debug` must not be shared between threads. The workers
+         * decode the same attributes as this file, and this file's cached dies are left alone.
+         *
+         * @param threadCount 0 means one worker per hardware thread
+         * @return type die offset -> hash, for every type DIE hashed so far
+         */
+        const std::unordered_map<uint64_t, uint64_t> &hashAllTypes(unsigned threadCount = 0);
+
+        /**
+         * @brief the CUs as tasks for `dw::schedule`, weighted by their size in .debug_info
+         *
+         * A CU bigger than `dw::splitBytes` is cut between its top-level children into parts of about that
+         * size, measured by the distance between the children's offsets. Only the top-level children are
+         * read to do so, as pruned stubs, and dropped again unless they were cached before.
+         *
+         * @param threadCount the workers the tasks are meant for, 1 never splits
+         */
+        std::vector<dw::cuTask> planTasks(unsigned threadCount);
+
     private:
-        void _init();
+        void _init(Dwarf_Obj_Access_Interface_a *object = nullptr);
+
+        // a second handle on the same sections with the same decoded attributes, see `hashAllTypes`
+        std::unique_ptr<dw::file> _reopen() const;
+
+        void _finish() noexcept;
 
         void _clearAll();
 
         Dwarf_Die _getRawDieByOffset(const uint64_t &offset);
+
+        void _flushStats();
+
+        uint64_t _typeHash(const dw::die &DIE, std::vector<uint64_t> &visiting, size_t &lowestBackRef);
+        uint64_t _hashTypeRef(uint64_t offset, bool byName, std::vector<uint64_t> &visiting, size_t &lowestBackRef);
+        uint64_t _hashScope(const dw::die &DIE) const;
+        void     _collectTypeHashes(const dw::die &scope, std::unordered_map<uint64_t, uint64_t> &out);
+        void     _collectTypeHash(const dw::die &DIE, std::unordered_map<uint64_t, uint64_t> &out);
     };
 
 } // namespace dw
@@ -229,34 +497,72 @@ inline dw::file::file(std::string_view filePath) :
     this->_init();
 }
 
+inline dw::file::file(Dwarf_Obj_Access_Interface_a *object, std::string_view name) :
+    mFilePath(name)
+{
+    this->_init(object);
+}
+
 inline dw::file::file(dw::file &&other) noexcept
 {
     this->mFilePath = std::move(other.mFilePath);
     this->mStatue = other.mStatue;
-    if (this->mRawDbg)
-        dwarf_finish(this->mRawDbg);
+    this->mInitTimes = other.mInitTimes;
+    this->_finish();
     this->mRawDbg = other.mRawDbg;
+    this->mObject = other.mObject;
     other.mRawDbg = nullptr;
     this->mCompileUnits = std::move(other.mCompileUnits);
+    this->mTypeHashes = std::move(other.mTypeHashes);
+    this->mDecodedAttrs = std::move(other.mDecodedAttrs);
+    this->mExprArena = std::move(other.mExprArena);
+    this->mStats = std::move(other.mStats);
 }
 
 inline dw::file &dw::file::operator=(dw::file &&other) noexcept
 {
+    this->_flushStats();
     this->mFilePath = std::move(other.mFilePath);
     this->mStatue = other.mStatue;
-    if (this->mRawDbg)
-        dwarf_finish(this->mRawDbg);
+    this->mInitTimes = other.mInitTimes;
+    this->_finish();
     this->mRawDbg = other.mRawDbg;
+    this->mObject = other.mObject;
     other.mRawDbg = nullptr;
     this->mCompileUnits = std::move(other.mCompileUnits);
+    this->mTypeHashes = std::move(other.mTypeHashes);
+    this->mDecodedAttrs = std::move(other.mDecodedAttrs);
+    this->mExprArena = std::move(other.mExprArena);
+    this->mStats = std::move(other.mStats);
 
     return *this;
 }
 
 inline dw::file::~file()
 {
-    if (this->mRawDbg)
+    this->_flushStats();
+    this->_finish();
+}
+
+inline void dw::file::_finish() noexcept
+{
+    if (!this->mRawDbg)
+        return;
+    if (this->mObject)
+        dwarf_object_finish(this->mRawDbg);
+    else
         dwarf_finish(this->mRawDbg);
+    this->mRawDbg = nullptr;
+}
+
+inline void dw::file::_flushStats()
+{
+    if (!this->mStats)
+        return;
+    for (auto &&compileUnit : this->mCompileUnits)
+        this->mStats->evictions += compileUnit.mEvictions;
+    dw::statsRegistry::get().add(*this->mStats);
+    this->mStats.reset();
 }
 
 inline bool dw::file::open(const std::string &filePath)
@@ -273,14 +579,29 @@ inline dw::die *dw::file::findDIEbyOffset(uint64_t offset)
 {
     auto it = std::upper_bound(this->mCompileUnits.begin(), this->mCompileUnits.end(),
                                offset, [](const uint64_t &a, const dw::die &b) -> bool { return a < b.getOffset(); });
+    if (it == this->mCompileUnits.begin())
+        return nullptr;
     --it;
     if (it->getOffset() == offset)
         return &*it;
-
-    auto found = it->_findChildByOffset(offset, *this);
-    if (found == it->getChildren(*this).end())
-        return nullptr;
-    return &*found;
+    if (!this->mStats)
+        return it->_findChildByOffset(offset, *this);
+
+    dw::fileStats &stats = *this->mStats;
+    ++stats.lookups;
+    stats.crossCUHops += it->getOffset() != stats.activeCU;
+    stats.evictedHits += it->mEvictions && it->mChildren.empty();
+    stats.inLookup = true;
+    dw::die *found = it->_findChildByOffset(offset, *this);
+    stats.inLookup = false;
+    if (found)
+    {
+        size_t depth = 0;
+        for (dw::die *iter = found->mParent; iter != &*it; iter = iter->mParent)
+            ++depth;
+        ++stats.lookupDepth[std::min(depth, dw::fileStats::depthBuckets - 1)];
+    }
+    return found;
 }
 
 inline const dw::die *dw::file::findDIEbyOffset(uint64_t offset) const
@@ -344,17 +665,42 @@ inline std::vector<dw::arange> dw::file::getAranges()
     return ret;
 }
 
-inline void dw::file::_init()
+inline void dw::file::_init(Dwarf_Obj_Access_Interface_a *object)
 {
-    // open the executable
+    // open the executable, or the sections behind `object`
     char        true_pathbuf[FILENAME_MAX];
     Dwarf_Error error;
-    this->mStatue = dwarf_init_path(mFilePath.c_str(), true_pathbuf,
-                                    FILENAME_MAX, DW_GROUPNUMBER_ANY,
-                                    nullptr, nullptr,
-                                    &this->mRawDbg, &error);
+    uint64_t    beginNs = trace::nowNs();
+    this->mObject = object;
+    {
+        trace::scope openTrace{"open", [&] { return std::format(R"("path": "{}")", trace::escape(this->mFilePath)); }};
+        if (object)
+            this->mStatue = dwarf_object_init_b(object, nullptr, nullptr, DW_GROUPNUMBER_ANY, &this->mRawDbg, &error);
+        else
+            this->mStatue = dwarf_init_path(mFilePath.c_str(), true_pathbuf,
+                                            FILENAME_MAX, DW_GROUPNUMBER_ANY,
+                                            nullptr, nullptr,
+                                            &this->mRawDbg, &error);
+    }
+    uint64_t scanBeginNs = trace::nowNs();
+    this->mInitTimes = {scanBeginNs - beginNs, 0};
+    struct scanTimer
+    {
+        initTimes &times;
+        uint64_t   beginNs;
+
+        ~scanTimer()
+        {
+            this->times.scanNs = trace::nowNs() - this->beginNs;
+        }
+    } scanTime{this->mInitTimes, scanBeginNs};
+
+    if (!this->mStats && dw::statsRegistry::get().enabled())
+        this->mStats = std::make_unique<dw::fileStats>();
 
     // get the compile units
+    trace::scope scanTrace{"CU header scan"};
+    memory::tag  memTag{memory::category::dieTree};
     Dwarf_Unsigned abbrev_offset, typeoffset, next_cu_header;
     Dwarf_Half     address_size, version_stamp, offset_size, extension_size, header_cu_type;
     Dwarf_Sig8     signature;
@@ -383,17 +729,278 @@ inline void dw::file::_init()
             return;
         }
         this->mCompileUnits.emplace_back(raw_CU_die, nullptr, this);
+        this->mCompileUnits.back().mByteSize = cu_header_length + (offset_size == 8 ? 12 : 4);
+        this->mCompileUnits.back().mEndOffset = next_cu_header;
         dwarf_dealloc_die(raw_CU_die);
     }
 }
 
 inline void dw::file::_clearAll()
 {
-    dwarf_finish(this->mRawDbg);
-    this->mRawDbg = nullptr;
+    this->_flushStats();
+    this->_finish();
     this->mFilePath.clear();
     this->mStatue = 1;
     this->mCompileUnits.clear();
+    this->mTypeHashes.clear();
+    this->mExprArena.reset();
+}
+
+inline uint64_t dw::file::typeHash(uint64_t offset)
+{
+    auto found = this->mTypeHashes.find(offset);
+    if (found != this->mTypeHashes.end())
+        return found->second;
+
+    const dw::die *typeDIE = this->findDIEbyOffset(offset);
+    if (!typeDIE)
+        return 0;
+    return this->typeHash(*typeDIE);
+}
+
+inline uint64_t dw::file::typeHash(const dw::die &typeDIE)
+{
+    std::vector<uint64_t> visiting;
+    size_t                lowestBackRef = SIZE_MAX;
+    return this->_typeHash(typeDIE, visiting, lowestBackRef);
+}
+
+inline const std::unordered_map<uint64_t, uint64_t> &dw::file::hashAllTypes(unsigned threadCount)
+{
+    if (!this->isOpen())
+        return this->mTypeHashes;
+
+    // every worker reads its own copy, so the caller's cached dies stay valid and all of them decode
+    // the same attributes
+    size_t                                              cuCount = this->mCompileUnits.size();
+    unsigned                                            workers = dw::workerCount(threadCount, cuCount);
+    std::vector<std::unique_ptr<dw::file>>              files(workers);
+    std::vector<std::unordered_map<uint64_t, uint64_t>> results(workers);
+    dw::schedule("hashAllTypes", this->planTasks(workers), workers, [&](unsigned workerIdx, const dw::cuTask &task) {
+        if (!files[workerIdx])
+            files[workerIdx] = this->_reopen();
+        dw::file *dwFile = files[workerIdx].get();
+        if (!dwFile->isOpen() || task.cuIdx >= dwFile->mCompileUnits.size())
+            return;
+
+        dw::CU &compileUnit = dwFile->mCompileUnits[task.cuIdx];
+        for (auto &&child : compileUnit.getChildRange(*dwFile, task.childBegin, task.childEnd))
+            dwFile->_collectTypeHash(child, results[workerIdx]);
+        compileUnit.clearCachedChildren();
+    });
+
+    for (auto &&result : results)
+        this->mTypeHashes.merge(result);
+    return this->mTypeHashes;
+}
+
+inline std::unique_ptr<dw::file> dw::file::_reopen() const
+{
+    auto copy = this->mObject ? std::make_unique<dw::file>(this->mObject, this->mFilePath)
+                              : std::make_unique<dw::file>(this->mFilePath);
+    if (this->mDecodedAttrs)
+        copy->setDecodedAttrs(*this->mDecodedAttrs);
+    return copy;
+}
+
+inline std::vector<dw::cuTask> dw::file::planTasks(unsigned threadCount)
+{
+    uint64_t totalBytes = 0;
+    for (auto &&compileUnit : this->mCompileUnits)
+        totalBytes += compileUnit.mByteSize;
+    uint64_t partBytes = dw::splitBytes(totalBytes, threadCount);
+
+    std::vector<dw::cuTask> tasks;
+    tasks.reserve(this->mCompileUnits.size());
+    for (size_t cuIdx = 0; cuIdx < this->mCompileUnits.size(); cuIdx++)
+    {
+        dw::CU &compileUnit = this->mCompileUnits[cuIdx];
+        if (!partBytes || compileUnit.mByteSize <= partBytes || !compileUnit.hasChild())
+        {
+            tasks.push_back({cuIdx, compileUnit.mByteSize});
+            continue;
+        }
+
+        bool     cached = !compileUnit.mChildren.empty();
+        auto    &children = compileUnit.getChildren(*this, [](const dw::rawDIE &) { return true; });
+        size_t   firstPart = tasks.size();
+        size_t   begin = 0;
+        uint64_t bytes = 0;
+        for (size_t idx = 0; idx < children.size(); idx++)
+        {
+            // a child spans up to the next one, the last one up to the end of the unit
+            uint64_t offset = children[idx].getOffset();
+            uint64_t next = idx + 1 < children.size() ? children[idx + 1].getOffset() : compileUnit.mEndOffset;
+            bytes += next > offset ? next - offset : 0;
+            if (bytes >= partBytes || idx + 1 == children.size())
+            {
+                tasks.push_back({cuIdx, bytes, begin, idx + 1});
+                begin = idx + 1;
+                bytes = 0;
+            }
+        }
+        if (tasks.size() - firstPart == 1)
+            tasks.back() = {cuIdx, compileUnit.mByteSize};
+        if (!cached)
+            compileUnit.clearCachedChildren();
+    }
+    return tasks;
+}
+
+inline uint64_t dw::file::_typeHash(const dw::die &DIE, std::vector<uint64_t> &visiting, size_t &lowestBackRef)
+{
+    // attributes that take part in the hash, in this order
+    static constexpr uint16_t hashedAttrs[] = {
+        DW_AT_name, DW_AT_byte_size, DW_AT_bit_size, DW_AT_bit_offset, DW_AT_data_bit_offset,
+        DW_AT_data_member_location, DW_AT_encoding, DW_AT_accessibility, DW_AT_virtuality,
+        DW_AT_vtable_elem_location, DW_AT_const_value, DW_AT_enum_class, DW_AT_declaration,
+        DW_AT_artificial, DW_AT_count, DW_AT_lower_bound, DW_AT_upper_bound, DW_AT_alignment,
+        DW_AT_reference, DW_AT_rvalue_reference, DW_AT_calling_convention};
+
+    const uint16_t tag = DIE.getTAG();
+    const bool     isType = dw::isTypeTag(tag);
+    if (isType)
+    {
+        auto found = this->mTypeHashes.find(DIE.getOffset());
+        if (found != this->mTypeHashes.end())
+            return found->second;
+    }
+
+    const size_t depth = visiting.size();
+    size_t       backRef = SIZE_MAX;
+    visiting.push_back(DIE.getOffset());
+
+    uint64_t hash = dw::hashCombine('D', tag);
+    for (uint16_t attrType : hashedAttrs)
+    {
+        const dw::attr *attr = DIE.findAttrByType(attrType);
+        if (!attr)
+            continue;
+        uint64_t value = 0;
+        if (attr->index() == dw::attr::string)
+            value = dw::hashString(attr->get<std::string_view>());
+        else if (attr->index() == dw::attr::exprloc)
+        {
+            dw::LocList ops = attr->get<dw::LocList>();
+            value = ops.size();
+            for (auto &&op : ops)
+                value = dw::hashCombine(dw::hashCombine(dw::hashCombine(value, op.op), op.opd1), op.opd2);
+        }
+        else
+            value = attr->getValueAsInt<uint64_t>();
+        hash = dw::hashCombine(dw::hashCombine(hash, 'A' + (uint64_t(attrType) << 8)), value);
+    }
+
+    // pointers and references to named types are hashed by name, which also breaks most cycles
+    const bool refByName = tag == DW_TAG_pointer_type || tag == DW_TAG_reference_type ||
+                           tag == DW_TAG_rvalue_reference_type || tag == DW_TAG_ptr_to_member_type ||
+                           tag == DW_TAG_friend;
+    if (const dw::attr *typeAttr = DIE.findAttrByType(DW_AT_type))
+        hash = dw::hashCombine(dw::hashCombine(hash, 'T'),
+                               this->_hashTypeRef(typeAttr->get<uint64_t>(), refByName, visiting, backRef));
+    if (const dw::attr *containingType = DIE.findAttrByType(DW_AT_containing_type))
+        hash = dw::hashCombine(dw::hashCombine(hash, 'P'),
+                               this->_hashTypeRef(containingType->get<uint64_t>(), true, visiting, backRef));
+
+    if (DIE.hasChild())
+    {
+        for (auto &&child : DIE.getChildren(*this))
+        {
+            // member functions only contribute their name and vtable slot
+            if (child.getTAG() == DW_TAG_subprogram)
+            {
+                const dw::attr *virtuality = child.findAttrByType(DW_AT_virtuality);
+                const dw::attr *vtableLoc = child.findAttrByType(DW_AT_vtable_elem_location);
+                hash = dw::hashCombine(dw::hashCombine(hash, 'S'), dw::hashString(child.getName()));
+                if (virtuality)
+                    hash = dw::hashCombine(hash, virtuality->getValueAsInt<uint64_t>());
+                if (vtableLoc && !vtableLoc->get<dw::LocList>().empty())
+                    hash = dw::hashCombine(hash, vtableLoc->get<dw::LocList>()[0].opd1);
+                continue;
+            }
+            hash = dw::hashCombine(dw::hashCombine(hash, 'C'), this->_typeHash(child, visiting, backRef));
+        }
+    }
+
+    visiting.pop_back();
+    // a hash that refers back to an enclosing type depends on where we started, don't memoize it
+    if (backRef < depth)
+        lowestBackRef = std::min(lowestBackRef, backRef);
+    else if (isType)
+        this->mTypeHashes.emplace(DIE.getOffset(), hash);
+    return hash;
+}
+
+inline uint64_t dw::file::_hashTypeRef(uint64_t offset, bool byName, std::vector<uint64_t> &visiting, size_t &lowestBackRef)
+{
+    auto onStack = std::find(visiting.begin(), visiting.end(), offset);
+    if (onStack != visiting.end())
+    {
+        size_t idx = onStack - visiting.begin();
+        lowestBackRef = std::min(lowestBackRef, idx);
+        return dw::hashCombine('R', visiting.size() - idx);
+    }
+
+    const dw::die *target = this->findDIEbyOffset(offset);
+    if (!target)
+        return dw::hashCombine('U', 0);
+
+    std::string_view name = target->getName();
+    if (byName && !name.empty())
+        return dw::hashCombine(dw::hashCombine('N', this->_hashScope(*target)), dw::hashString(name));
+    return this->_typeHash(*target, visiting, lowestBackRef);
+}
+
+inline uint64_t dw::file::_hashScope(const dw::die &DIE) const
+{
+    uint64_t hash = 0;
+    for (const dw::die *parent = DIE.getParentDIE(); parent; parent = parent->getParentDIE())
+    {
+        switch (parent->getTAG())
+        {
+        case DW_TAG_namespace:
+        case DW_TAG_class_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_union_type:
+        case DW_TAG_enumeration_type:
+        case DW_TAG_subprogram:
+            hash = dw::hashCombine(dw::hashCombine(hash, 'C'), dw::hashString(parent->getName()));
+            break;
+        default:
+            break;
+        }
+    }
+    return hash;
+}
+
+inline void dw::file::_collectTypeHashes(const dw::die &scope, std::unordered_map<uint64_t, uint64_t> &out)
+{
+    if (!scope.hasChild())
+        return;
+
+    for (auto &&child : scope.getChildren(*this))
+        this->_collectTypeHash(child, out);
+}
+
+inline void dw::file::_collectTypeHash(const dw::die &DIE, std::unordered_map<uint64_t, uint64_t> &out)
+{
+    uint16_t tag = DIE.getTAG();
+    if (dw::isTypeTag(tag))
+        out.emplace(DIE.getOffset(), this->typeHash(DIE));
+
+    switch (tag)
+    {
+    case DW_TAG_namespace:
+    case DW_TAG_class_type:
+    case DW_TAG_structure_type:
+    case DW_TAG_union_type:
+    case DW_TAG_lexical_block:
+    case DW_TAG_subprogram:
+        this->_collectTypeHashes(DIE, out);
+        break;
+    default:
+        break;
+    }
 }
 
 inline Dwarf_Die dw::file::_getRawDieByOffset(const uint64_t &offset)
@@ -403,6 +1010,8 @@ inline Dwarf_Die dw::file::_getRawDieByOffset(const uint64_t &offset)
     int         res = dwarf_offdie_b(this->mRawDbg, offset, 0, &retDie, &err);
     if (res != DW_DLV_OK)
         res = dwarf_offdie_b(this->mRawDbg, offset, 1, &retDie, &err);
+    if (this->mStats)
+        this->mStats->count(dw::dwarfCall::offdie, res == DW_DLV_OK ? 1 : 2);
     if (res != DW_DLV_OK)
         return nullptr;
     return retDie;
@@ -410,7 +1019,7 @@ inline Dwarf_Die dw::file::_getRawDieByOffset(const uint64_t &offset)
 
 /* ====================================================================================== */
 
-inline dw::die::die(Dwarf_Die raw_die, dw::die *parent, dw::file *file)
+inline dw::die::die(Dwarf_Die raw_die, dw::die *parent, dw::file *file, bool decodeAttrs)
 {
     this->mParent = parent;
 
@@ -424,7 +1033,21 @@ inline dw::die::die(Dwarf_Die raw_die, dw::die *parent, dw::file *file)
     dwarf_tag(raw_die, &tagType, 0);
     this->mTAG = tagType;
 
+    if (!decodeAttrs)
+    {
+        // pruned stub, only what `_initAttrs` gets from the abbrev
+        Dwarf_Half hasChildren = 0;
+        dwarf_die_abbrev_children_flag(raw_die, &hasChildren);
+        this->mHasChildren = hasChildren != 0;
+        this->mPruned = true;
+        if (file && file->mStats)
+            ++file->mStats->stubs;
+        return;
+    }
     this->_initAttrs(raw_die, file);
+    this->_indexCommonAttrs();
+    if (file && file->mStats)
+        ++file->mStats->decoded;
 }
 
 inline dw::die::die(dw::die &&die) noexcept
@@ -433,21 +1056,78 @@ inline dw::die::die(dw::die &&die) noexcept
     this->mTAG = die.mTAG;
     this->mParent = die.mParent;
     this->mHasChildren = die.mHasChildren;
+    this->mCommonIndexed = die.mCommonIndexed;
+    this->mCommonMask = die.mCommonMask;
+    this->mCommonSlots = die.mCommonSlots;
+    this->mPruned = die.mPruned;
+    this->mPrunedCount = die.mPrunedCount;
     this->mAttrs = std::move(die.mAttrs);
     this->mChildren = std::move(die.mChildren);
 }
 
 inline std::vector<dw::die> &dw::die::getChildren(dw::file &dwFile)
 {
+    this->_loadChildren(dwFile);
+    if (this->mPrunedCount)
+    {
+        for (auto &&child : this->mChildren)
+        {
+            if (child.mPruned)
+                child._decodePruned(dwFile);
+        }
+    }
+    return this->mChildren;
+}
+
+template <typename Prune>
+inline std::vector<dw::die> &dw::die::getChildren(dw::file &dwFile, Prune &&prune)
+{
+    if (dwFile.mStats && !dwFile.mStats->inLookup && this->isCompileUnit())
+        dwFile.mStats->activeCU = this->mOffset;
     if (this->mHasChildren && this->mChildren.empty())
     {
         Dwarf_Die raw_die = dwFile._getRawDieByOffset(this->mOffset);
-        this->_initChildren(raw_die, dwFile);
+        this->_initChildren(raw_die, dwFile, prune);
         dwarf_dealloc_die(raw_die);
     }
     return this->mChildren;
 }
 
+inline std::vector<dw::die> &dw::die::_loadChildren(dw::file &dwFile)
+{
+    return this->getChildren(dwFile, [](const dw::rawDIE &) { return false; });
+}
+
+inline std::span<dw::die> dw::die::getChildRange(dw::file &dwFile, size_t begin, size_t end)
+{
+    if (begin == 0 && end == SIZE_MAX)
+        return this->getChildren(dwFile);
+
+    auto &children = this->getChildren(dwFile, [](const dw::rawDIE &) { return true; });
+    end = std::min(end, children.size());
+    begin = std::min(begin, end);
+    for (size_t idx = begin; idx < end; idx++)
+    {
+        if (children[idx].mPruned)
+            children[idx]._decodePruned(dwFile);
+    }
+    return {children.begin() + begin, children.begin() + end};
+}
+
+inline void dw::die::_decodePruned(dw::file &dwFile)
+{
+    memory::tag memTag{memory::category::dieTree};
+    Dwarf_Die   raw_die = dwFile._getRawDieByOffset(this->mOffset);
+    this->_initAttrs(raw_die, &dwFile);
+    this->_indexCommonAttrs();
+    dwarf_dealloc_die(raw_die);
+    this->mPruned = false;
+    if (this->mParent)
+        --this->mParent->mPrunedCount;
+    if (dwFile.mStats)
+        ++dwFile.mStats->decoded;
+}
+
 inline std::vector<dw::die> &dw::die::getChildren(dw::file &dwFile) const
 {
     return const_cast<dw::die *>(this)->getChildren(dwFile);
@@ -458,11 +1138,14 @@ inline const std::vector<std::string> &dw::CU::getSrcfiles(dw::file &dwFile)
     char **declFiles = nullptr;
     if (!this->mSrcfiles.empty())
         return this->mSrcfiles;
+    memory::tag memTag{memory::category::srcFiles};
 
     std::vector<std::string> files;
     Dwarf_Signed             fileCount;
     int                      res = dwarf_srcfiles(dwFile._getRawDieByOffset(this->getOffset()),
                                                   &declFiles, &fileCount, nullptr);
+    if (dwFile.mStats)
+        dwFile.mStats->count(dw::dwarfCall::srcfiles);
     if (res == DW_DLV_OK)
     {
         this->mSrcfiles.reserve(fileCount);
@@ -484,6 +1167,8 @@ inline dw::linetable &dw::CU::getLineTable(dw::file &dwFile)
     Dwarf_Error        error;
     int                res = dwarf_srclines_b(dwFile._getRawDieByOffset(this->getOffset()),
                                               &version, &count, &context, &error);
+    if (dwFile.mStats)
+        dwFile.mStats->count(dw::dwarfCall::srclines);
     this->mLineTable = dw::linetable(context, version);
     return this->mLineTable;
 }
@@ -495,51 +1180,104 @@ inline dw::linetable &dw::CU::getLineTable(dw::file &dwFile) const
 
 inline const dw::attr *dw::die::findAttrByOffset(uint64_t off) const noexcept
 {
-    auto found = std::find(this->mAttrs.begin(), this->mAttrs.end(), off);
-    return found == this->mAttrs.end() ? nullptr : &*found;
+    // attributes are stored in the order they appear in .debug_info
+    auto found = std::lower_bound(this->mAttrs.begin(), this->mAttrs.end(), off,
+                                  [](const dw::attr &a, uint64_t b) -> bool { return a.getOffset() < b; });
+    return found == this->mAttrs.end() || found->getOffset() != off ? nullptr : &*found;
 }
 
 inline const dw::attr *dw::die::findAttrByType(uint16_t type) const noexcept
 {
+    size_t slot = dw::commonAttrSlot(type);
+    if (slot < dw::commonAttrCount && this->mCommonIndexed)
+        return (this->mCommonMask >> slot) & 1 ? &this->mAttrs[this->mCommonSlots[slot]] : nullptr;
+
     auto found = std::find(this->mAttrs.begin(), this->mAttrs.end(), type);
     return found == this->mAttrs.end() ? nullptr : &*found;
 }
 
+inline dw::exprArena &dw::die::_exprArena(dw::file *file) noexcept
+{
+    // a CU is still being constructed while its own attributes are decoded, those go to the file
+    for (dw::die *iter = this->mParent; iter; iter = iter->mParent)
+    {
+        if (iter->isCompileUnit())
+            return static_cast<dw::CU *>(iter)->mExprArena;
+    }
+    return file->mExprArena;
+}
+
+inline void dw::die::_indexCommonAttrs() noexcept
+{
+    this->mCommonMask = 0;
+    this->mCommonIndexed = this->mAttrs.size() <= UINT8_MAX;
+    if (!this->mCommonIndexed)
+        return;
+
+    for (size_t idx = 0; idx < this->mAttrs.size(); idx++)
+    {
+        size_t slot = dw::commonAttrSlot(this->mAttrs[idx].getType());
+        if (slot == dw::commonAttrCount || (this->mCommonMask >> slot) & 1)
+            continue;
+        this->mCommonMask |= uint16_t(1u << slot);
+        this->mCommonSlots[slot] = static_cast<uint8_t>(idx);
+    }
+}
+
 inline const dw::attr *dw::die::findAttrByName(const std::string &name) const noexcept
 {
     auto found = std::find(this->mAttrs.begin(), this->mAttrs.end(), name);
     return found == this->mAttrs.end() ? nullptr : &*found;
 }
 
-inline std::vector<dw::die>::iterator dw::die::_findChildByOffset(uint64_t offset, dw::file &dwFile)
+inline dw::die *dw::die::_findChildByOffset(uint64_t offset, dw::file &dwFile)
 {
-    auto &children = this->getChildren(dwFile);
+    auto &children = this->_loadChildren(dwFile);
     auto  it = std::upper_bound(children.begin(), children.end(), offset,
                                 [](const uint64_t &a, const dw::die &b) -> bool { return a < b.getOffset(); });
+    if (it == children.begin())
+        return nullptr;
     --it;
-    if (it->getOffset() == offset)
-        return it;
 
-    std::vector<dw::die> &childlist = it->getChildren(dwFile);
-    auto                  found = it->_findChildByOffset(offset, dwFile);
-    if (found == childlist.end())
-        return this->mChildren.end();
-    return found;
+    // the dies on the way down are decoded too, name scopes are built from the parents
+    if (it->mPruned)
+        it->_decodePruned(dwFile);
+    if (it->getOffset() == offset)
+        return &*it;
+    return it->_findChildByOffset(offset, dwFile);
 }
 
-inline void dw::die::_initChildren(Dwarf_Die raw_die, dw::file &dwFile)
+template <typename Prune>
+inline void dw::die::_initChildren(Dwarf_Die raw_die, dw::file &dwFile, Prune &&prune)
 {
     if (!this->mHasChildren || !this->mChildren.empty())
         return;
 
-    Dwarf_Die raw_iter_child, raw_siblingdie;
+    memory::tag memTag{memory::category::dieTree};
+    Dwarf_Die   raw_iter_child, raw_siblingdie;
     for (int res = dwarf_child(raw_die, &raw_iter_child, nullptr); res == DW_DLV_OK;)
     {
-        this->mChildren.emplace_back(raw_iter_child, this, &dwFile);
+        if (prune(dw::rawDIE{raw_iter_child}))
+        {
+            this->mChildren.emplace_back(raw_iter_child, this, &dwFile, false);
+            ++this->mPrunedCount;
+        }
+        else
+            this->mChildren.emplace_back(raw_iter_child, this, &dwFile);
         res = dwarf_siblingof_c(raw_iter_child, &raw_siblingdie, 0);
         dwarf_dealloc_die(raw_iter_child);
         raw_iter_child = raw_siblingdie;
     }
+
+    if (dw::fileStats *stats = dwFile.mStats.get())
+    {
+        ++stats->childLoads;
+        stats->lookupLoads += stats->inLookup;
+        stats->count(dw::dwarfCall::child);
+        stats->count(dw::dwarfCall::siblingof, this->mChildren.size());
+        if (!stats->loadedParents.insert(this->mOffset).second)
+            stats->reDecoded += this->mChildren.size();
+    }
 }
 
 inline void dw::die::_initAttrs(Dwarf_Die raw_die, dw::file *file)
@@ -551,6 +1289,8 @@ inline void dw::die::_initAttrs(Dwarf_Die raw_die, dw::file *file)
     dwarf_die_abbrev_children_flag(raw_die, &hasChildren);
     this->mHasChildren = hasChildren != 0;
     int res = dwarf_attrlist(raw_die, &attrList, &attrCount, &err);
+    if (file && file->mStats)
+        file->mStats->count(dw::dwarfCall::attrlist);
     if (res != DW_DLV_OK || !attrCount)
         return;
 
@@ -560,6 +1300,11 @@ inline void dw::die::_initAttrs(Dwarf_Die raw_die, dw::file *file)
         Dwarf_Half attrForm;
         Dwarf_Off  attrOffset;
         dwarf_whatattr(attrList[attrIdx], &attrType, nullptr);
+        if (file->mDecodedAttrs && (attrType >= file->mDecodedAttrs->size() || !file->mDecodedAttrs->test(attrType)))
+        {
+            dwarf_dealloc_attribute(attrList[attrIdx]);
+            continue;
+        }
         dwarf_attr_offset(raw_die, attrList[attrIdx], &attrOffset, nullptr);
         dwarf_whatform(attrList[attrIdx], &attrForm, &err);
         if (attrType == DW_AT_low_pc)
@@ -706,23 +1451,18 @@ inline void dw::die::_initAttrs(Dwarf_Die raw_die, dw::file *file)
                 dwarf_dealloc_loc_head_c(loclist_head);
                 break;
             }
-            int     opres = 0;
-            LocList loclist;
-            loclist.reserve(loclist_expr_op_count);
-            for (size_t idx = 0; idx < loclist_expr_op_count; idx++)
+            std::span<LocationOp> ops = this->_exprArena(file).allocate(loclist_expr_op_count);
+            size_t                opCount = 0;
+            for (; opCount < ops.size(); opCount++)
             {
-                LocationOp     locOp;
+                LocationOp    &locOp = ops[opCount];
                 Dwarf_Unsigned offsetforbranch = 0;
-                res = dwarf_get_location_op_value_c(locdesc_entry, idx, &locOp.op, &locOp.opd1,
+                res = dwarf_get_location_op_value_c(locdesc_entry, opCount, &locOp.op, &locOp.opd1,
                                                     &locOp.opd2, &locOp.opd3, &offsetforbranch, &err);
                 if (res != DW_DLV_OK)
-                {
-                    dwarf_dealloc_loc_head_c(loclist_head);
                     break;
-                }
-                loclist.emplace_back(locOp);
             }
-            this->mAttrs.emplace_back(attrOffset, std::move(loclist), attrType, attrForm);
+            this->mAttrs.emplace_back(attrOffset, dw::LocList{ops.data(), opCount}, attrType, attrForm);
             dwarf_dealloc_loc_head_c(loclist_head);
             break;
         }
@@ -1,5 +1,7 @@
 #pragma once
 #include <libdwarf/libdwarf.h>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -31,6 +33,55 @@ namespace dw
         }
     };
 
-    using LocList = std::vector<LocationOp>;
+    // a location expression, the ops live in the `exprArena` of the CU that decoded them
+    using LocList = std::span<const LocationOp>;
+
+    /**
+     * @brief chunked storage for the location expressions of one CU, released all at once
+     */
+    class exprArena
+    {
+        static constexpr size_t chunkSize = 4096 / sizeof(LocationOp);
+
+        std::vector<std::unique_ptr<LocationOp[]>> mChunks;
+        size_t                                     mUsed = chunkSize; // ops used in the last chunk
+
+    public:
+        /**
+         * @return `count` default constructed ops, stable until `reset`
+         */
+        std::span<LocationOp> allocate(size_t count)
+        {
+            if (count == 0)
+                return {};
+            if (count > chunkSize)
+            {
+                // dedicated chunk, keep the current one at the back for the small requests
+                auto chunk = std::make_unique<LocationOp[]>(count);
+                std::span<LocationOp> ret{chunk.get(), count};
+                this->mChunks.insert(this->mChunks.empty() ? this->mChunks.end() : this->mChunks.end() - 1, std::move(chunk));
+                return ret;
+            }
+            if (this->mUsed + count > chunkSize)
+            {
+                this->mChunks.emplace_back(std::make_unique<LocationOp[]>(chunkSize));
+                this->mUsed = 0;
+            }
+            std::span<LocationOp> ret{this->mChunks.back().get() + this->mUsed, count};
+            this->mUsed += count;
+            return ret;
+        }
+
+        void reset() noexcept
+        {
+            this->mChunks.clear();
+            this->mUsed = chunkSize;
+        }
+
+        size_t chunkCount() const noexcept
+        {
+            return this->mChunks.size();
+        }
+    };
 
 } // namespace dw
\ No newline at end of file
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <mutex>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <Trace.hpp>
+
+namespace dw
+{
+    /**
+     * @brief resolve how many workers to start for `itemCount` items
+     * @param requested 0 means `std::thread::hardware_concurrency()`
+     */
+    inline unsigned workerCount(unsigned requested, size_t itemCount)
+    {
+        if (requested == 0)
+            requested = std::max(1u, std::thread::hardware_concurrency());
+        return static_cast<unsigned>(std::clamp<size_t>(itemCount, 1, requested));
+    }
+
+    /**
+     * @brief run `fn(workerIdx, itemIdx)` for every item in [0, itemCount)
+     *
+     * Items are handed out one by one from a shared counter, so a worker that finishes early
+     * picks up the next item. Worker 0 runs on the calling thread. A given `workerIdx` is only
+     * ever used by one thread, so per-worker state can be indexed by it without locking.
+     *
+     * @param threadCount number of workers, as returned by `workerCount`
+     */
+    template <typename Fn>
+    void parallelFor(size_t itemCount, unsigned threadCount, Fn &&fn)
+    {
+        std::atomic<size_t> next = 0;
+        auto                worker = [&](unsigned workerIdx) {
+            if (workerIdx != 0)
+                trace::setThreadName(std::format("worker {}", workerIdx));
+            for (size_t itemIdx = next++; itemIdx < itemCount; itemIdx = next++)
+                fn(workerIdx, itemIdx);
+        };
+
+        std::vector<std::jthread> threads;
+        threads.reserve(threadCount);
+        for (unsigned workerIdx = 1; workerIdx < threadCount; workerIdx++)
+            threads.emplace_back(worker, workerIdx);
+        worker(0);
+    }
+
+    /**
+     * @brief one task of `schedule`: a whole CU, or its top-level children in [childBegin, childEnd),
+     *        see `file::planTasks` and `die::getChildRange`
+     */
+    struct cuTask
+    {
+        size_t   cuIdx;
+        uint64_t bytes;               // .debug_info covered, the weight the tasks are ordered by
+        size_t   childBegin = 0;
+        size_t   childEnd = SIZE_MAX; // SIZE_MAX: up to the last child
+
+        bool isWhole() const noexcept
+        {
+            return this->childBegin == 0 && this->childEnd == SIZE_MAX;
+        }
+    };
+
+    // smaller CUs are never split, cutting them costs more than the imbalance they can cause
+    inline constexpr uint64_t minSplitBytes = 1 << 20;
+
+    /**
+     * @brief size of the parts a giant CU is cut into: a quarter of the even share of one worker
+     * @return 0 means no CU is split
+     */
+    inline uint64_t splitBytes(uint64_t totalBytes, unsigned threadCount)
+    {
+        if (threadCount <= 1)
+            return 0;
+        return std::max<uint64_t>(totalBytes / (threadCount * 4ull), minSplitBytes);
+    }
+
+    struct workerLoad
+    {
+        uint64_t busyNs = 0; // inside the task function
+        uint64_t tasks = 0;
+        uint64_t stolen = 0; // tasks taken from another worker's queue
+        uint64_t bytes = 0;
+    };
+
+    /**
+     * @brief the worker loads of every `schedule` call, only collected while enabled
+     */
+    class scheduleRegistry
+    {
+        struct run
+        {
+            std::string             label;
+            uint64_t                wallNs;
+            size_t                  tasks;
+            size_t                  splitCUs;
+            std::vector<workerLoad> loads;
+        };
+
+        std::atomic<bool> mEnabled = false;
+        std::mutex        mMutex;
+        std::vector<run>  mRuns;
+
+    public:
+        static scheduleRegistry &get()
+        {
+            static scheduleRegistry instance;
+            return instance;
+        }
+
+        void enable() noexcept
+        {
+            this->mEnabled = true;
+        }
+
+        bool enabled() const noexcept
+        {
+            return this->mEnabled.load(std::memory_order_relaxed);
+        }
+
+        void add(std::string_view label, uint64_t wallNs, size_t tasks, size_t splitCUs, std::vector<workerLoad> loads)
+        {
+            std::lock_guard lock{this->mMutex};
+            this->mRuns.push_back({std::string{label}, wallNs, tasks, splitCUs, std::move(loads)});
+        }
+
+        void report()
+        {
+            std::lock_guard lock{this->mMutex};
+            for (auto &&item : this->mRuns)
+            {
+                uint64_t busyNs = 0;
+                for (auto &&load : item.loads)
+                    busyNs += load.busyNs;
+                auto utilization = [&](uint64_t ns) { return item.wallNs ? ns * 100.0 / item.wallNs : 0.0; };
+                std::println("[Sched] {}: {} workers, {} tasks ({} CUs split), wall {:.3f} ms, utilization {:.1f}%", item.label,
+                             item.loads.size(), item.tasks, item.splitCUs, item.wallNs / 1e6,
+                             utilization(busyNs) / std::max<size_t>(item.loads.size(), 1));
+                std::println("[Sched] {:>8} {:>12} {:>8} {:>8} {:>8} {:>12}", "worker", "busy ms", "util", "tasks", "stolen", "MiB");
+                for (size_t idx = 0; idx < item.loads.size(); idx++)
+                {
+                    const workerLoad &load = item.loads[idx];
+                    std::println("[Sched] {:>8} {:>12.3f} {:>7.1f}% {:>8} {:>8} {:>12.2f}", idx, load.busyNs / 1e6, utilization(load.busyNs),
+                                 load.tasks, load.stolen, load.bytes / (1024.0 * 1024.0));
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief collect worker loads for the enclosing scope (e.g. `main`) and print them when leaving it
+     */
+    class scheduleReport
+    {
+        bool mEnabled;
+
+    public:
+        explicit scheduleReport(bool enable) :
+            mEnabled(enable)
+        {
+            if (this->mEnabled)
+                scheduleRegistry::get().enable();
+        }
+
+        ~scheduleReport()
+        {
+            if (this->mEnabled)
+                scheduleRegistry::get().report();
+        }
+    };
+
+    /**
+     * @brief run `fn(workerIdx, task)` for every task, largest first
+     *
+     * The tasks are dealt out by size, each to the worker with the fewest bytes so far, into one queue
+     * per worker. A worker takes the largest task of its own queue; once that is empty it steals the
+     * largest task queued by the worker with the most bytes left, so a giant CU still waiting behind a
+     * busy worker moves instead of the small ones. Worker 0 runs on the calling thread and a `workerIdx`
+     * is only used by one thread, as with `parallelFor`.
+     *
+     * @param label names the run in the `scheduleRegistry` report
+     * @param threadCount number of workers, as returned by `workerCount`
+     * @return the load of every worker
+     */
+    template <typename Fn>
+    std::vector<workerLoad> schedule(std::string_view label, std::vector<cuTask> tasks, unsigned threadCount, Fn &&fn)
+    {
+        struct taskQueue
+        {
+            std::mutex            mutex;
+            std::deque<cuTask>    tasks;
+            std::atomic<size_t>   pendingTasks = 0;
+            std::atomic<uint64_t> pendingBytes = 0;
+        };
+
+        threadCount = std::max(threadCount, 1u);
+        std::stable_sort(tasks.begin(), tasks.end(), [](const cuTask &a, const cuTask &b) { return a.bytes > b.bytes; });
+        std::vector<taskQueue> queues(threadCount);
+        std::vector<uint64_t>  dealt(threadCount, 0);
+        for (auto &&task : tasks)
+        {
+            size_t target = std::min_element(dealt.begin(), dealt.end()) - dealt.begin();
+            dealt[target] += task.bytes;
+            queues[target].tasks.push_back(task);
+            ++queues[target].pendingTasks;
+            queues[target].pendingBytes += task.bytes;
+        }
+
+        auto take = [](taskQueue &queue, cuTask &out) {
+            std::lock_guard lock{queue.mutex};
+            if (queue.tasks.empty())
+                return false;
+            out = queue.tasks.front();
+            queue.tasks.pop_front();
+            --queue.pendingTasks;
+            queue.pendingBytes -= out.bytes;
+            return true;
+        };
+
+        // no task is added once started, so all queues empty means done
+        auto steal = [&](cuTask &out) {
+            while (true)
+            {
+                taskQueue *victim = nullptr;
+                for (auto &&queue : queues)
+                {
+                    if (queue.pendingTasks.load(std::memory_order_relaxed) &&
+                        (!victim || queue.pendingBytes.load(std::memory_order_relaxed) > victim->pendingBytes.load(std::memory_order_relaxed)))
+                        victim = &queue;
+                }
+                if (!victim)
+                    return false;
+                if (take(*victim, out))
+                    return true;
+            }
+        };
+
+        std::vector<workerLoad> loads(threadCount);
+        auto                    worker = [&](unsigned workerIdx) {
+            if (workerIdx != 0)
+                trace::setThreadName(std::format("worker {}", workerIdx));
+            workerLoad &load = loads[workerIdx];
+            cuTask      task;
+            while (true)
+            {
+                bool stolen = false;
+                if (!take(queues[workerIdx], task))
+                {
+                    if (!steal(task))
+                        break;
+                    stolen = true;
+                }
+                uint64_t beginNs = trace::nowNs();
+                fn(workerIdx, task);
+                load.busyNs += trace::nowNs() - beginNs;
+                load.bytes += task.bytes;
+                ++load.tasks;
+                load.stolen += stolen;
+            }
+        };
+
+        uint64_t beginNs = trace::nowNs();
+        {
+            std::vector<std::jthread> threads;
+            threads.reserve(threadCount - 1);
+            for (unsigned workerIdx = 1; workerIdx < threadCount; workerIdx++)
+                threads.emplace_back(worker, workerIdx);
+            worker(0);
+        }
+        uint64_t wallNs = trace::nowNs() - beginNs;
+
+        if (scheduleRegistry::get().enabled())
+        {
+            std::unordered_set<size_t> splitCUs;
+            for (auto &&task : tasks)
+            {
+                if (!task.isWhole())
+                    splitCUs.insert(task.cuIdx);
+            }
+            scheduleRegistry::get().add(label, wallNs, tasks.size(), splitCUs.size(), loads);
+        }
+        return loads;
+    }
+
+} // namespace dw
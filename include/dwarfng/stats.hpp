@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <mutex>
+#include <print>
+#include <string>
+#include <unordered_set>
+
+namespace dw
+{
+    // the libdwarf entry points counted by `fileStats::calls`
+    enum class dwarfCall : uint8_t
+    {
+        offdie,
+        child,
+        siblingof,
+        attrlist,
+        srcfiles,
+        srclines,
+        count
+    };
+
+    inline constexpr std::array<const char *, size_t(dwarfCall::count)> dwarfCallNames{
+        "dwarf_offdie_b", "dwarf_child", "dwarf_siblingof_c", "dwarf_attrlist", "dwarf_srcfiles", "dwarf_srclines_b"};
+
+    /**
+     * @brief where the dies of one `dw::file` were materialized, only collected while `statsRegistry` is enabled
+     */
+    struct fileStats
+    {
+        static constexpr size_t depthBuckets = 16; // the last bucket counts everything deeper
+
+        uint64_t decoded = 0;     // dies with their attributes decoded, pruned stubs decoded later included
+        uint64_t stubs = 0;       // pruned stubs, see `die::getChildren(dwFile, prune)`
+        uint64_t reDecoded = 0;   // children decoded again after their parent's cache was dropped
+        uint64_t childLoads = 0;  // child vectors materialized
+        uint64_t evictions = 0;   // CU caches dropped while holding children
+        uint64_t lookups = 0;     // `file::findDIEbyOffset` calls
+        uint64_t lookupLoads = 0; // child vectors materialized by those lookups
+        uint64_t crossCUHops = 0; // lookups landing outside the CU being traversed
+        uint64_t evictedHits = 0; // lookups into a CU whose cache had been dropped
+
+        std::array<uint64_t, depthBuckets>             lookupDepth{}; // depth of the found die below its CU
+        std::array<uint64_t, size_t(dwarfCall::count)> calls{};
+
+        // traversal state
+        std::unordered_set<uint64_t> loadedParents; // offsets of the dies whose children were ever materialized
+        uint64_t                     activeCU = UINT64_MAX;
+        bool                         inLookup = false;
+
+        void count(dwarfCall call, uint64_t times = 1) noexcept
+        {
+            this->calls[size_t(call)] += times;
+        }
+
+        void merge(const fileStats &other) noexcept
+        {
+            this->decoded += other.decoded;
+            this->stubs += other.stubs;
+            this->reDecoded += other.reDecoded;
+            this->childLoads += other.childLoads;
+            this->evictions += other.evictions;
+            this->lookups += other.lookups;
+            this->lookupLoads += other.lookupLoads;
+            this->crossCUHops += other.crossCUHops;
+            this->evictedHits += other.evictedHits;
+            for (size_t idx = 0; idx < depthBuckets; idx++)
+                this->lookupDepth[idx] += other.lookupDepth[idx];
+            for (size_t idx = 0; idx < this->calls.size(); idx++)
+                this->calls[idx] += other.calls[idx];
+        }
+    };
+
+    /**
+     * @brief totals of every `dw::file` closed so far, worker files included
+     */
+    class statsRegistry
+    {
+        std::atomic<bool> mEnabled = false;
+        std::mutex        mMutex;
+        fileStats         mTotal;
+        uint32_t          mFiles = 0;
+
+    public:
+        static statsRegistry &get()
+        {
+            static statsRegistry instance;
+            return instance;
+        }
+
+        // only the files opened afterwards are counted
+        void enable() noexcept
+        {
+            this->mEnabled = true;
+        }
+
+        bool enabled() const noexcept
+        {
+            return this->mEnabled.load(std::memory_order_relaxed);
+        }
+
+        void add(const fileStats &stats)
+        {
+            std::lock_guard lock{this->mMutex};
+            this->mTotal.merge(stats);
+            ++this->mFiles;
+        }
+
+        void report()
+        {
+            std::lock_guard  lock{this->mMutex};
+            const fileStats &total = this->mTotal;
+            auto             percent = [](uint64_t part, uint64_t whole) { return whole ? part * 100.0 / whole : 0.0; };
+            std::println("[DIE] {} files, {} dies decoded, {} pruned stubs", this->mFiles, total.decoded, total.stubs);
+            std::println("[DIE] {} child loads, {} CU evictions, {} dies re-decoded after eviction ({:.1f}%)", total.childLoads,
+                         total.evictions, total.reDecoded, percent(total.reDecoded, total.decoded));
+            std::println("[DIE] findDIEbyOffset: {} lookups, {} cross-CU hops, {} into evicted CUs, {} child loads", total.lookups,
+                         total.crossCUHops, total.evictedHits, total.lookupLoads);
+            if (total.lookups)
+            {
+                std::string histogram;
+                for (size_t idx = 0; idx < fileStats::depthBuckets; idx++)
+                {
+                    if (total.lookupDepth[idx])
+                        histogram += std::format(" {}{}:{}", idx, idx + 1 == fileStats::depthBuckets ? "+" : "", total.lookupDepth[idx]);
+                }
+                std::println("[DIE] lookup depth below the CU:{}", histogram);
+            }
+            std::string calls;
+            for (size_t idx = 0; idx < total.calls.size(); idx++)
+                calls += std::format(" {} {}", dwarfCallNames[idx], total.calls[idx]);
+            std::println("[DIE] libdwarf calls:{}", calls);
+        }
+    };
+
+    /**
+     * @brief collect die statistics for the enclosing scope (e.g. `main`) and print them when leaving it
+     */
+    class statsReport
+    {
+        bool mEnabled;
+
+    public:
+        explicit statsReport(bool enable) :
+            mEnabled(enable)
+        {
+            if (this->mEnabled)
+                statsRegistry::get().enable();
+        }
+
+        ~statsReport()
+        {
+            if (this->mEnabled)
+                statsRegistry::get().report();
+        }
+    };
+
+} // namespace dw
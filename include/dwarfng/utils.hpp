@@ -7,6 +7,7 @@
 #include <libdwarf/libdwarf.h>
 #include "cxxabi.h"
 #include <string>
+#include <string_view>
 #include <cstdint>
 
 namespace dw
@@ -43,6 +44,58 @@ namespace dw
         return tempStr;
     }
 
+    /**
+     * @brief whether `tag` describes a type, i.e. something `DW_AT_type` may point to
+     */
+    inline bool isTypeTag(uint16_t tag) noexcept
+    {
+        switch (tag)
+        {
+        case DW_TAG_base_type:
+        case DW_TAG_unspecified_type:
+        case DW_TAG_pointer_type:
+        case DW_TAG_reference_type:
+        case DW_TAG_rvalue_reference_type:
+        case DW_TAG_ptr_to_member_type:
+        case DW_TAG_const_type:
+        case DW_TAG_volatile_type:
+        case DW_TAG_restrict_type:
+        case DW_TAG_atomic_type:
+        case DW_TAG_typedef:
+        case DW_TAG_template_alias:
+        case DW_TAG_array_type:
+        case DW_TAG_subroutine_type:
+        case DW_TAG_structure_type:
+        case DW_TAG_class_type:
+        case DW_TAG_union_type:
+        case DW_TAG_enumeration_type:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // FNV-1a, used to fold strings into structural hashes
+    inline uint64_t hashString(std::string_view str) noexcept
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (unsigned char c : str)
+        {
+            hash ^= c;
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // order dependent combination of two hashes (splitmix64 finalizer)
+    inline uint64_t hashCombine(uint64_t seed, uint64_t value) noexcept
+    {
+        uint64_t x = seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
     std::string cxx_demangler(const std::string &symbol)
     {
         char *demangled;
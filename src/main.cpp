@@ -1,43 +1,206 @@
 #include <iostream>
 #include <dwarf2json/dwarf2json.hpp>
+#include <dwarf2json/abiDiff.hpp>
+#include <dwarf2json/layoutAnalyzer.hpp>
+#include <dwarf2json/headerEmitter.hpp>
+#include <dwarf2json/benchRunner.hpp>
 
-[[gnu::noinline]] void testMode(std::string_view inputFilePath, std::string_view filter, size_t id)
-{
-    dwarf2json d2j{inputFilePath};
-    int        code = d2j.start(filter);
+// upper bound of `-j`
+static constexpr unsigned long maxThreads = 1024;
+// upper bound of `--bench` and `--bench-warmup`
+static constexpr unsigned long maxBenchRuns = 100000;
 
-    if (code == -1)
+/**
+ * @brief 解析 [min, max] 范围内的非负整数, 拒绝负数, 多余字符和超出范围的值
+ */
+static bool parseCount(std::string_view arg, unsigned long min, unsigned long max, unsigned long &count)
+{
+    size_t parsed = 0;
+    try
     {
-        std::cerr << "Error: unable to open file: " << inputFilePath << '\n';
+        count = std::stoul(std::string{arg}, &parsed);
     }
-
-    if (d2j.dumpData() == -1)
-        std::cerr << "Error: unkown err when generating json\n";
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return !arg.empty() && arg.front() != '-' && parsed == arg.size() && count >= min && count <= max;
 }
 
 int main(int argc, char **argv)
 {
     using namespace std::string_literals;
-    if (argc < 2)
-    {
-        std::cerr << "Usage: dwarfInfoToheader <input file name> -f <filter> --test <num>\n";
-        return 1;
-    }
+    std::string_view inputFilePath = "";
+    declFilter       rules;
+    bool             defaultRules = true;
+    std::string      outPath = "out.json";
+    bool             outPathSet = false;
 
-    std::string_view inputFilePath = argv[1];
-    std::string_view filter = "";
-    bool             enableTestMode = false;
-    uint32_t         testLoopCount = 0;
-    for (int i = 2; i < argc; i++)
+    // -f <name>=<prefix> -o <file>: 多个输出共用一次解析
+    struct namedOutput
+    {
+        std::string path;
+        declFilter  filter;
+        bool        pathSet = false; // 已经由 -o 指定过路径
+    };
+    std::vector<namedOutput> outputs;
+    bool                 enableBench = false;
+    benchRunner::options benchOptions;
+    std::string_view diffOldPath = "";
+    std::string_view diffNewPath = "";
+    std::string_view layoutOutPath = "";
+    std::string_view headerOutDir = "";
+    unsigned         threadCount = 0;
+    std::string_view timerJsonPath = "";
+    std::string_view tracePath = "";
+    bool             memReport = false;
+    bool             dieStats = false;
+    bool             schedStats = false;
+    for (int i = 1; i < argc; i++)
     {
         if (argv[i] == "-f"s && i + 1 < argc)
         {
-            filter = argv[++i];
+            std::string_view arg = argv[++i];
+            if (size_t eq = arg.find('='); eq != std::string_view::npos)
+            {
+                outputs.push_back({std::format("{}.json", arg.substr(0, eq)), {}});
+                outputs.back().filter.addRule(declFilter::prefixRule(arg.substr(eq + 1)));
+                outputs.back().filter.compile();
+            }
+            else
+            {
+                rules.addRule(declFilter::prefixRule(arg));
+            }
+        }
+        else if (argv[i] == "-o"s && i + 1 < argc)
+        {
+            // 命名输出之后的 -o 属于该输出, 同一个输出给了两次 -o 时报错, 而不是悄悄覆盖
+            if (outputs.empty())
+            {
+                outPath = argv[++i];
+                outPathSet = true;
+            }
+            else if (outputs.back().pathSet)
+            {
+                std::cerr << "Error: -o " << argv[i + 1] << " follows a named -f whose output is already " << outputs.back().path
+                          << "; give the plain -o before the first named -f\n";
+                return 1;
+            }
+            else
+            {
+                outputs.back().path = argv[++i];
+                outputs.back().pathSet = true;
+            }
+        }
+        else if (argv[i] == "--rule"s && i + 1 < argc)
+        {
+            if (!rules.addRule(argv[++i]))
+            {
+                std::cerr << "Invalid rule: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (argv[i] == "--rules"s && i + 1 < argc)
+        {
+            if (int line = rules.addRulesFromFile(argv[++i]); line != 0)
+            {
+                if (line == -1)
+                    std::cerr << "Error: unable to open file: " << argv[i] << '\n';
+                else
+                    std::cerr << "Invalid rule at " << argv[i] << ':' << line << '\n';
+                return 1;
+            }
+        }
+        else if (argv[i] == "--no-default-rules"s)
+        {
+            defaultRules = false;
+        }
+        else if (argv[i] == "--bench"s && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            unsigned long    count = 0;
+            if (!parseCount(arg, 1, maxBenchRuns, count))
+            {
+                std::cerr << "Invalid iteration count: " << arg << " (1 to " << maxBenchRuns << ")\n";
+                return 1;
+            }
+            enableBench = true;
+            benchOptions.iterations = static_cast<uint32_t>(count);
+        }
+        else if (argv[i] == "--bench-warmup"s && i + 1 < argc)
+        {
+            std::string_view arg = argv[++i];
+            unsigned long    count = 0;
+            if (!parseCount(arg, 0, maxBenchRuns, count))
+            {
+                std::cerr << "Invalid warmup count: " << arg << " (0 to " << maxBenchRuns << ")\n";
+                return 1;
+            }
+            benchOptions.warmup = static_cast<uint32_t>(count);
+        }
+        else if (argv[i] == "--bench-warm"s)
+        {
+            benchOptions.warm = true;
+        }
+        else if (argv[i] == "--bench-json"s && i + 1 < argc)
+        {
+            benchOptions.jsonPath = argv[++i];
+        }
+        else if (argv[i] == "--diff"s && i + 2 < argc)
+        {
+            diffOldPath = argv[++i];
+            diffNewPath = argv[++i];
+        }
+        else if (argv[i] == "--layout"s && i + 1 < argc)
+        {
+            layoutOutPath = argv[++i];
+        }
+        else if (argv[i] == "--header"s && i + 1 < argc)
+        {
+            headerOutDir = argv[++i];
+        }
+        else if (argv[i] == "--timer-json"s && i + 1 < argc)
+        {
+            timerJsonPath = argv[++i];
+        }
+        else if (argv[i] == "--mem-report"s)
+        {
+            memReport = true;
+            if (!MEMORY_ACCOUNTING)
+                std::cerr << "Warning: built without MEMORY_ACCOUNTING, --mem-report ignored\n";
+        }
+        else if (argv[i] == "--die-stats"s)
+        {
+            dieStats = true;
         }
-        else if (argv[i] == "--test"s && i + 1 < argc)
+        else if (argv[i] == "--sched-stats"s)
         {
-            enableTestMode = true;
-            testLoopCount = std::stoi(argv[++i]);
+            schedStats = true;
+        }
+        else if (argv[i] == "--perf"s)
+        {
+            if (!timing::enableCounters())
+                std::cerr << "Warning: built without TIMER_PERF_COUNTERS, --perf ignored\n";
+        }
+        else if (argv[i] == "--trace"s && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (argv[i] == "-j"s && i + 1 < argc)
+        {
+            // 0 表示每个硬件线程一个工作线程
+            std::string_view arg = argv[++i];
+            unsigned long    count = 0;
+            if (!parseCount(arg, 0, maxThreads, count))
+            {
+                std::cerr << "Invalid thread count: " << arg << " (0 to " << maxThreads << ")\n";
+                return 1;
+            }
+            threadCount = static_cast<unsigned>(count);
+        }
+        else if (inputFilePath.empty() && argv[i][0] != '-')
+        {
+            inputFilePath = argv[i];
         }
         else
         {
@@ -46,26 +209,96 @@ int main(int argc, char **argv)
         }
     }
 
-    static TimerToken token;
-    Timer             timer{token};
-    if (enableTestMode)
+    if (inputFilePath.empty() && diffOldPath.empty())
+    {
+        std::cerr << "Usage: dwarfInfoToheader <input file name> -f <filter> --rule <rule> --rules <rule file> --no-default-rules --timer-json <file> --perf --mem-report --die-stats --trace <file>\n"
+                  << "       dwarfInfoToheader <input file name> -f <name>=<filter> -o <output file> [-f <name>=<filter> -o <output file> ...]\n"
+                  << "       dwarfInfoToheader <input file name> --layout <report file> -f <filter> -j <threads> --sched-stats\n"
+                  << "       dwarfInfoToheader <input file name> --header <output dir> -f <filter> -j <threads> --sched-stats\n"
+                  << "       dwarfInfoToheader <input file name> --bench <iterations> --bench-warmup <num> --bench-warm --bench-json <result file> -f <filter>\n"
+                  << "       dwarfInfoToheader --diff <old file> <new file> -f <filter>\n";
+        return 1;
+    }
+
+    // --diff/--layout/--header 只有一个输出, 命名输出只用于json
+    if (!outputs.empty() && (!diffOldPath.empty() || !layoutOutPath.empty() || !headerOutDir.empty()))
+    {
+        std::cerr << "Error: -f <name>=<filter> is only supported for json output, use -f <filter> or --rule with "
+                  << (!diffOldPath.empty() ? "--diff" : (!layoutOutPath.empty() ? "--layout" : "--header")) << '\n';
+        return 1;
+    }
+
+    if (defaultRules)
+        rules.addDefaultRules();
+    rules.compile();
+    if (outPathSet && !outputs.empty())
+        std::cerr << "Warning: -o " << outPath << " ignored, each named -f writes its own output\n";
+
+    memory::session     memSession{memReport}; // reports after the parsers below have been destroyed
+    trace::session      traceSession{tracePath};
+    timing::reportScope report{timerJsonPath}; // after every scope below has closed
+    dw::statsReport     dieReport{dieStats};   // printed right before the timer report
+    dw::scheduleReport  schedReport{schedStats};
+    static TimerToken   token;
+    Timer               timer{token};
+    if (!diffOldPath.empty())
+    {
+        abiDiff diff{diffOldPath, diffNewPath};
+        if (diff.start(rules) == -1)
+        {
+            std::cerr << "Error: unable to open file: " << diffOldPath << " or " << diffNewPath << '\n';
+            return -1;
+        }
+        return diff.dumpDiff() == 0 ? 0 : 2;
+    }
+    else if (!layoutOutPath.empty())
+    {
+        layoutAnalyzer analyzer{inputFilePath, threadCount};
+        if (analyzer.start(rules) == -1)
+        {
+            std::cerr << "Error: unable to open file: " << inputFilePath << '\n';
+            return -1;
+        }
+        if (analyzer.dumpReport(std::string{layoutOutPath}) == -1)
+            std::cerr << "Error: unable to write " << layoutOutPath << '\n';
+    }
+    else if (!headerOutDir.empty())
     {
-        for (size_t i = 0; i < testLoopCount; i++)
+        headerEmitter emitter{inputFilePath, threadCount};
+        if (emitter.start(rules) == -1)
         {
-            testMode(inputFilePath, filter, i);
+            std::cerr << "Error: unable to open file: " << inputFilePath << '\n';
+            return -1;
+        }
+        if (int failed = emitter.dumpHeaders(std::string{headerOutDir}); failed != 0)
+            std::cerr << "Error: unable to write " << failed << " headers to " << headerOutDir << '\n';
+    }
+    else if (enableBench)
+    {
+        benchRunner bench{inputFilePath, rules, benchOptions};
+        for (auto &&item : outputs)
+            bench.addOutput(item.path, std::move(item.filter));
+        if (int code = bench.start(); code == -1)
+        {
+            std::cerr << "Error: unable to open file: " << inputFilePath << '\n';
+            return -1;
         }
+        else if (code == -2)
+            std::cerr << "Error: unable to write " << benchOptions.jsonPath << '\n';
     }
     else
     {
         dwarf2json d2j{inputFilePath};
+        for (auto &&item : outputs)
+            d2j.addOutput(item.path, std::move(item.filter));
 
-        if (d2j.start(filter) == -1)
+        if (d2j.start(rules) == -1)
         {
             std::cerr << "Error: unable to open file: " << inputFilePath << '\n';
             return -1;
         }
 
-        if (d2j.dumpData() == -1)
+        if (d2j.dumpData(outPath) == -1)
             std::cerr << "Error: unkown err when generating json\n";
     }
 
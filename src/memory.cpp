@@ -0,0 +1,39 @@
+#include <Memory.hpp>
+
+#if MEMORY_ACCOUNTING
+// replaceable allocation functions routed through `memory::allocate`, the nothrow and array forms
+// default to these ones
+void *operator new(size_t size)
+{
+    if (void *block = memory::allocate(size, alignof(std::max_align_t)))
+        return block;
+    throw std::bad_alloc{};
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    if (void *block = memory::allocate(size, std::max(size_t(align), alignof(std::max_align_t))))
+        return block;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *block) noexcept
+{
+    memory::deallocate(block, alignof(std::max_align_t));
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    memory::deallocate(block, alignof(std::max_align_t));
+}
+
+void operator delete(void *block, std::align_val_t align) noexcept
+{
+    memory::deallocate(block, std::max(size_t(align), alignof(std::max_align_t)));
+}
+
+void operator delete(void *block, size_t, std::align_val_t align) noexcept
+{
+    memory::deallocate(block, std::max(size_t(align), alignof(std::max_align_t)));
+}
+#endif
@@ -0,0 +1,88 @@
+#include <dwarf2json/declFilter.hpp>
+#include <initializer_list>
+#include <print>
+
+/**
+ * @brief `declFilter` 和 `globDFA` 的规则求值, 不需要输入文件
+ */
+
+static int failures = 0;
+
+static void expect(bool condition, std::string_view what)
+{
+    if (condition)
+        return;
+    ++failures;
+    std::println(stderr, "FAILED: {}", what);
+}
+
+static declFilter::nsState enter(const declFilter &filter, std::initializer_list<std::string_view> path)
+{
+    declFilter::nsState ns = filter.rootNamespace();
+    for (auto &&name : path)
+        ns = filter.enterNamespace(ns, name);
+    return ns;
+}
+
+static void testDirstar()
+{
+    globDFA globs;
+    int     leading = globs.addPattern("**/foo.h");
+    int     middle = globs.addPattern("src/**/a.h");
+    int     suffix = globs.addPattern("lib**/b.h");
+    globs.compile();
+    auto hits = [&](std::string_view path, int id) { return (globs.match(path) >> id) & 1; };
+
+    expect(hits("foo.h", leading), "**/foo.h matches foo.h");
+    expect(hits("/src/foo.h", leading), "**/foo.h matches /src/foo.h");
+    expect(!hits("/src/barfoo.h", leading), "**/foo.h does not match /src/barfoo.h");
+    expect(hits("src/a.h", middle), "src/**/a.h matches src/a.h");
+    expect(hits("src/x/y/a.h", middle), "src/**/a.h matches src/x/y/a.h");
+    expect(!hits("src/xa.h", middle), "src/**/a.h does not match src/xa.h");
+    // 不在段首的 `**` 是普通的 globstar, 后面的 `/` 必须出现
+    expect(hits("libfoo/x/b.h", suffix), "lib**/b.h matches libfoo/x/b.h");
+    expect(!hits("libb.h", suffix), "lib**/b.h does not match libb.h");
+}
+
+static void testDefaultNamespaces()
+{
+    declFilter filter;
+    filter.addDefaultRules();
+    filter.compile();
+
+    expect(filter.prunesNamespace(enter(filter, {"std"})), "std is pruned");
+    expect(filter.prunesNamespace(enter(filter, {"__gnu_cxx"})), "__gnu_cxx is pruned");
+    expect(filter.prunesNamespace(enter(filter, {"mylib", "__detail"})), "nested __detail is pruned");
+    expect(filter.prunesNamespace(enter(filter, {"mylib", "impl", "__detail"})), "deeply nested __detail is pruned");
+    expect(!filter.prunesNamespace(enter(filter, {"mylib", "detail"})), "mylib::detail is kept");
+    expect(!filter.allowsEntity(enter(filter, {"mylib", "__detail"}), DW_TAG_structure_type, "node"), "struct in nested __detail is filtered");
+    expect(filter.allowsEntity(enter(filter, {"mylib"}), DW_TAG_subprogram, "run"), "mylib::run is kept");
+    expect(!filter.allowsEntity(enter(filter, {"mylib"}), DW_TAG_subprogram, "__run"), "mylib::__run is filtered");
+}
+
+static void testNestedIncludes()
+{
+    declFilter filter;
+    filter.addRule("+tag:class");
+    filter.addRule("+name[class]:Foo");
+    filter.addRule("-name[member]:_*");
+    filter.compile();
+    declFilter::nsState root = filter.rootNamespace();
+
+    expect(filter.allowsEntity(root, DW_TAG_class_type, "Foo"), "class Foo is included");
+    expect(!filter.allowsEntity(root, DW_TAG_class_type, "Bar"), "class Bar is not included");
+    expect(!filter.allowsEntity(root, DW_TAG_subprogram, "run"), "free function is not included");
+    expect(filter.allowsEntity(root, DW_TAG_member, "value", true), "members of an included class are kept");
+    expect(filter.allowsEntity(root, DW_TAG_subprogram, "get", true), "methods of an included class are kept");
+    expect(!filter.allowsEntity(root, DW_TAG_member, "_cache", true), "exclude rules still apply to members");
+}
+
+int main()
+{
+    testDirstar();
+    testDefaultNamespaces();
+    testNestedIncludes();
+    if (failures)
+        std::println(stderr, "{} checks failed", failures);
+    return failures ? 1 : 0;
+}
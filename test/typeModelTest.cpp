@@ -0,0 +1,167 @@
+#include <dwarf2json/dwarf2json.hpp>
+#include <dwarf2json/abiDiff.hpp>
+#include <dwarf2json/layoutAnalyzer.hpp>
+#include <dwarfng/builder.hpp>
+#include <cstdio>
+#include <print>
+#include <sstream>
+
+/**
+ * @brief 用 `dw::builder` 在内存中构造DIE树, 检查类型哈希, `abiDiff`, `layoutAnalyzer` 和
+ *        `dwarf2json` 的跨CU去重, 不需要编译任何输入文件
+ */
+
+static int failures = 0;
+
+static void expect(bool condition, std::string_view what)
+{
+    if (condition)
+        return;
+    ++failures;
+    std::println(stderr, "FAILED: {}", what);
+}
+
+static bool contains(std::string_view text, std::string_view part)
+{
+    return text.find(part) != std::string_view::npos;
+}
+
+/**
+ * @brief struct point { int x; int y; }, `yOffset` 和 `byteSize` 用来制造布局差异
+ * @return point 的die
+ */
+static dw::builder::dieId addPoint(dw::builder &build, dw::builder::dieId cu, uint64_t yOffset = 4, uint64_t byteSize = 8)
+{
+    auto i32 = build.addBaseType(cu, "int", 4, DW_ATE_signed);
+    auto point = build.add(cu, DW_TAG_structure_type).name("point").udata(DW_AT_byte_size, byteSize).udata(DW_AT_decl_file, 1).udata(DW_AT_decl_line, 3).id();
+    build.addMember(point, "x", i32, 0);
+    build.addMember(point, "y", i32, yOffset);
+    return point;
+}
+
+static std::unordered_map<std::string, typeRecord> collect(dw::file &dbg)
+{
+    declFilter filter;
+    filter.compile();
+    typeCollector collector{dbg, filter};
+    collector.collect();
+    return std::move(collector.getTypes());
+}
+
+static void testTypeHash()
+{
+    dw::builder build{4};
+    auto        first = addPoint(build, build.addCU("a.cpp", {"point.h"}));
+    auto        same = addPoint(build, build.addCU("b.cpp", {"point.h"}));
+    auto        moved = addPoint(build, build.addCU("c.cpp", {"point.h"}), 8, 12);
+    dw::file    dbg{build.finish()};
+    expect(dbg.isOpen(), "builder file opens");
+
+    uint64_t firstHash = dbg.typeHash(build.offsetOf(first));
+    expect(firstHash != 0, "point is hashed");
+    expect(firstHash == dbg.typeHash(build.offsetOf(same)), "identical point in another CU hashes the same");
+    expect(firstHash != dbg.typeHash(build.offsetOf(moved)), "moving a member changes the hash");
+
+    // 并行计算的结果与逐个计算的一致
+    const auto &all = dbg.hashAllTypes(3);
+    expect(all.contains(build.offsetOf(moved)) && all.at(build.offsetOf(moved)) == dbg.typeHash(build.offsetOf(moved)),
+           "hashAllTypes agrees with typeHash");
+}
+
+static void testAbiDiff()
+{
+    dw::builder oldBuild{4};
+    auto        oldCU = oldBuild.addCU("a.cpp", {"point.h"});
+    addPoint(oldBuild, oldCU);
+    auto i32 = oldBuild.addBaseType(oldCU, "int", 4, DW_ATE_signed);
+    auto gone = oldBuild.add(oldCU, DW_TAG_structure_type).name("gone").udata(DW_AT_byte_size, 4).udata(DW_AT_decl_file, 1).udata(DW_AT_decl_line, 9).id();
+    oldBuild.addMember(gone, "value", i32, 0);
+    dw::file oldFile{oldBuild.finish()};
+
+    dw::builder newBuild{4};
+    addPoint(newBuild, newBuild.addCU("a.cpp", {"point.h"}), 8, 12);
+    dw::file newFile{newBuild.finish()};
+
+    declFilter filter;
+    filter.compile();
+    abiDiff diff{"old", "new"};
+    expect(diff.start(oldFile, newFile, filter) == 0, "abiDiff collects both builder files");
+
+    FILE *out = std::tmpfile();
+    int   changed = diff.dumpDiff(out);
+    std::string text(std::ftell(out), '\0');
+    std::rewind(out);
+    text.resize(std::fread(text.data(), 1, text.size(), out));
+    std::fclose(out);
+
+    expect(changed == 2, "one changed and one removed type are counted");
+    expect(contains(text, "~ struct point"), "point is reported as changed");
+    expect(contains(text, "size 8 -> 12"), "the size change of point is reported");
+    expect(contains(text, "member y offset 4:0/0 -> 8:0/0"), "the offset change of point::y is reported");
+    expect(contains(text, "- struct gone (point.h:9)"), "gone is reported as removed");
+    expect(contains(text, "1 changed, 1 removed, 0 added, 0 unchanged"), "the summary line counts every type");
+}
+
+static void testPaddingHole()
+{
+    // struct holey { char c; int i; }, 3 个字节的空洞在 i 之前
+    dw::builder build{4};
+    auto        cu = build.addCU("a.cpp", {"holey.h"});
+    auto        i8 = build.addBaseType(cu, "char", 1, DW_ATE_signed_char);
+    auto        i32 = build.addBaseType(cu, "int", 4, DW_ATE_signed);
+    auto        holey = build.add(cu, DW_TAG_structure_type).name("holey").udata(DW_AT_byte_size, 8).udata(DW_AT_decl_file, 1).udata(DW_AT_decl_line, 1).id();
+    build.addMember(holey, "c", i8, 0);
+    build.addMember(holey, "i", i32, 4);
+    dw::file dbg{build.finish()};
+
+    auto types = collect(dbg);
+    expect(types.contains("holey"), "holey is collected");
+    if (!types.contains("holey"))
+        return;
+    layoutAnalyzer::finding found = layoutAnalyzer::analyze(types.at("holey"));
+    expect(found.wastedBytes == 3, "holey wastes 3 bytes");
+    expect(found.tailPadding == 0, "holey has no tail padding");
+    expect(found.notes.size() == 1 && found.notes[0] == "/* XXX 3 bytes hole before i */", "the hole before i is reported");
+}
+
+static void testClassDedup()
+{
+    // 两个CU包含同一个头文件里的 class widget, 成员函数 reset 只在第二个CU里出现
+    dw::builder                     build{4};
+    std::vector<dw::builder::dieId> counts;
+    for (std::string_view source : {"a.cpp", "b.cpp"})
+    {
+        auto cu = build.addCU(source, {"widget.h"});
+        auto i32 = build.addBaseType(cu, "int", 4, DW_ATE_signed);
+        auto widget = build.add(cu, DW_TAG_class_type).name("widget").udata(DW_AT_byte_size, 4).udata(DW_AT_decl_file, 1).udata(DW_AT_decl_line, 2).id();
+        counts.push_back(build.addMember(widget, "count", i32, 0));
+        build.at(counts.back()).udata(DW_AT_decl_file, 1).udata(DW_AT_decl_line, 3);
+        if (source == "b.cpp")
+            build.add(widget, DW_TAG_subprogram).name("reset").udata(DW_AT_decl_file, 1).udata(DW_AT_decl_line, 5).flag(DW_AT_declaration).flag(DW_AT_external);
+    }
+
+    dwarf2json parser{build.finish()};
+    parser.setQuiet(true);
+    expect(parser.start() == 0, "dwarf2json parses the builder file");
+    std::ostringstream out;
+    parser.writeData(out);
+    std::string json = out.str();
+
+    expect(contains(json, "widget.h"), "widget is stored under its header");
+    expect(contains(json, "count"), "the data member of the first definition is kept");
+    expect(contains(json, "reset"), "a member function declared only in the later CU is kept");
+    // 数据成员来自第一个CU, 没有被第二个CU覆盖
+    expect(contains(json, std::format("\"offset\": {}", build.offsetOf(counts[0]))), "the data member comes from the first CU");
+    expect(!contains(json, std::format("\"offset\": {}", build.offsetOf(counts[1]))), "the data member of the later CU is skipped");
+}
+
+int main()
+{
+    testTypeHash();
+    testAbiDiff();
+    testPaddingHole();
+    testClassDedup();
+    if (failures)
+        std::println(stderr, "{} checks failed", failures);
+    return failures ? 1 : 0;
+}